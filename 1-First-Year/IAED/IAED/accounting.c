@@ -0,0 +1,209 @@
+/**
+ * @file accounting.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Tagged accounting of the memory held by the main structures.
+ *
+ * Callers give the size back when they free, as every tagged allocation is
+ * a fixed struct, a string or an array whose owner keeps its capacity, so
+ * nothing is stored next to the blocks. Sizes are the ones requested,
+ * without the allocator's overhead.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proj.h"
+#include "accounting.h"
+
+static const char *tagNames[MEM_TAGS] = {
+    "movements", "vehicles", "billing", "parks", "buffers"
+};
+
+static MemCounters counters[MEM_TAGS];
+static MemCounters total;
+
+/**
+ * @brief Adds an allocation to a tag and to the total.
+ *
+ * @param tag The tag.
+ * @param size Size of the allocation, in bytes.
+ */
+static void count_alloc(MemTag tag, size_t size) {
+    MemCounters *tagged = &counters[tag];
+
+    tagged->live += size;
+    tagged->allocs++;
+    if (tagged->live > tagged->peak)
+        tagged->peak = tagged->live;
+
+    total.live += size;
+    total.allocs++;
+    if (total.live > total.peak)
+        total.peak = total.live;
+}
+
+/**
+ * @brief Allocates memory on behalf of a tag.
+ *
+ * @param tag The tag.
+ * @param size Size of the allocation, in bytes.
+ *
+ * @return Pointer to the memory, or NULL if memory allocation failed.
+ */
+void *mem_alloc(MemTag tag, size_t size) {
+    void *pointer = malloc(size);
+    if (pointer != NULL)
+        count_alloc(tag, size);
+    return pointer;
+}
+
+/**
+ * @brief Allocates zeroed memory on behalf of a tag.
+ *
+ * @param tag The tag.
+ * @param count Number of elements.
+ * @param size Size of each element, in bytes.
+ *
+ * @return Pointer to the memory, or NULL if memory allocation failed.
+ */
+void *mem_calloc(MemTag tag, size_t count, size_t size) {
+    void *pointer = calloc(count, size);
+    if (pointer != NULL)
+        count_alloc(tag, count * size);
+    return pointer;
+}
+
+/**
+ * @brief Copies a string on behalf of a tag.
+ *
+ * @param tag The tag.
+ * @param string The string to copy.
+ *
+ * @return Pointer to the copy, or NULL if memory allocation failed.
+ */
+char *mem_strdup(MemTag tag, const char *string) {
+    size_t size = strlen(string) + 1;
+    char *copy = mem_alloc(tag, size);
+    if (copy != NULL)
+        memcpy(copy, string, size);
+    return copy;
+}
+
+/**
+ * @brief Resizes memory allocated by mem_alloc or mem_calloc.
+ *
+ * @param tag The tag it was allocated with.
+ * @param pointer The memory, may be NULL.
+ * @param oldSize The size it was allocated with.
+ * @param newSize The new size.
+ *
+ * @return Pointer to the memory, or NULL if memory allocation failed, in
+ * which case the old memory is left as it was.
+ */
+void *mem_realloc(MemTag tag, void *pointer, size_t oldSize, size_t newSize) {
+    void *resized = realloc(pointer, newSize);
+    if (resized == NULL)
+        return NULL;
+
+    if (pointer != NULL) {
+        counters[tag].live -= oldSize;
+        counters[tag].frees++;
+        total.live -= oldSize;
+        total.frees++;
+    }
+    count_alloc(tag, newSize);
+    return resized;
+}
+
+/**
+ * @brief Frees memory allocated by mem_alloc or mem_calloc.
+ *
+ * @param tag The tag it was allocated with.
+ * @param pointer The memory, may be NULL.
+ * @param size The size it was allocated with.
+ */
+void mem_free(MemTag tag, void *pointer, size_t size) {
+    if (pointer == NULL)
+        return;
+
+    counters[tag].live -= size;
+    counters[tag].frees++;
+    total.live -= size;
+    total.frees++;
+    free(pointer);
+}
+
+/**
+ * @brief Frees a string allocated by mem_strdup or mem_alloc.
+ *
+ * @param tag The tag it was allocated with.
+ * @param string The string, may be NULL.
+ */
+void mem_free_string(MemTag tag, char *string) {
+    if (string != NULL)
+        mem_free(tag, string, strlen(string) + 1);
+}
+
+/**
+ * @brief Moves an allocation to another tag when it changes owner.
+ *
+ * Counts as a free of one tag and an allocation of the other, but leaves
+ * the total untouched.
+ *
+ * @param from The tag it was allocated with.
+ * @param to The tag of its new owner.
+ * @param size The size it was allocated with.
+ */
+void mem_retag(MemTag from, MemTag to, size_t size) {
+    counters[from].live -= size;
+    counters[from].frees++;
+
+    counters[to].live += size;
+    counters[to].allocs++;
+    if (counters[to].live > counters[to].peak)
+        counters[to].peak = counters[to].live;
+}
+
+/**
+ * @brief Returns the name of a tag, as shown by show_memory.
+ *
+ * @param tag The tag.
+ */
+const char *mem_tag_name(MemTag tag) {
+    return tagNames[tag];
+}
+
+/**
+ * @brief Returns the counters of a tag.
+ *
+ * @param tag The tag.
+ */
+MemCounters mem_counters(MemTag tag) {
+    return counters[tag];
+}
+
+/**
+ * @brief Returns the counters of every tag together.
+ */
+MemCounters mem_total(void) {
+    return total;
+}
+
+/**
+ * @brief Prints the counters of every tag, then their total.
+ *
+ * Prints `<tag> <live> <peak> <allocs> <frees>` with sizes in bytes.
+ */
+void show_memory(void) {
+    for (int tag = 0; tag < MEM_TAGS; tag++)
+        printf("%s %lld %lld %lld %lld%c",
+            tagNames[tag],
+            counters[tag].live,
+            counters[tag].peak,
+            counters[tag].allocs,
+            counters[tag].frees,
+            NEW_LINE);
+
+    printf("total %lld %lld %lld %lld%c",
+        total.live, total.peak, total.allocs, total.frees, NEW_LINE);
+}
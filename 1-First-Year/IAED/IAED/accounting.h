@@ -0,0 +1,55 @@
+/**
+ * @file accounting.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Tagged accounting of the memory held by the main structures.
+ */
+#ifndef ACCOUNTING_H
+#define ACCOUNTING_H
+
+#include <stddef.h>
+
+/**
+ * @brief What an allocation is used for.
+ */
+typedef enum MemTag {
+    MEM_MOVEMENTS,  ///< Movements, their strings, the store and the image.
+    MEM_VEHICLES,   ///< The vehicles hash table, the plate indexes and the
+                    ///< overstay timers.
+    MEM_BILLING,    ///< The billing hash table and the revenue summaries.
+    MEM_PARKS,      ///< The parks, their names and per-park statistics.
+    MEM_BUFFERS,    ///< Engine handles and what a command only holds while
+                    ///< it runs, such as search results and tariff
+                    ///< simulations.
+    MEM_TAGS
+} MemTag;
+
+/**
+ * @brief Counters of one tag.
+ *
+ * @param live Bytes currently allocated.
+ * @param peak Most bytes ever allocated at once.
+ * @param allocs Number of allocations.
+ * @param frees Number of frees.
+ */
+typedef struct MemCounters {
+    long long live;
+    long long peak;
+    long long allocs;
+    long long frees;
+} MemCounters;
+
+
+void *mem_alloc(MemTag tag, size_t size);
+void *mem_calloc(MemTag tag, size_t count, size_t size);
+char *mem_strdup(MemTag tag, const char *string);
+void *mem_realloc(MemTag tag, void *pointer, size_t oldSize, size_t newSize);
+void mem_free(MemTag tag, void *pointer, size_t size);
+void mem_free_string(MemTag tag, char *string);
+void mem_retag(MemTag from, MemTag to, size_t size);
+const char *mem_tag_name(MemTag tag);
+MemCounters mem_counters(MemTag tag);
+MemCounters mem_total(void);
+void show_memory(void);
+
+#endif
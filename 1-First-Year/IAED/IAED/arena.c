@@ -0,0 +1,118 @@
+/**
+ * @file arena.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Bump arena for the temporary objects of a command.
+ *
+ * The arguments parsed from a command line live until the command ends, so
+ * they are carved from one block by bumping an offset and all dropped
+ * together by setting it back to zero. Anything that outlives the command
+ * is copied into tagged memory by the code that keeps it.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "proj.h"
+#include "arena.h"
+
+/// Memory of the scratch arena, aligned for any object parsed from a line
+static union {
+    long long number;
+    double real;
+    void *pointer;
+    char bytes[SCRATCH_SIZE];
+} scratchMemory;
+
+/// Static so reading a command line never calls malloc. The name, plate and
+/// date parsers reach it through scratch_arena(), and read_commands resets
+/// it once each command is done
+static Arena scratch = {scratchMemory.bytes, SCRATCH_SIZE, 0, 0, 0, 0};
+
+/**
+ * @brief Sets up an arena over a block of memory owned by the caller.
+ *
+ * @param arena The arena.
+ * @param memory The block, aligned to ARENA_ALIGN.
+ * @param capacity Size of the block, in bytes.
+ */
+void arena_init(Arena *arena, void *memory, size_t capacity) {
+    arena->base = memory;
+    arena->capacity = capacity;
+    arena->used = 0;
+    arena->peak = 0;
+    arena->resets = 0;
+    arena->overflows = 0;
+}
+
+/**
+ * @brief Hands out memory that stays valid until the next reset.
+ *
+ * @param arena The arena.
+ * @param size Number of bytes.
+ * @return Pointer to the memory, or NULL if the arena is full.
+ */
+void *arena_alloc(Arena *arena, size_t size) {
+    size_t start = (arena->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    if (start > arena->capacity || size > arena->capacity - start) {
+        arena->overflows++;
+        return NULL;
+    }
+
+    arena->used = start + size;
+    if (arena->used > arena->peak)
+        arena->peak = arena->used;
+    return arena->base + start;
+}
+
+/**
+ * @brief Copies a string into an arena.
+ *
+ * @param arena The arena.
+ * @param string The string to copy.
+ * @return Pointer to the copy, or NULL if the arena is full.
+ */
+char *arena_strdup(Arena *arena, const char *string) {
+    size_t size = strlen(string) + 1;
+    char *copy = arena_alloc(arena, size);
+
+    if (copy != NULL)
+        memcpy(copy, string, size);
+    return copy;
+}
+
+/**
+ * @brief Gives back everything handed out by an arena, in constant time.
+ *
+ * @param arena The arena.
+ */
+void arena_reset(Arena *arena) {
+    arena->used = 0;
+    arena->resets++;
+}
+
+/**
+ * @brief Gets the arena of the command being run, reset after each command.
+ *
+ * @return The scratch arena.
+ */
+Arena *scratch_arena(void) {
+    return &scratch;
+}
+
+/**
+ * @brief Prints `<name> <used> <peak> <capacity> <resets> <overflows>`,
+ * sizes in bytes.
+ *
+ * @param arena The arena.
+ * @param name The name printed first.
+ */
+void show_arena(Arena *arena, const char *name) {
+    printf("%s %zu %zu %zu %lld %lld%c",
+        name,
+        arena->used,
+        arena->peak,
+        arena->capacity,
+        arena->resets,
+        arena->overflows,
+        NEW_LINE);
+}
@@ -0,0 +1,44 @@
+/**
+ * @file arena.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Bump arena for the temporary objects of a command.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/// Room for the line, the park name and the plate of the longest command
+#define SCRATCH_SIZE (4 * BUFFSIZ)
+/// Every allocation starts at a multiple of this
+#define ARENA_ALIGN 16
+
+/**
+ * @brief A block of memory handed out front to back and given back at once.
+ *
+ * @param base The memory of the arena.
+ * @param capacity Size of the memory, in bytes.
+ * @param used Bytes handed out since the last reset.
+ * @param peak Most bytes ever in use at once.
+ * @param resets Number of resets.
+ * @param overflows Allocations refused because the arena was full.
+ */
+typedef struct Arena {
+    char *base;
+    size_t capacity;
+    size_t used;
+    size_t peak;
+    long long resets;
+    long long overflows;
+} Arena;
+
+
+void arena_init(Arena *arena, void *memory, size_t capacity);
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strdup(Arena *arena, const char *string);
+void arena_reset(Arena *arena);
+Arena *scratch_arena(void);
+void show_arena(Arena *arena, const char *name);
+
+#endif
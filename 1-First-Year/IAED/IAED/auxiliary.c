@@ -15,58 +15,137 @@
 #include "validation.h"
 #include "auxiliary.h"
 #include "movements.h"
+#include "calendar.h"
+#include "occupancy.h"
+#include "billing.h"
+#include "plates.h"
+#include "ranking.h"
+#include "search.h"
+#include "dwell.h"
+#include "overstay.h"
+#include "stats.h"
+#include "accounting.h"
+#include "trace.h"
+#include "store.h"
+#include "chains.h"
+#include "image.h"
+#include "bloom.h"
+#include "engine.h"
+#include "arena.h"
+
+/// Number of holders, such as live engines, that turned the output off;
+/// the commands print only when it is zero
+static int quietHolders = 0;
+/// The ENGINE code of the last rejected request, read back by the engine
+/// right after the call that rejected it
+static int lastRejection = ENGINE_OK;
+
+/**
+ * @brief Turns the output of the commands off, or releases one earlier
+ * request to turn it off.
+ *
+ * With the output off, the engine keeps every result to itself; embedders
+ * read them from the return values and from last_rejection. Each call with
+ * 0 must be matched by one call with 1, and the output comes back only once
+ * every holder has released it.
+ *
+ * @param on 1 to release, 0 to stay quiet.
+ */
+void set_echo(int on) {
+    if (!on)
+        quietHolders++;
+    else if (quietHolders > 0)
+        quietHolders--;
+}
+
+/**
+ * @brief Tells whether the commands print their results.
+ *
+ * @return 1 if they do, 0 otherwise.
+ */
+int echo_enabled(void) {
+    return quietHolders == 0;
+}
+
+/**
+ * @brief Rejects a request: counts the error, remembers why and prints the
+ * message when the output is on.
+ *
+ * @param code The ENGINE code of the error.
+ * @param subject What the error is about, printed before the message, may
+ * be NULL.
+ * @param message One of the ERROR messages.
+ *
+ * @return 0, so a check can return it directly.
+ */
+int reject(int code, const char *subject, const char *message) {
+    stats_error();
+    lastRejection = code;
+    if (!echo_enabled())
+        return 0;
+
+    if (subject != NULL)
+        printf("%s: %s%c", subject, message, NEW_LINE);
+    else
+        printf("%s%c", message, NEW_LINE);
+    return 0;
+}
+
+/**
+ * @brief Tells why the last request was rejected.
+ *
+ * @return The ENGINE code passed to the last reject.
+ */
+int last_rejection(void) {
+    return lastRejection;
+}
 
 /**
  * @brief Extracts the park name from the input line.
  * 
- * @param inputLine The input line from which to extract the park name.
+ * @param inputLine The input line from which to extract the park name. It is
+ * left holding the arguments after the name.
  * 
- * @return A pointer to the extracted park name, or NULL if the input line is
- * empty or does not contain a park name.
+ * @return A pointer to the extracted park name, in the scratch arena, or 
+ * NULL if the input line is empty or does not contain a park name.
  */
 char *get_park_name(char *inputLine) {
-    char parkNameBuffer[BUFFSIZ]; 
-    char argumentInput[ARGUMENTS_SIZE_MAX]; 
-    int bufferIndex = 0, inputIndex = 1, argumentIndex = 0;
+    int nameIndex = 0, inputIndex = 1;
 
     /// Return NULL if the input line is empty
     if (inputLine[0] == NEW_LINE || inputLine[0] == NULL_TERMINATOR) 
         return NULL;
 
+    /// The name is never longer than the line
+    int length = strlen(inputLine);
+    char *namePointer = arena_alloc(scratch_arena(), length + 1);
+
+    /// Return NULL if the arena is full
+    if (namePointer == NULL)
+        return NULL;
+
     /// If the park name is enclosed in double quotes
     if (inputLine[inputIndex] == '"') {
         /// Copy characters until the closing quote or end of string
         while (inputLine[inputIndex + 1] != '"' && 
                 inputLine[inputIndex + 1] != NULL_TERMINATOR) {
 
-            parkNameBuffer[bufferIndex++] = inputLine[inputIndex + 1];
+            namePointer[nameIndex++] = inputLine[inputIndex + 1];
             inputIndex++;
         }
-        parkNameBuffer[bufferIndex] = NULL_TERMINATOR;
+        namePointer[nameIndex] = NULL_TERMINATOR;
         inputIndex += 2; 
     } 
     else { /// If the park name is not enclosed in double quotes
-        sscanf(inputLine, "%s", parkNameBuffer);
-        inputIndex = strlen(parkNameBuffer) + 1; 
+        namePointer[0] = NULL_TERMINATOR;
+        sscanf(inputLine, "%s", namePointer);
+        inputIndex = strlen(namePointer) + 1; 
     }
 
-    /// Copy the rest of the input line
-    while (inputLine[inputIndex] != NULL_TERMINATOR)
-        argumentInput[argumentIndex++] = inputLine[inputIndex++];
-
-    argumentInput[argumentIndex] = NULL_TERMINATOR;
-
-    /// Allocate memory for the park name
-    char *namePointer = malloc(strlen(parkNameBuffer) + 1);
-
-    /// Return NULL if memory allocation failed
-    if (namePointer == NULL)
-        return NULL;
-
-    /// Copy the park name to the allocated memory
-    strcpy(namePointer, parkNameBuffer);
     /// Update the input line with the remaining arguments
-    strcpy(inputLine, argumentInput);
+    if (inputIndex > length)
+        inputIndex = length;
+    memmove(inputLine, inputLine + inputIndex, length - inputIndex + 1);
 
     return namePointer;
 }
@@ -92,7 +171,7 @@ void list_system_parks(Park *parksTotal, int *parksCounter){
  * @brief Adds a park to the total parks.
  * 
  * @param parksTotal Pointer to the array of parks.
- * @param namePark Name of the park to be added.
+ * @param namePark Name of the park to be added, copied if it is.
  * @param inputLine Input line containing park details.
  * @param parksCounter Pointer to the count of total parks.
  * 
@@ -103,33 +182,204 @@ int add_Park(Park *parksTotal,
             char *inputLine, 
             int *parksCounter) {
 
-    int capacity, available;
-    float preValue, afterValue, maxValue;
+    int capacity;
+    float preInput, afterInput, maxInput;
 
     int numItems = sscanf(inputLine, "%d %f %f %f", 
                         &capacity, 
-                        &preValue, 
-                        &afterValue, 
-                        &maxValue);
+                        &preInput, 
+                        &afterInput, 
+                        &maxInput);
 
     if (numItems < 4) 
         return 0;
 
+    /// The tariff is checked as read, and only then rounded to cents
     if (!can_add_park(parksTotal, 
                     namePark, 
                     capacity, 
-                    preValue, 
-                    afterValue, 
-                    maxValue, 
+                    preInput, 
+                    afterInput, 
+                    maxInput, 
                     *parksCounter)) 
         return 0;
 
+    int preValue = money_to_cents(preInput);
+    int afterValue = money_to_cents(afterInput);
+    int maxValue = money_to_cents(maxInput);
+
+    /// The name was parsed into the scratch arena, the park keeps a copy
+    char *name = mem_strdup(MEM_PARKS, namePark);
+    if (name == NULL)
+        return 0;
+
     Charging charge = {preValue, afterValue, maxValue};
-    available = capacity; 
-    Park park = {namePark, capacity, charge, available};
+    insert_park(parksTotal, name, capacity, charge, parksCounter);
+    return 1;
+}
+
+/**
+ * @brief Appends a park that passed can_add_park to the total parks.
+ * 
+ * @param parksTotal Pointer to the array of parks.
+ * @param namePark Name of the park, now owned by the park (MEM_PARKS).
+ * @param capacity The capacity of the park.
+ * @param charge The tariff of the park, in cents.
+ * @param parksCounter Pointer to the count of total parks.
+ * 
+ * @return The new park.
+ */
+Park *insert_park(Park *parksTotal, 
+                char *namePark, 
+                int capacity, 
+                Charging charge, 
+                int *parksCounter) {
+
+    Park park = {0};
+    park.id = next_park_id(parksTotal, *parksCounter);
+    park.parkName = namePark;
+    park.capacity = capacity;
+    park.charge = charge;
+    park.available = capacity;
+    build_charge_table(&park);
+    init_park_structures(&park);
     parksTotal[*parksCounter] = park;
     (*parksCounter)++; 
-    return 1;
+    return &parksTotal[*parksCounter - 1];
+}
+
+/**
+ * @brief Converts an amount read from the input into cents.
+ * 
+ * @param value The amount, in currency units.
+ * 
+ * @return The amount rounded to the nearest cent.
+ */
+int money_to_cents(double value) {
+    if (value < 0)
+        return -(int)(-value * CENTS_PER_UNIT + 0.5);
+    return (int)(value * CENTS_PER_UNIT + 0.5);
+}
+
+/**
+ * @brief Writes an amount in cents with two decimal places.
+ * 
+ * The sign goes before the units, so negative amounts read "-1.05" and not
+ * "-1.-5".
+ * 
+ * @param text Where to write, MONEY_TEXT_SIZE characters are enough.
+ * @param size The size of text.
+ * @param cents The amount to write.
+ * 
+ * @return The number of characters written, as snprintf.
+ */
+int format_money(char *text, size_t size, long long cents) {
+    unsigned long long magnitude = cents < 0 ? 
+        0ULL - (unsigned long long)cents : (unsigned long long)cents;
+
+    return snprintf(text, size, "%s%llu.%02llu", 
+                    cents < 0 ? "-" : "",
+                    magnitude / CENTS_PER_UNIT, 
+                    magnitude % CENTS_PER_UNIT);
+}
+
+/**
+ * @brief Prints an amount in cents with two decimal places.
+ * 
+ * @param cents The amount to print.
+ */
+void print_money(long long cents) {
+    char text[MONEY_TEXT_SIZE];
+
+    format_money(text, sizeof(text), cents);
+    fputs(text, stdout);
+}
+
+/**
+ * @brief Precomputes the charge of every stay shorter than a day.
+ *
+ * Entry p holds the charge for p started periods of 15 minutes: X for each 
+ * of the first four, Y for each one after that, never more than Z.
+ * 
+ * @param charge The tariff, in cents.
+ * @param chargeTable Array of CHARGE_TABLE_SIZE entries to fill.
+ */
+void fill_charge_table(Charging charge, int *chargeTable) {
+    /// Wide enough for a period added to a total just under the maximum
+    long long total = 0;
+
+    chargeTable[0] = 0;
+    for (int periods = 1; periods < CHARGE_TABLE_SIZE; periods++) {
+        if (periods <= PERIODS_FIRST_HOUR)
+            total += charge.preValue;
+        else
+            total += charge.afterValue;
+
+        if (total > charge.maxValue)
+            total = charge.maxValue;
+        chargeTable[periods] = total;
+    }
+}
+
+/**
+ * @brief Precomputes the charge table of a park from its tariff.
+ * 
+ * @param park The park whose table is filled.
+ */
+void build_charge_table(Park *park) {
+    fill_charge_table(park->charge, park->chargeTable);
+}
+
+/**
+ * @brief Finds the lowest park identifier not used by any existing park.
+ *
+ * Identifiers stay attached to a park for its whole life, unlike its position
+ * in the array, which shifts when an earlier park is removed.
+ * 
+ * @param parksTotal Pointer to the array of parks.
+ * @param parksCounter The total number of parks.
+ * 
+ * @return A free identifier between 0 and PARK_MAX - 1.
+ */
+int next_park_id(Park *parksTotal, int parksCounter) {
+    int used[PARK_MAX] = {0};
+
+    for (int i = 0; i < parksCounter; i++)
+        used[parksTotal[i].id] = 1;
+
+    int id = 0;
+    while (id < PARK_MAX - 1 && used[id])
+        id++;
+    return id;
+}
+
+/**
+ * @brief Allocates the structures a park keeps up to date as vehicles 
+ * move in and out.
+ * 
+ * @param park The park being created.
+ */
+void init_park_structures(Park *park) {
+    park->occupancy = occupancy_create();
+    park->revenue = billing_prefix_create();
+    park->leaders = ledger_create();
+    park->openStays = stay_set_create();
+    park->dwell = dwell_create();
+    park->results = billing_cache_create();
+}
+
+/**
+ * @brief Frees the structures allocated by init_park_structures.
+ * 
+ * @param park The park being removed.
+ */
+void free_park_structures(Park *park) {
+    occupancy_free(park->occupancy);
+    billing_prefix_free(park->revenue);
+    ledger_free(park->leaders);
+    stay_set_free(park->openStays);
+    dwell_free(park->dwell);
+    billing_cache_free(park->results);
 }
 
 /**
@@ -142,8 +392,9 @@ int add_Park(Park *parksTotal,
 void remove_park(Park *parksTotal, int *ParksCounter, char *parkName) {
     for (int i = 0; i < *ParksCounter; i++) {
         if (strcmp(parksTotal[i].parkName, parkName) == 0) {
-            /// Free the parkName
-            free(parksTotal[i].parkName);
+            /// Free the parkName and the park's structures
+            mem_free_string(MEM_PARKS, parksTotal[i].parkName);
+            free_park_structures(&parksTotal[i]);
 
             /// Move the remaining parks down in the array
             for (int j = i; j < *ParksCounter - 1; j++) {
@@ -168,12 +419,13 @@ void remove_park(Park *parksTotal, int *ParksCounter, char *parkName) {
 void free_parks(Park *parks, int parksCounter) {
     /// Iterate over each park in the array
     for (int i = 0; i < parksCounter; i++) {
-        // Free the park's name
-        free(parks[i].parkName);
+        // Free the park's name and structures
+        mem_free_string(MEM_PARKS, parks[i].parkName);
+        free_park_structures(&parks[i]);
     }
 
     /// Free the array itself
-    free(parks);
+    mem_free(MEM_PARKS, parks, PARK_MAX * sizeof(Park));
 }
 
 /**
@@ -195,18 +447,19 @@ void format_date(Date date) {
  * 
  * @param inputLine The input line from which to extract the plate.
  * 
- * @return A pointer to the extracted plate.
+ * @return A pointer to the extracted plate, in the scratch arena.
  */
 char *get_plate(char *inputLine) {
-    char plate[PLATE_MAX], *validPlate; 
+    /// The plate is never longer than the line
+    char *plate = arena_alloc(scratch_arena(), strlen(inputLine) + 1);
+    if (plate == NULL)
+        return NULL;
 
     /// Extract plate from input line
+    plate[0] = NULL_TERMINATOR;
     sscanf(inputLine, "%s", plate);
 
-    validPlate = malloc(strlen(plate) + 1);
-    strcpy(validPlate, plate);
-
-    return validPlate;
+    return plate;
 }
 
 /**
@@ -214,11 +467,13 @@ char *get_plate(char *inputLine) {
  * 
  * @param inputLine The input line from which to extract the date.
  * 
- * @return A pointer to the extracted date.
+ * @return A pointer to the extracted date, in the scratch arena.
  */
 Date *get_date(char *inputLine){
     Date *date;
-    date = (Date*) malloc(sizeof(Date));
+    date = arena_alloc(scratch_arena(), sizeof(Date));
+    if (date == NULL)
+        return NULL;
 
     /// Extract plate from input line
     sscanf(inputLine, "%d-%d-%d %d:%d", 
@@ -236,13 +491,13 @@ Date *get_date(char *inputLine){
  * 
  * @param inputLine The input line from which to extract the date.
  * 
- * @return A pointer to the extracted date.
+ * @return A pointer to the extracted date, in the scratch arena.
  */
 Date *get_date_without_time(char *inputLine){
     Date *date;
-    date = (Date*) malloc(sizeof(Date));
+    date = arena_alloc(scratch_arena(), sizeof(Date));
     if (date == NULL) {
-        /// Handle malloc failure
+        /// Handle a full arena
         return NULL;
     }
 
@@ -272,10 +527,10 @@ Date *get_date_without_time(char *inputLine){
  * @return 1 if the plate is valid, 0 otherwise.
  */
 int handle_invalid_plate(char *plateVehicle) {
-    if(!(is_valid_plate(plateVehicle))){
-        printf("%s: %s%c",plateVehicle, ERROR_INVALID_LICENSE_PLATE, NEW_LINE);
-        return 0;
-    }
+    if(!(is_valid_plate(plateVehicle)))
+        return reject(ENGINE_INVALID_PLATE, 
+                    plateVehicle, 
+                    ERROR_INVALID_LICENSE_PLATE);
     return 1;
 }
 
@@ -287,10 +542,8 @@ int handle_invalid_plate(char *plateVehicle) {
  * @return 1 if the date is valid, 0 otherwise.
  */
 int handle_invalid_date(Date *entryDate) {
-    if(!(is_valid_date(entryDate) && is_valid_time(entryDate->time))){
-        printf("%s%c", ERROR_INVALID_DATE, NEW_LINE);
-        return 0;
-    }
+    if(!(is_valid_date(entryDate) && is_valid_time(entryDate->time)))
+        return reject(ENGINE_INVALID_DATE, NULL, ERROR_INVALID_DATE);
     return 1;
 }
 
@@ -310,14 +563,13 @@ int check_park_availability(Park *parksTotal,
         if(namePark != NULL  && strcmp(parksTotal[i].parkName, namePark) == 0){
             if(parksTotal[i].available > 0)
                 return 1;
-            else {
-                printf("%s: %s%c",namePark, ERROR_PARKING_IS_FULL, NEW_LINE);
-                return 0;
-            }
+            else 
+                return reject(ENGINE_PARKING_IS_FULL, 
+                            namePark, 
+                            ERROR_PARKING_IS_FULL);
         }
     }
-    printf("%s: %s%c", namePark,ERROR_NO_SUCH_PARKING, NEW_LINE);
-    return 0;
+    return reject(ENGINE_NO_SUCH_PARKING, namePark, ERROR_NO_SUCH_PARKING);
 }
 
 /**
@@ -328,23 +580,31 @@ int check_park_availability(Park *parksTotal,
  * @param parksCounter Pointer to the total number of parks.
  * @param command The command that represents the type of movement 
  * (entry or exit).
+ * @param date The date of the movement.
  * @return 1 if the operation was successful, 0 otherwise.
  */
 int update_park_availability(Park *parksTotal, 
                             char *namePark, 
                             int *parksCounter, 
-                            char command) {
+                            char command, 
+                            Date date) {
 
     for(int i = 0; i < *parksCounter; i++){ /// Loop through all parks
         if(namePark != NULL  && strcmp(parksTotal[i].parkName, namePark) == 0){
+            Park *park = &parksTotal[i];
             if(command == COMMAND_E){ /// If the command is 'E' (entry)
-                parksTotal[i].available--;
-                printf("%s %d%c", 
-                    parksTotal[i].parkName,parksTotal[i].available, NEW_LINE);
+                park->available--;
+                occupancy_record(park->occupancy, date, 
+                                park->capacity - park->available, command);
+                if (echo_enabled())
+                    printf("%s %d%c", 
+                        parksTotal[i].parkName,parksTotal[i].available, NEW_LINE);
                 return 1;
             }
             else if(command == COMMAND_S){ /// If the command is 'S' (exit)
-                parksTotal[i].available++;
+                park->available++;
+                occupancy_record(park->occupancy, date, 
+                                park->capacity - park->available, command);
                 return 1;
             }
         }
@@ -367,6 +627,10 @@ char last_command_for_plate(HashTable *hashTable, char *plate) {
     if (node == NULL) {
         /// Plate not found in the hash table
         return NULL_TERMINATOR;
+    } else if (hashTable->store != NULL) {
+        /// The last movement of the plate is at or after the one found
+        return movement_store_last_command(hashTable->store, node->value, 
+                                            plate);
     } else {
         /// Initialize the oldest date to the date of the first movement
         Date oldest_date = node->value->date;
@@ -408,24 +672,28 @@ Movement* register_entry(Park *parksTotal, char *namePark, char *plateVehicle, D
     /// Get the last command for the vehicle
     char lastCommand;  
 
+    TRACE(TRACE_ENTRY_BEGIN);
     if(!park_name_exists(parksTotal, namePark, *parksCounter)){
-        printf("%s: %s%c", namePark, ERROR_NO_SUCH_PARKING, NEW_LINE);
+        reject(ENGINE_NO_SUCH_PARKING, namePark, ERROR_NO_SUCH_PARKING);
         return NULL;
     }
 
     /// Check if the park is available
     if(!check_park_availability(parksTotal, namePark, parksCounter)) 
         return NULL;
+    TRACE(TRACE_ENTRY_PARK);
 
     /// Validate the vehicle plate
     if (!handle_invalid_plate(plateVehicle)) 
         return NULL;
+    TRACE(TRACE_ENTRY_PLATE);
 
     lastCommand = last_command_for_plate(vehicles, plateVehicle);
+    TRACE(TRACE_ENTRY_LAST);
 
     /// Check if the last command was 'e' (entry)
     if (lastCommand == COMMAND_E) {
-        printf("%s: %s%c",plateVehicle, ERROR_INVALID_VEHICLE_ENTRY, NEW_LINE);
+        reject(ENGINE_INVALID_ENTRY, plateVehicle, ERROR_INVALID_VEHICLE_ENTRY);
         return NULL;
     }
 
@@ -434,13 +702,28 @@ Movement* register_entry(Park *parksTotal, char *namePark, char *plateVehicle, D
         return NULL;
 
     /// Check if the entry date is valid
-    if(!(is_valid_entry_date(*head, entryDate))){
-        printf("%s%c", ERROR_INVALID_DATE, NEW_LINE);
+    Movement *tail = movement_store_last(vehicles->store, *head);
+    if(!(is_valid_entry_date(tail, entryDate))){
+        reject(ENGINE_INVALID_DATE, NULL, ERROR_INVALID_DATE);
         return NULL;
     }
-    update_park_availability(parksTotal, namePark, parksCounter, command);
+    TRACE(TRACE_ENTRY_DATE);
+
+    /// The row is reserved first, so a failure leaves everything as it was
+    if (!movement_store_reserve(vehicles->store, 1)) {
+        reject(ENGINE_NO_MEMORY, NULL, ERROR_NO_MEMORY);
+        return NULL;
+    }
+
+    update_park_availability(parksTotal, namePark, parksCounter, command, 
+                            *entryDate);
     /// Add the movement
-    return add_movement(head, plateVehicle, namePark, *entryDate, command);
+    Movement *newMovement = add_movement(head, tail, plateVehicle, namePark, 
+                                        *entryDate, command);
+    Park *park = find_park_by_name(parksTotal, *parksCounter, namePark);
+    movement_store_append(vehicles->store, newMovement, park->id);
+    TRACE(TRACE_ENTRY_APPEND);
+    return newMovement;
 }
 
 /**
@@ -459,7 +742,24 @@ Park* find_park_by_name(Park *parksTotal, int parksCounter, char *name) {
             return &parksTotal[i];
         }
     }
-    printf("%s: %s%c", name,ERROR_NO_SUCH_PARKING, NEW_LINE);
+    reject(ENGINE_NO_SUCH_PARKING, name, ERROR_NO_SUCH_PARKING);
+    return NULL;
+}
+
+/**
+ * @brief Finds a park by its identifier, without printing any error.
+ * 
+ * @param parksTotal Pointer to the array of parks.
+ * @param parksCounter The total number of parks.
+ * @param id The identifier of the park to find.
+ * 
+ * @return A pointer to the park if found, or NULL otherwise.
+ */
+Park* find_park_by_id(Park *parksTotal, int parksCounter, int id) {
+    for (int i = 0; i < parksCounter; i++) {
+        if (parksTotal[i].id == id)
+            return &parksTotal[i];
+    }
     return NULL;
 }
 
@@ -506,77 +806,47 @@ int daysInMonth(int month, int year) {
  * @return The total minutes from the beginning of the year 1 to the given 
  * date.
  */
-int totalMinutes(Date date) {
-    int total = 0;
-
-    // Add minutes from previous years
-    total+=(date.year - 1) * DAYS_PER_YEAR * HOURS_PER_DAY * MINUTES_PER_HOUR;
-    total+=((date.year - 1) / 4) * HOURS_PER_DAY * MINUTES_PER_HOUR;
-
-    // Add minutes from previous months
-    for (int m = 1; m < date.month; m++)
-        total += daysInMonth(m, date.year) * HOURS_PER_DAY * MINUTES_PER_HOUR;
-
-    // Add minutes from previous days
-    total += (date.day - 1) * HOURS_PER_DAY * MINUTES_PER_HOUR;
-
-    // Add minutes from current day
-    total += date.time.hour * MINUTES_PER_HOUR + date.time.minute;
-
-    return total;
+long long totalMinutes(Date date) {
+    return minute_number(date);
 }
 
 /**
- * @brief Calculates the difference in minutes between two dates.
+ * @brief Calculates the chargeable minutes between two dates, which leave 
+ * out every 29 February in between because the parks are closed then.
  * 
  * @param start The start date.
  * @param end The end date.
  * 
- * @return The difference in minutes between the start and end dates.
+ * @return The chargeable minutes between the start and end dates.
  */
-int calculate_minutes(Date start, Date end) {
-    int startMinutes = totalMinutes(start);
-    int endMinutes = totalMinutes(end);
-
-    return endMinutes - startMinutes;
+long long calculate_minutes(Date start, Date end) {
+    return chargeable_minutes(start, end);
 }
 
 /**
  * Calculates the payment for a vehicle's stay in a parking lot.
  * 
+ * @param park The park the vehicle stayed in.
  * @param entryMovement Pointer to the vehicle's entry movement.
  * @param exitMovement Pointer to the vehicle's exit movement.
  * 
- * @return The payment amount.
+ * @return The payment amount, in cents.
  */
-double calculate_payment(Park *park, 
-                        Movement *entryMovement, 
-                        Movement *exitMovement) {
-
-    // Calculate the duration of the stay in minutes
-    int duration = calculate_minutes(entryMovement->date, exitMovement->date);
-    // Calculate the number of complete days
-    int days = duration / (24 * 60);
-    duration -= days * 24 * 60;
+long long calculate_payment(Park *park, 
+                            Movement *entryMovement, 
+                            Movement *exitMovement) {
 
-    // Calculate the payment for the complete days
-    double payment = days * park->charge.maxValue; // Z for each complete day
-
-    // Calculate the payment for the remaining time
-    if (duration <= 60) 
-        payment += ((duration + 14) / 15) * park->charge.preValue; 
-    else {
-        int firstHour = 60;
-        int remainingDuration = duration - firstHour;
-        payment += 4 * park->charge.preValue; 
-        payment += ((remainingDuration + 14) / 15) * park->charge.afterValue; 
-    }
+    // Calculate the duration of the stay in minutes, in constant time
+    long long duration = calculate_minutes(entryMovement->date, 
+                                            exitMovement->date);
+    // Calculate the number of complete days, Z for each of them
+    long long days = duration / MINUTES_PER_DAY;
+    duration -= days * MINUTES_PER_DAY;
 
-    // If the payment for the remaining time exceeds a day, set it to max
-    if (payment > days * park->charge.maxValue + park->charge.maxValue) 
-        payment = (days + 1) * park->charge.maxValue; 
+    // The remaining time is looked up by its number of started periods
+    int periods = (duration + MINUTES_PER_PERIOD - 1) / MINUTES_PER_PERIOD;
 
-    return payment;
+    return days * park->charge.maxValue + park->chargeTable[periods];
 }
 
 /**
@@ -604,21 +874,24 @@ Movement* register_exit(Park *parksTotal,
                         HashTable *vehicles){
     char lastCommand;
     if(!park_name_exists(parksTotal, namePark, *parksCounter)){
-        printf("%s: %s%c", namePark, ERROR_NO_SUCH_PARKING, NEW_LINE);
+        reject(ENGINE_NO_SUCH_PARKING, namePark, ERROR_NO_SUCH_PARKING);
         return NULL;
     }
+    TRACE(TRACE_EXIT_PARK);
     
     /// Validate the vehicle plate
     if (!handle_invalid_plate(plateVehicle)) return NULL;
+    TRACE(TRACE_EXIT_PLATE);
 
     /// Get the last command for the vehicle
     lastCommand = last_command_for_plate(vehicles, plateVehicle);
+    TRACE(TRACE_EXIT_LAST);
     /// Check if the last command was 'S' (exit)
     if (lastCommand == NULL_TERMINATOR || 
         lastCommand == command || 
         strcmp(nameParkToCheck, namePark) != 0) {
 
-        printf("%s: %s%c",plateVehicle, ERROR_INVALID_VEHICLE_EXIT, NEW_LINE);
+        reject(ENGINE_INVALID_EXIT, plateVehicle, ERROR_INVALID_VEHICLE_EXIT);
         return NULL; 
     }
 
@@ -626,15 +899,29 @@ Movement* register_exit(Park *parksTotal,
     if(!handle_invalid_date(exitDate)) return NULL;
 
     /// Check if the exit date is valid
-    if(!(is_valid_entry_date(*head, exitDate))){
-        printf("%s%c", ERROR_INVALID_DATE, NEW_LINE);
+    Movement *tail = movement_store_last(vehicles->store, *head);
+    if(!(is_valid_entry_date(tail, exitDate))){
+        reject(ENGINE_INVALID_DATE, NULL, ERROR_INVALID_DATE);
         return NULL;
     }
+    TRACE(TRACE_EXIT_DATE);
 
-    update_park_availability(parksTotal, namePark, parksCounter, command);
+    /// The row is reserved first, so a failure leaves everything as it was
+    if (!movement_store_reserve(vehicles->store, 1)) {
+        reject(ENGINE_NO_MEMORY, NULL, ERROR_NO_MEMORY);
+        return NULL;
+    }
+
+    update_park_availability(parksTotal, namePark, parksCounter, command, 
+                            *exitDate);
 
     /// Add the movement
-    return add_movement(head, plateVehicle, namePark, *exitDate, command);
+    Movement *newMovement = add_movement(head, tail, plateVehicle, namePark, 
+                                        *exitDate, command);
+    Park *park = find_park_by_name(parksTotal, *parksCounter, namePark);
+    movement_store_append(vehicles->store, newMovement, park->id);
+    TRACE(TRACE_EXIT_APPEND);
+    return newMovement;
 }
 
 /**
@@ -646,8 +933,10 @@ Movement* register_exit(Park *parksTotal,
  * @param entryMovement The movement record for the vehicle's entry.
  * @param exitMovement The movement record for the vehicle's exit.
  * @param billing The billing hash table to add the payment to.
+ * 
+ * @return The payment charged for the stay, in cents.
  */
-void process_exit(Park *parksTotal,
+long long process_exit(Park *parksTotal,
                  int *parksCounter, 
                  char *namePark, 
                  Movement *entryMovement, 
@@ -655,11 +944,147 @@ void process_exit(Park *parksTotal,
                  BillingHashTable *billing) {
 
     Park *park = find_park_by_name(parksTotal, *parksCounter, namePark);
-    double payment = calculate_payment(park, entryMovement, exitMovement);
+    long long payment = calculate_payment(park, entryMovement, exitMovement);
+    long long minutes = calculate_minutes(entryMovement->date, 
+                                        exitMovement->date);
+    TRACE(TRACE_BILL_PAYMENT);
+
+    bill_hash_table_add(billing, 
+                        exitMovement->parkName, 
+                        exitMovement, 
+                        payment, 
+                        minutes);
+    TRACE(TRACE_BILL_INSERT);
+
+    billing_prefix_add(park->revenue, exitMovement->date, payment);
+    billing_cache_exit(park->results, exitMovement->date);
+    revenue_cube_add(billing->cube, park->id, exitMovement->date, payment);
+    dwell_record(park->dwell, exitMovement->date, minutes);
+
+    unsigned int key = plate_to_key(exitMovement->plate);
+    ledger_add(park->leaders, key, payment, minutes);
+    ledger_add(billing->ledger, key, payment, minutes);
+    TRACE(TRACE_BILL_INDEXES);
+
+    if (echo_enabled())
+        print_movement_and_payment(entryMovement, exitMovement, payment);
+    TRACE(TRACE_BILL_PRINT);
+    return payment;
+}
 
-    bill_hash_table_add(billing,exitMovement->parkName,exitMovement,payment);
+/**
+ * @brief Registers a vehicle entry and records it in the vehicles table.
+ *
+ * This is the whole 'e' command once its arguments have been parsed.
+ * 
+ * @param parksTotal Pointer to the array of parks.
+ * @param parksCounter Pointer to the count of total parks.
+ * @param namePark Name of the park the vehicle enters.
+ * @param plateVehicle The vehicle plate.
+ * @param entryDate The date of entry.
+ * @param head Pointer to the head of the movement list.
+ * @param vehicles Pointer to the hash table of vehicle movements.
+ * 
+ * @return The entry movement, or NULL if the entry was rejected.
+ */
+Movement* enter_vehicle(Park *parksTotal, 
+                        int *parksCounter, 
+                        char *namePark, 
+                        char *plateVehicle, 
+                        Date *entryDate, 
+                        Movement **head, 
+                        HashTable *vehicles) {
+
+    Movement *newMovement = register_entry(parksTotal, 
+                                            namePark, 
+                                            plateVehicle, 
+                                            entryDate,
+                                            COMMAND_E, 
+                                            parksCounter, 
+                                            head, 
+                                            vehicles);
+    if (newMovement) {
+        Park *park = find_park_by_name(parksTotal, *parksCounter, namePark);
+        stay_set_insert(park->openStays, newMovement);
+        plate_index_enter(vehicles->plates, plateVehicle, newMovement);
+        overstay_advance(vehicles->overstays, *entryDate);
+        overstay_arm(vehicles->overstays, newMovement);
+        hash_table_add(vehicles, plateVehicle, newMovement);
+        TRACE(TRACE_ENTRY_INDEXES);
+    }
+
+    return newMovement;
+}
+
+/**
+ * @brief Registers a vehicle exit, bills it and records it in the vehicles 
+ * table.
+ *
+ * This is the whole 's' command once its arguments have been parsed.
+ * 
+ * @param parksTotal Pointer to the array of parks.
+ * @param parksCounter Pointer to the count of total parks.
+ * @param namePark Name of the park the vehicle leaves.
+ * @param plateVehicle The vehicle plate.
+ * @param exitDate The date of exit.
+ * @param head Pointer to the head of the movement list.
+ * @param vehicles Pointer to the hash table of vehicle movements.
+ * @param billing Pointer to the billing hash table.
+ * @param payment Where to store the amount charged in cents, may be NULL.
+ * 
+ * @return The exit movement, or NULL if the exit was rejected.
+ */
+Movement* exit_vehicle(Park *parksTotal, 
+                        int *parksCounter, 
+                        char *namePark, 
+                        char *plateVehicle, 
+                        Date *exitDate, 
+                        Movement **head, 
+                        HashTable *vehicles, 
+                        BillingHashTable *billing, 
+                        long long *payment) {
+
+    TRACE(TRACE_EXIT_BEGIN);
+    Movement *entryMovement = movement_store_find_entry(vehicles->store, 
+                                                        *head, 
+                                                        plateVehicle);
+    TRACE(TRACE_EXIT_FIND);
+    char *parkEntry = NULL;
+    if (entryMovement != NULL)
+        parkEntry = entryMovement->parkName;
+
+    Movement *exitMovement = register_exit(parksTotal, 
+                                            parkEntry, 
+                                            namePark, 
+                                            plateVehicle, 
+                                            exitDate, 
+                                            COMMAND_S, 
+                                            parksCounter, 
+                                            head, 
+                                            vehicles);
+    if (exitMovement == NULL)
+        return NULL;
 
-    print_movement_and_payment(entryMovement, exitMovement, payment);
+    Park *park = find_park_by_name(parksTotal, *parksCounter, namePark);
+    stay_set_remove(park->openStays, entryMovement);
+    plate_index_leave(vehicles->plates, plateVehicle);
+    TRACE(TRACE_EXIT_UNLINK);
+
+    long long charged = process_exit(parksTotal, 
+                                parksCounter, 
+                                namePark, 
+                                entryMovement, 
+                                exitMovement, 
+                                billing);
+    hash_table_add(vehicles, plateVehicle, exitMovement);
+    /// The stay may pass its limit before it ends, so the clock moves first
+    overstay_advance(vehicles->overstays, *exitDate);
+    overstay_cancel(vehicles->overstays, entryMovement);
+    TRACE(TRACE_EXIT_INDEXES);
+
+    if (payment != NULL)
+        *payment = charged;
+    return exitMovement;
 }
 
 /**
@@ -667,13 +1092,13 @@ void process_exit(Park *parksTotal,
  * 
  * @param entryMovement The entry movement record.
  * @param exitMovement The exit movement record.
- * @param payment The payment amount.
+ * @param payment The payment amount, in cents.
  */
 void print_movement_and_payment(Movement *entryMovement, 
                                 Movement *exitMovement, 
-                                double payment) {
+                                long long payment) {
 
-    printf("%s %02d-%02d-%04d %02d:%02d %02d-%02d-%04d %02d:%02d %.2f\n", 
+    printf("%s %02d-%02d-%04d %02d:%02d %02d-%02d-%04d %02d:%02d ", 
             exitMovement->plate, 
             entryMovement->date.day,
             entryMovement->date.month,
@@ -684,68 +1109,9 @@ void print_movement_and_payment(Movement *entryMovement,
             exitMovement->date.month, 
             exitMovement->date.year, 
             exitMovement->date.time.hour,
-            exitMovement->date.time.minute, 
-            payment);
-}
-
-/**
- * @brief Shows the daily billing for a given park.
- * 
- * @param billing The billing hash table.
- * @param namePark The name of the park to show the billing for.
- * @param dateToBill The date to show the billing for.
- */
-void show_daily_billing(BillingHashTable *billing, 
-                        char *namePark, 
-                        Date *dateToBill){
-
-    BillingNode *node = bill_hash_table_get(billing, namePark);
-    
-    while (node != NULL) { /// Iterates over the billing hashtable
-        Movement *entryMovement = node->value;
-        if (is_equal_dates(entryMovement->date, *dateToBill)) {
-            printf("%s %02d:%02d %.2f\n", 
-                entryMovement->plate, 
-                entryMovement->date.time.hour, 
-                entryMovement->date.time.minute, 
-                node->bill);
-        }
-        node = node->next;
-    }
-}
-
-/**
- * @brief Prints the total billing for a specific park.
- * 
- * @param billing The billing hash table.
- * @param namePark The name of the park.
- */
-void show_billing(BillingHashTable *billing, char *namePark){
-    BillingNode *node = bill_hash_table_get(billing, namePark);
-    
-    if (node == NULL) 
-        return;
-    
-    Date currentDate = node->value->date;
-    double currentTotal = 0.0;
-    while (node != NULL) { /// Iterates over the billing hashtable
-        if (!is_equal_dates(node->value->date, currentDate)) {
-            printf("%02d-%02d-%04d %.2f\n", 
-                currentDate.day, currentDate.month, currentDate.year, 
-                currentTotal);
-
-            currentDate = node->value->date;
-            currentTotal = 0.0;
-        }
-        /// Adds the bill to the total in each node
-        currentTotal += node->bill;
-        node = node->next;
-    }
-    printf("%02d-%02d-%04d %.2f\n", 
-        currentDate.day, 
-        currentDate.month, 
-        currentDate.year, 
-        currentTotal);
+            exitMovement->date.time.minute);
+    print_money(payment);
+    printf("%c", NEW_LINE);
 }
 
 /**
@@ -755,12 +1121,12 @@ void show_billing(BillingHashTable *billing, char *namePark){
  * @param dateToBill The specific date to bill, or the default date to bill 
  * all dates.
  * @param billing The billing hash table.
- * @param namePark The name of the park.
+ * @param park The park.
  * @param dateToCheck The date to check against the date to bill.
  */
 void handle_billing(Date *dateToBill, 
                     BillingHashTable *billing, 
-                    char *namePark, 
+                    Park *park, 
                     Date dateToCheck) {
 
     Date defaultDate = DEFAULT_DATE;
@@ -769,17 +1135,43 @@ void handle_billing(Date *dateToBill,
     if (!is_equal_dates(defaultDate, *dateToBill)) {
         if (is_valid_date(dateToBill) && 
             is_previous_date(*dateToBill, dateToCheck)) {
-            show_daily_billing(billing, namePark, dateToBill);
+            show_cached_daily_billing(park->results, billing, 
+                                    park->parkName, *dateToBill);
         } 
-        else 
+        else {
+            stats_error();
             printf("%s%c", ERROR_INVALID_DATE, NEW_LINE);
+        }
     } 
     /// If no specific date is provided, show total billing for all dates
     else {
-        show_billing(billing, namePark);
+        show_cached_billing(park->results, park->revenue);
     }
 }
 
+/**
+ * @brief Prints the revenue of a park between two days, inclusive.
+ * 
+ * @param park The park.
+ * @param from The first day.
+ * @param to The last day.
+ * @param dateToCheck The date of the last movement in the system.
+ */
+void show_billing_range(Park *park, Date from, Date to, Date dateToCheck) {
+    if (!is_valid_date(&from) || !is_valid_date(&to) || 
+        !is_previous_date(from, to) || !is_previous_date(to, dateToCheck)) {
+        stats_error();
+        printf("%s%c", ERROR_INVALID_DATE, NEW_LINE);
+        return;
+    }
+
+    printf("%02d-%02d-%04d %02d-%02d-%04d ", 
+        from.day, from.month, from.year, 
+        to.day, to.month, to.year);
+    print_money(billing_range(park->revenue, from, to));
+    printf("%c", NEW_LINE);
+}
+
 /**
  * @brief Sorts and prints the names of all parks.
  * 
@@ -800,7 +1192,7 @@ void print_park_names(Park *parksTotal, int ParksCounter) {
     }
 
     /// Print the park names
-    for (int i = 0; i < ParksCounter; i++) {
+    for (int i = 0; echo_enabled() && i < ParksCounter; i++) {
         printf("%s\n", parksTotal[i].parkName);
     }
 }
@@ -822,9 +1214,89 @@ void remove_structures(Park *parksTotal,
                         HashTable *vehicles, 
                         BillingHashTable *billing) {
 
+     /// Whether a plate has movements left is only known with all of them
+     image_materialize_all(vehicles, billing, parksTotal, *ParksCounter);
+     image_materialize_plates(vehicles);
+
+     Park *park = find_park_by_name(parksTotal, *ParksCounter, parkName);
+     int parkId = park != NULL ? park->id : -1;
+     if (park != NULL) {
+         revenue_cube_clear_park(billing->cube, park->id);
+         ledger_subtract(billing->ledger, park->leaders);
+
+         /// The open entries of the park are about to be freed
+         Movement *entry = park->openStays ? park->openStays->first : NULL;
+         for (; entry != NULL; entry = entry->stayNext) {
+             plate_index_leave(vehicles->plates, entry->plate);
+             overstay_cancel(vehicles->overstays, entry);
+         }
+     }
+
      hash_table_remove(vehicles, parkName); 
      bill_hash_table_remove(billing, parkName);
      remove_park(parksTotal, ParksCounter, parkName);
-     remove_movements(head, parkName);
+     movement_store_remove_park(vehicles->store, head, parkName, parkId);
+     image_drop_park(vehicles, parkId);
      print_park_names(parksTotal,*ParksCounter);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Creates the structures of an empty engine.
+ *
+ * @param parksTotal Pointer to Park array.
+ * @param ParksCounter Pointer to park count.
+ * @param head Pointer to Movement list head.
+ * @param vehicles Pointer to vehicle HashTable.
+ * @param billing Pointer to billing HashTable.
+ */
+void initialize_program(Park **parksTotal, 
+                        int *ParksCounter, 
+                        Movement **head, 
+                        HashTable **vehicles, 
+                        BillingHashTable **billing){
+
+    *parksTotal = mem_alloc(MEM_PARKS, PARK_MAX * sizeof(Park));
+    *ParksCounter = 0;
+    *head = NULL;
+    *vehicles = hash_table_create(HASH_CAPACITY);
+    (*vehicles)->plates = plate_index_create();
+    (*vehicles)->overstays = overstay_create();
+    /// A lookup that misses walks the primary and the secondary chain
+    (*vehicles)->chains = chain_stats_create(HASH_CAPACITY, 2, MEM_VEHICLES);
+    (*vehicles)->store = movement_store_create();
+    (*vehicles)->seen = plate_filter_create(plate_filter_fleet_size());
+    *billing = bill_hash_table_create(HASH_CAPACITY);
+    (*billing)->cube = revenue_cube_create();
+    (*billing)->ledger = ledger_create();
+    (*billing)->chains = chain_stats_create(HASH_CAPACITY, 1, MEM_BILLING);
+}
+
+/**
+ * @brief Frees everything created by initialize_program and the commands.
+ *
+ * @param parksTotal Array of Park structures.
+ * @param parksCounter Count of parks.
+ * @param head Head of the double linked list of Movements.
+ * @param vehicles HashTable of vehicle movement information.
+ * @param billing BillingHashTable of billing information.
+ */
+void free_program(Park *parksTotal, 
+                int *parksCounter, 
+                Movement **head, 
+                HashTable *vehicles, 
+                BillingHashTable *billing){
+
+    plate_index_free(vehicles->plates);
+    overstay_free(vehicles->overstays);
+    chain_stats_free(vehicles->chains);
+    movement_store_free(vehicles->store);
+    plate_filter_free(vehicles->seen);
+    image_free(vehicles->image);
+    hash_table_free(vehicles);
+    revenue_cube_free(billing->cube);
+    ledger_free(billing->ledger);
+    chain_stats_free(billing->chains);
+    bill_hash_table_free(billing);
+    free_all_movements(*head);
+    free_parks(parksTotal, *parksCounter);
+}
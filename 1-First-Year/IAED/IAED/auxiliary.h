@@ -9,33 +9,50 @@
 #define AUXILIARY_H
 #include "movements.h" 
 
+void set_echo(int on);
+int echo_enabled(void);
+int reject(int code, const char *subject, const char *message);
+int last_rejection(void);
 char *get_park_name(char *inputLine);
 void list_system_parks(Park *parksTotal, int *parksCounter);
+void init_park_structures(Park *park);
+void free_park_structures(Park *park);
 void remove_park(Park *parksTotal, int *ParksCounter, char *parkName);
 void free_parks(Park *parks, int parksCounter);
 char *get_plate(char *inputLine);
 void format_date(Date date);
 Date *get_date(char *inputLine);
 Date *get_date_without_time(char *inputLine);
+int next_park_id(Park *parksTotal, int parksCounter);
+int money_to_cents(double value);
+int format_money(char *text, size_t size, long long cents);
+void print_money(long long cents);
+void fill_charge_table(Charging charge, int *chargeTable);
+void build_charge_table(Park *park);
 int add_Park(Park *parksTotal, char *namePark, char *inputLine, int *parksCounter);
+Park *insert_park(Park *parksTotal, char *namePark, int capacity, Charging charge, int *parksCounter);
 int handle_invalid_plate(char *plateVehicle);
 int handle_invalid_date(Date *entryDate);
 int check_park_availability(Park *parksTotal, char *namePark, int *parksCounter);
-int update_park_availability(Park *parksTotal, char *namePark, int *parksCounter, char command);
+int update_park_availability(Park *parksTotal, char *namePark, int *parksCounter, char command, Date date);
 char last_command_for_plate(HashTable *hashTable, char *plate);
 Movement* register_entry(Park *parksTotal, char *namePark, char *plateVehicle, Date *entryDate, char command, int *parksCounter, Movement **head, HashTable *vehicles);
 Park* find_park_by_name(Park *parksTotal, int parksCounter, char *name);
+Park* find_park_by_id(Park *parksTotal, int parksCounter, int id);
 int daysInMonth(int month, int year);
-int totalMinutes(Date date);
-int calculate_minutes(Date start, Date end);
-double calculate_payment(Park *park, Movement *entryMovement, Movement *exitMovement);
+long long totalMinutes(Date date);
+long long calculate_minutes(Date start, Date end);
+long long calculate_payment(Park *park, Movement *entryMovement, Movement *exitMovement);
 Movement* register_exit(Park *parksTotal,char *nameParkToCheck, char *namePark, char *plateVehicle, Date *exitDate, char command, int *parksCounter, Movement **head, HashTable *vehicles);
-void process_exit(Park *parksTotal, int *parksCounter, char *namePark, Movement *entryMovement, Movement *exitMovement, BillingHashTable *billing);
-void print_movement_and_payment(Movement *entryMovement, Movement *exitMovement, double payment);
-void show_daily_billing(BillingHashTable *billing, char *namePark, Date *dateToBill);
-void show_billing(BillingHashTable *billing, char *namePark);
-void handle_billing(Date *dateToBill, BillingHashTable *billing, char *namePark, Date dateToCheck);
+long long process_exit(Park *parksTotal, int *parksCounter, char *namePark, Movement *entryMovement, Movement *exitMovement, BillingHashTable *billing);
+Movement* enter_vehicle(Park *parksTotal, int *parksCounter, char *namePark, char *plateVehicle, Date *entryDate, Movement **head, HashTable *vehicles);
+Movement* exit_vehicle(Park *parksTotal, int *parksCounter, char *namePark, char *plateVehicle, Date *exitDate, Movement **head, HashTable *vehicles, BillingHashTable *billing, long long *payment);
+void print_movement_and_payment(Movement *entryMovement, Movement *exitMovement, long long payment);
+void show_billing_range(Park *park, Date from, Date to, Date dateToCheck);
+void handle_billing(Date *dateToBill, BillingHashTable *billing, Park *park, Date dateToCheck);
 void remove_structures(Park *parksTotal, int *ParksCounter, char *parkName,  Movement **head, HashTable *vehicles, BillingHashTable *billing);
 void print_park_names(Park *parksTotal, int ParksCounter);
+void initialize_program(Park **parksTotal, int *ParksCounter, Movement **head, HashTable **vehicles, BillingHashTable **billing);
+void free_program(Park *parksTotal, int *parksCounter, Movement **head, HashTable *vehicles, BillingHashTable *billing);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,556 @@
+/**
+ * @file billing.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Billing summaries kept up to date as exits are billed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proj.h"
+#include "calendar.h"
+#include "auxiliary.h"
+#include "validation.h"
+#include "billing.h"
+#include "accounting.h"
+
+/**
+ * @brief Creates an empty cumulative revenue array.
+ *
+ * @return Pointer to the new array, or NULL if memory allocation failed.
+ */
+BillingPrefix *billing_prefix_create(void) {
+    BillingPrefix *prefix = mem_alloc(MEM_BILLING, sizeof(BillingPrefix));
+    if (prefix == NULL)
+        return NULL;
+
+    prefix->days = mem_alloc(MEM_BILLING,
+                            BILLING_INITIAL_DAYS * sizeof(long long));
+    prefix->cumulative = mem_alloc(MEM_BILLING,
+                            BILLING_INITIAL_DAYS * sizeof(long long));
+    prefix->count = 0;
+    prefix->capacity = BILLING_INITIAL_DAYS;
+    return prefix;
+}
+
+/**
+ * @brief Frees a cumulative revenue array.
+ *
+ * @param prefix The array to free, may be NULL.
+ */
+void billing_prefix_free(BillingPrefix *prefix) {
+    if (prefix == NULL)
+        return;
+
+    size_t size = prefix->capacity * sizeof(long long);
+
+    mem_free(MEM_BILLING, prefix->days, size);
+    mem_free(MEM_BILLING, prefix->cumulative, size);
+    mem_free(MEM_BILLING, prefix, sizeof(BillingPrefix));
+}
+
+/**
+ * @brief Adds a billed exit to the cumulative revenue of its park.
+ *
+ * @param prefix The cumulative revenue of the park, may be NULL.
+ * @param date The date of the exit, never before the previous one.
+ * @param bill The amount billed, in cents.
+ */
+void billing_prefix_add(BillingPrefix *prefix, Date date, long long bill) {
+    if (prefix == NULL || prefix->days == NULL || prefix->cumulative == NULL)
+        return;
+
+    long long day = day_number(date);
+    int last = prefix->count - 1;
+
+    if (last >= 0 && prefix->days[last] == day) {
+        prefix->cumulative[last] += bill;
+        return;
+    }
+
+    if (prefix->count == prefix->capacity) {
+        size_t size = prefix->capacity * sizeof(long long);
+        long long *days = mem_alloc(MEM_BILLING, size * 2);
+        long long *cumulative = mem_alloc(MEM_BILLING, size * 2);
+        if (days == NULL || cumulative == NULL) {
+            mem_free(MEM_BILLING, days, size * 2);
+            mem_free(MEM_BILLING, cumulative, size * 2);
+            return;
+        }
+
+        memcpy(days, prefix->days, size);
+        memcpy(cumulative, prefix->cumulative, size);
+        mem_free(MEM_BILLING, prefix->days, size);
+        mem_free(MEM_BILLING, prefix->cumulative, size);
+        prefix->days = days;
+        prefix->cumulative = cumulative;
+        prefix->capacity *= 2;
+    }
+
+    prefix->days[prefix->count] = day;
+    prefix->cumulative[prefix->count] =
+        (last >= 0 ? prefix->cumulative[last] : 0) + bill;
+    prefix->count++;
+}
+
+/**
+ * @brief Finds the revenue of a park up to and including a day.
+ *
+ * @param prefix The cumulative revenue of the park.
+ * @param day The day number.
+ * @return The revenue in cents of every exit on or before the day.
+ */
+long long billing_prefix_until(BillingPrefix *prefix, long long day) {
+    int low = 0, high = prefix->count;
+
+    /// Finds the number of stored days not after the given one
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (prefix->days[middle] <= day)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low > 0 ? prefix->cumulative[low - 1] : 0;
+}
+
+/**
+ * @brief Computes the revenue of a park between two days, inclusive.
+ *
+ * @param prefix The cumulative revenue of the park.
+ * @param from The first day.
+ * @param to The last day.
+ * @return The revenue in cents of the exits between the two days.
+ */
+long long billing_range(BillingPrefix *prefix, Date from, Date to) {
+    if (prefix == NULL)
+        return 0;
+
+    return billing_prefix_until(prefix, day_number(to)) -
+            billing_prefix_until(prefix, day_number(from) - 1);
+}
+
+/**
+ * @brief Creates an empty revenue cube.
+ *
+ * @return Pointer to the new cube, or NULL if memory allocation failed.
+ */
+RevenueCube *revenue_cube_create(void) {
+    RevenueCube *cube = mem_alloc(MEM_BILLING, sizeof(RevenueCube));
+    if (cube == NULL)
+        return NULL;
+
+    cube->rows = mem_alloc(MEM_BILLING, CUBE_INITIAL_ROWS * sizeof(CubeRow));
+    cube->count = 0;
+    cube->capacity = CUBE_INITIAL_ROWS;
+    return cube;
+}
+
+/**
+ * @brief Frees a revenue cube.
+ *
+ * @param cube The cube to free, may be NULL.
+ */
+void revenue_cube_free(RevenueCube *cube) {
+    if (cube == NULL)
+        return;
+
+    mem_free(MEM_BILLING, cube->rows, cube->capacity * sizeof(CubeRow));
+    mem_free(MEM_BILLING, cube, sizeof(RevenueCube));
+}
+
+/**
+ * @brief Adds a billed exit to the revenue cube.
+ *
+ * An exit on a later day than the open row closes it and opens a new one.
+ *
+ * @param cube The revenue cube, may be NULL.
+ * @param parkId The identifier of the park of the exit.
+ * @param date The date of the exit, never before the previous one.
+ * @param bill The amount billed, in cents.
+ */
+void revenue_cube_add(RevenueCube *cube, int parkId, Date date, long long bill){
+    if (cube == NULL || cube->rows == NULL)
+        return;
+
+    long long day = day_number(date);
+
+    if (cube->count == 0 || cube->rows[cube->count - 1].day != day) {
+        if (cube->count == cube->capacity) {
+            int capacity = cube->capacity * 2;
+            CubeRow *rows = mem_realloc(MEM_BILLING, cube->rows,
+                                        cube->capacity * sizeof(CubeRow),
+                                        capacity * sizeof(CubeRow));
+            if (rows == NULL)
+                return;
+
+            cube->rows = rows;
+            cube->capacity = capacity;
+        }
+
+        CubeRow *row = &cube->rows[cube->count++];
+        memset(row, 0, sizeof(CubeRow));
+        row->day = day;
+    }
+
+    CubeRow *row = &cube->rows[cube->count - 1];
+    row->revenue[parkId] += bill;
+    row->exits[parkId]++;
+}
+
+/**
+ * @brief Clears the column of a removed park, so its identifier can be
+ * reused by a new park.
+ *
+ * @param cube The revenue cube, may be NULL.
+ * @param parkId The identifier of the removed park.
+ */
+void revenue_cube_clear_park(RevenueCube *cube, int parkId) {
+    if (cube == NULL)
+        return;
+
+    for (int i = 0; i < cube->count; i++) {
+        cube->rows[i].revenue[parkId] = 0;
+        cube->rows[i].exits[parkId] = 0;
+    }
+}
+
+/**
+ * @brief Adds the bills of a park on days that may come before the last 
+ * row, merging them with the rows in a single pass.
+ *
+ * @param cube The revenue cube, may be NULL.
+ * @param parkId The identifier of the park.
+ * @param days The day_number of each bill, in increasing order.
+ * @param bills The bills, in cents.
+ * @param count The number of bills.
+ */
+void revenue_cube_merge(RevenueCube *cube, 
+                        int parkId, 
+                        long long *days, 
+                        long long *bills, 
+                        int count) {
+
+    if (cube == NULL || cube->rows == NULL || count == 0)
+        return;
+
+    /// Each distinct day may need a row of its own
+    int capacity = cube->count + 1;
+    for (int j = 1; j < count; j++)
+        capacity += days[j] != days[j - 1];
+
+    CubeRow *rows = mem_alloc(MEM_BILLING, capacity * sizeof(CubeRow));
+    if (rows == NULL)
+        return;
+
+    int merged = 0, i = 0, j = 0;
+    while (i < cube->count || j < count) {
+        long long day = j == count || 
+                        (i < cube->count && cube->rows[i].day <= days[j]) ?
+                        cube->rows[i].day : days[j];
+
+        CubeRow *row = &rows[merged++];
+        if (i < cube->count && cube->rows[i].day == day) {
+            *row = cube->rows[i++];
+        } else {
+            memset(row, 0, sizeof(CubeRow));
+            row->day = day;
+        }
+
+        for (; j < count && days[j] == day; j++) {
+            row->revenue[parkId] += bills[j];
+            row->exits[parkId]++;
+        }
+    }
+
+    mem_free(MEM_BILLING, cube->rows, cube->capacity * sizeof(CubeRow));
+    cube->rows = rows;
+    cube->count = merged;
+    cube->capacity = capacity;
+}
+
+/**
+ * @brief Creates an empty cache of 'f' outputs.
+ *
+ * @return Pointer to the new cache, or NULL if memory allocation failed.
+ */
+BillingCache *billing_cache_create(void) {
+    BillingCache *cache = mem_calloc(MEM_BILLING, 1, sizeof(BillingCache));
+    if (cache == NULL)
+        return NULL;
+
+    cache->openDay = -1;
+    cache->stale = 1;
+    return cache;
+}
+
+/**
+ * @brief Frees a cache of 'f' outputs.
+ *
+ * @param cache The cache, or NULL.
+ */
+void billing_cache_free(BillingCache *cache) {
+    if (cache == NULL)
+        return;
+
+    billing_cache_clear(cache);
+    mem_free(MEM_BILLING, cache->days, cache->dayCapacity * sizeof(CachedDay));
+    mem_free(MEM_BILLING, cache, sizeof(BillingCache));
+}
+
+/**
+ * @brief Drops every output kept, for when the bills of a park are rebuilt.
+ *
+ * @param cache The cache, or NULL.
+ */
+void billing_cache_clear(BillingCache *cache) {
+    if (cache == NULL)
+        return;
+
+    for (int i = 0; i < cache->count; i++)
+        mem_free(MEM_BILLING, cache->days[i].text, cache->days[i].capacity);
+    mem_free(MEM_BILLING, cache->summary, cache->capacity);
+    cache->summary = NULL;
+    cache->length = cache->capacity = cache->openStart = 0;
+    cache->openDay = -1;
+    cache->stale = 1;
+    cache->count = 0;
+}
+
+/**
+ * @brief Appends characters to a cached output, growing it if needed.
+ *
+ * @param text The output.
+ * @param length The number of characters in it.
+ * @param capacity The number of characters allocated.
+ * @param line The characters to append.
+ * @param size The number of characters to append.
+ * @return 1 on success, 0 if memory allocation failed.
+ */
+static int cache_append(char **text, int *length, int *capacity,
+                        const char *line, int size) {
+    if (*length + size > *capacity) {
+        int grown = *capacity > 0 ? *capacity : CACHE_INITIAL_BYTES;
+        while (*length + size > grown)
+            grown *= 2;
+
+        char *resized = mem_realloc(MEM_BILLING, *text, *capacity, grown);
+        if (resized == NULL)
+            return 0;
+        *text = resized;
+        *capacity = grown;
+    }
+    memcpy(*text + *length, line, size);
+    *length += size;
+    return 1;
+}
+
+/**
+ * @brief Appends the `<date> <revenue>` line of a day to the summary.
+ *
+ * @param cache The cache.
+ * @param day The day number.
+ * @param revenue The revenue of the day, in cents.
+ * @return 1 on success, 0 if memory allocation failed.
+ */
+static int cache_append_day(BillingCache *cache, long long day,
+                            long long revenue) {
+    char line[CACHE_LINE_MAX], money[MONEY_TEXT_SIZE];
+    Date date = date_from_day_number(day);
+
+    format_money(money, sizeof(money), revenue);
+    int size = snprintf(line, sizeof(line), "%02d-%02d-%04d %s%c",
+                        date.day, date.month, date.year, money, NEW_LINE);
+
+    return cache_append(&cache->summary, &cache->length, &cache->capacity,
+                        line, size);
+}
+
+/**
+ * @brief Finds where a day is, or would be, in the days of a cache.
+ *
+ * @param cache The cache.
+ * @param day The day number.
+ * @return The index of the first day not before the given one.
+ */
+static int cache_find_day(BillingCache *cache, long long day) {
+    int low = 0, high = cache->count;
+
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (cache->days[middle].day < day)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+/**
+ * @brief Drops the outputs an exit changes.
+ *
+ * The exit is on the open day, the last one with exits, or on a later day
+ * that closes it. Either way, only the summary from the line of the open
+ * day on and the output of the day of the exit change.
+ *
+ * @param cache The cache, or NULL.
+ * @param date The date of the exit.
+ */
+void billing_cache_exit(BillingCache *cache, Date date) {
+    if (cache == NULL)
+        return;
+
+    long long day = day_number(date);
+    int index = cache_find_day(cache, day);
+    if (index < cache->count && cache->days[index].day == day) {
+        mem_free(MEM_BILLING, cache->days[index].text,
+                cache->days[index].capacity);
+        memmove(&cache->days[index], &cache->days[index + 1],
+                (cache->count - index - 1) * sizeof(CachedDay));
+        cache->count--;
+    }
+    cache->stale = 1;
+}
+
+/**
+ * @brief Prints the revenue of a park by day, as 'f <park>'.
+ *
+ * The lines are formatted from the cumulative revenue and printed from the
+ * cache afterwards. After exits, the lines from the open day on are
+ * formatted again, and the ones before it are kept.
+ *
+ * @param cache The cache of the park.
+ * @param prefix The cumulative revenue of the park.
+ */
+void show_cached_billing(BillingCache *cache, BillingPrefix *prefix) {
+    if (cache == NULL || prefix == NULL)
+        return;
+
+    if (cache->stale) {
+        int first = prefix->count;
+        while (first > 0 && prefix->days[first - 1] >= cache->openDay)
+            first--;
+
+        cache->length = cache->openStart;
+        for (int i = first; i < prefix->count; i++) {
+            long long revenue = prefix->cumulative[i] -
+                                (i > 0 ? prefix->cumulative[i - 1] : 0);
+            cache->openStart = cache->length;
+            cache->openDay = prefix->days[i];
+            if (!cache_append_day(cache, prefix->days[i], revenue)) {
+                billing_cache_clear(cache);
+                return;
+            }
+        }
+        cache->stale = 0;
+    }
+
+    if (cache->length > 0)
+        fwrite(cache->summary, 1, cache->length, stdout);
+}
+
+/**
+ * @brief Prints the exits of a park during a day, as 'f <park> <date>'.
+ *
+ * The bills of the park are only walked the first time a day is asked
+ * for, and again after an exit on that day.
+ *
+ * @param cache The cache of the park.
+ * @param billing Pointer to the billing hash table.
+ * @param namePark The name of the park.
+ * @param date The day to print.
+ */
+void show_cached_daily_billing(BillingCache *cache,
+                               BillingHashTable *billing,
+                               char *namePark,
+                               Date date) {
+    if (cache == NULL)
+        return;
+
+    long long day = day_number(date);
+    int index = cache_find_day(cache, day);
+    if (index < cache->count && cache->days[index].day == day) {
+        if (cache->days[index].length > 0)
+            fwrite(cache->days[index].text, 1, cache->days[index].length,
+                    stdout);
+        return;
+    }
+
+    CachedDay entry = {day, NULL, 0, 0};
+    BillingNode *node = bill_hash_table_get(billing, namePark);
+    for (; node != NULL; node = node->next) {
+        Movement *exitMovement = node->value;
+        if (strcmp(node->key, namePark) != 0 ||
+            !is_equal_dates(exitMovement->date, date))
+            continue;
+
+        char line[CACHE_LINE_MAX], money[MONEY_TEXT_SIZE];
+        format_money(money, sizeof(money), node->bill);
+        int size = snprintf(line, sizeof(line), "%s %02d:%02d %s%c",
+                            exitMovement->plate,
+                            exitMovement->date.time.hour,
+                            exitMovement->date.time.minute,
+                            money,
+                            NEW_LINE);
+        if (!cache_append(&entry.text, &entry.length, &entry.capacity,
+                            line, size)) {
+            mem_free(MEM_BILLING, entry.text, entry.capacity);
+            return;
+        }
+    }
+    if (entry.length > 0)
+        fwrite(entry.text, 1, entry.length, stdout);
+
+    if (cache->count == cache->dayCapacity) {
+        int grown = cache->dayCapacity > 0 ?
+                    cache->dayCapacity * 2 : CACHE_INITIAL_DAYS;
+        CachedDay *days = mem_realloc(MEM_BILLING, cache->days,
+                                    cache->dayCapacity * sizeof(CachedDay),
+                                    grown * sizeof(CachedDay));
+        if (days == NULL) {
+            mem_free(MEM_BILLING, entry.text, entry.capacity);
+            return;
+        }
+        cache->days = days;
+        cache->dayCapacity = grown;
+    }
+    memmove(&cache->days[index + 1], &cache->days[index],
+            (cache->count - index) * sizeof(CachedDay));
+    cache->days[index] = entry;
+    cache->count++;
+}
+
+/**
+ * @brief Prints the daily totals of every park in a single pass.
+ *
+ * Prints `<date> <park> <exits> <revenue>` for every day and park with
+ * exits, by day and then in the order the parks were created.
+ *
+ * @param cube The revenue cube.
+ * @param parksTotal Pointer to the array of parks.
+ * @param parksCounter The total number of parks.
+ */
+void show_revenue_report(RevenueCube *cube, Park *parksTotal, int parksCounter){
+    if (cube == NULL)
+        return;
+
+    for (int i = 0; i < cube->count; i++) {
+        CubeRow *row = &cube->rows[i];
+        Date date = date_from_day_number(row->day);
+
+        for (int p = 0; p < parksCounter; p++) {
+            int id = parksTotal[p].id;
+            if (row->exits[id] == 0)
+                continue;
+
+            printf("%02d-%02d-%04d %s %d ",
+                date.day,
+                date.month,
+                date.year,
+                parksTotal[p].parkName,
+                row->exits[id]);
+            print_money(row->revenue[id]);
+            printf("%c", NEW_LINE);
+        }
+    }
+}
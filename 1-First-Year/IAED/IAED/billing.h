@@ -0,0 +1,131 @@
+/**
+ * @file billing.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Billing summaries kept up to date as exits are billed.
+ */
+#ifndef BILLING_H
+#define BILLING_H
+
+#define BILLING_INITIAL_DAYS 32
+#define CUBE_INITIAL_ROWS 32
+#define CACHE_INITIAL_BYTES 256
+#define CACHE_INITIAL_DAYS 8
+/// Longest line of a cached output: a plate and a time, or a date, and an amount
+#define CACHE_LINE_MAX 64
+
+/**
+ * @brief Cumulative revenue of a park by day number.
+ *
+ * Only days with at least one exit are stored, in increasing order, since
+ * exits are billed chronologically. The revenue between two days is the
+ * difference of the cumulative values found for each end.
+ *
+ * @param days The day numbers with exits.
+ * @param cumulative Revenue in cents of every exit up to and including the
+ * matching day.
+ * @param count The number of days stored.
+ * @param capacity The number of days allocated.
+ */
+typedef struct BillingPrefix {
+    long long *days;
+    long long *cumulative;
+    int count;
+    int capacity;
+} BillingPrefix;
+
+/**
+ * @brief Revenue and exits of every park during one day.
+ *
+ * @param day The day number.
+ * @param revenue Revenue in cents, indexed by park identifier.
+ * @param exits Number of billed exits, indexed by park identifier.
+ */
+typedef struct CubeRow {
+    long long day;
+    long long revenue[PARK_MAX];
+    int exits[PARK_MAX];
+} CubeRow;
+
+/**
+ * @brief Revenue of the whole system by day and park.
+ *
+ * Rows are appended as days roll over. Every row before the last one is
+ * closed: exits are chronological, so its cells never change again, except
+ * when a park is removed and its column is cleared.
+ *
+ * @param rows The days with exits, in increasing order.
+ * @param count The number of rows.
+ * @param capacity The number of rows allocated.
+ */
+typedef struct RevenueCube {
+    CubeRow *rows;
+    int count;
+    int capacity;
+} RevenueCube;
+
+/**
+ * @brief Output of 'f <park> <date>' for one day.
+ *
+ * @param day The day number.
+ * @param text The lines printed, not terminated.
+ * @param length The number of characters in text.
+ * @param capacity The number of characters allocated.
+ */
+typedef struct CachedDay {
+    long long day;
+    char *text;
+    int length;
+    int capacity;
+} CachedDay;
+
+/**
+ * @brief Outputs of the 'f' command of a park, kept between commands.
+ *
+ * Exits are chronological, so only the day of the latest exit can still
+ * change: the lines of the days before it are kept for good, and an exit
+ * only drops the output of its own day and the last line of the summary,
+ * which is formatted again from the cumulative revenue of the park.
+ *
+ * @param summary The lines of 'f <park>', not terminated.
+ * @param length The number of characters in summary.
+ * @param capacity The number of characters allocated.
+ * @param openStart Where the line of openDay starts in summary.
+ * @param openDay The day of the last line, or -1 before any exit.
+ * @param stale Whether the summary from openStart on is out of date.
+ * @param days The days asked for, in increasing order.
+ * @param count The number of days.
+ * @param dayCapacity The number of days allocated.
+ */
+typedef struct BillingCache {
+    char *summary;
+    int length;
+    int capacity;
+    int openStart;
+    long long openDay;
+    int stale;
+    CachedDay *days;
+    int count;
+    int dayCapacity;
+} BillingCache;
+
+
+BillingPrefix *billing_prefix_create(void);
+void billing_prefix_free(BillingPrefix *prefix);
+void billing_prefix_add(BillingPrefix *prefix, Date date, long long bill);
+long long billing_prefix_until(BillingPrefix *prefix, long long day);
+long long billing_range(BillingPrefix *prefix, Date from, Date to);
+RevenueCube *revenue_cube_create(void);
+void revenue_cube_free(RevenueCube *cube);
+void revenue_cube_add(RevenueCube *cube, int parkId, Date date, long long bill);
+void revenue_cube_clear_park(RevenueCube *cube, int parkId);
+void revenue_cube_merge(RevenueCube *cube, int parkId, long long *days, long long *bills, int count);
+BillingCache *billing_cache_create(void);
+void billing_cache_free(BillingCache *cache);
+void billing_cache_clear(BillingCache *cache);
+void billing_cache_exit(BillingCache *cache, Date date);
+void show_cached_billing(BillingCache *cache, BillingPrefix *prefix);
+void show_cached_daily_billing(BillingCache *cache, BillingHashTable *billing, char *namePark, Date date);
+void show_revenue_report(RevenueCube *cube, Park *parksTotal, int parksCounter);
+
+#endif
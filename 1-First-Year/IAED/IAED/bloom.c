@@ -0,0 +1,181 @@
+/**
+ * @file bloom.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Blocked Bloom filter of every plate the vehicles table has seen.
+ *
+ * A 64-bit hash of the plate picks the block, and its two halves generate
+ * the BLOOM_HASHES bit positions inside it by double hashing.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proj.h"
+#include "accounting.h"
+#include "bloom.h"
+
+/**
+ * @brief Reads the expected fleet size from PROJ1_FLEET_SIZE.
+ *
+ * @return The size, or BLOOM_DEFAULT_FLEET if the variable is not a
+ * positive number.
+ */
+long long plate_filter_fleet_size(void) {
+    const char *value = getenv(BLOOM_FLEET_VARIABLE);
+    long long size = value ? atoll(value) : 0;
+    return size > 0 ? size : BLOOM_DEFAULT_FLEET;
+}
+
+/**
+ * @brief Creates an empty filter sized for a number of plates.
+ *
+ * @param expectedPlates Number of distinct plates expected.
+ *
+ * @return Pointer to the new filter, or NULL if memory allocation failed.
+ */
+PlateFilter *plate_filter_create(long long expectedPlates) {
+    PlateFilter *filter = mem_alloc(MEM_VEHICLES, sizeof(PlateFilter));
+    if (filter == NULL)
+        return NULL;
+
+    memset(filter, 0, sizeof(PlateFilter));
+    filter->blocks = (expectedPlates * BLOOM_BITS_PER_PLATE + 
+                        BLOOM_BLOCK_BITS - 1) / BLOOM_BLOCK_BITS;
+    filter->words = mem_alloc(MEM_VEHICLES, filter->blocks * 
+                        BLOOM_BLOCK_WORDS * sizeof(unsigned long long));
+    if (filter->words == NULL) {
+        mem_free(MEM_VEHICLES, filter, sizeof(PlateFilter));
+        return NULL;
+    }
+
+    memset(filter->words, 0, 
+            filter->blocks * BLOOM_BLOCK_WORDS * sizeof(unsigned long long));
+    return filter;
+}
+
+/**
+ * @brief Frees a filter.
+ *
+ * @param filter The filter to free, may be NULL.
+ */
+void plate_filter_free(PlateFilter *filter) {
+    if (filter == NULL)
+        return;
+
+    mem_free(MEM_VEHICLES, filter->words, 
+            filter->blocks * BLOOM_BLOCK_WORDS * sizeof(unsigned long long));
+    mem_free(MEM_VEHICLES, filter, sizeof(PlateFilter));
+}
+
+/**
+ * @brief Hashes a plate with FNV-1a and a final mix.
+ *
+ * @param plate The plate.
+ * @return The hash.
+ */
+static unsigned long long hash_plate(char *plate) {
+    unsigned long long hash = 14695981039346656037ULL;
+
+    while (*plate)
+        hash = (hash ^ (unsigned char)*plate++) * 1099511628211ULL;
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/**
+ * @brief Adds a plate to the filter.
+ *
+ * @param filter The filter, may be NULL.
+ * @param plate The plate.
+ */
+void plate_filter_add(PlateFilter *filter, char *plate) {
+    if (filter == NULL)
+        return;
+
+    unsigned long long hash = hash_plate(plate);
+    unsigned long long *block = filter->words + 
+                    (hash % filter->blocks) * BLOOM_BLOCK_WORDS;
+    unsigned int step = (unsigned int)(hash >> 32) | 1;
+    unsigned int bit = (unsigned int)hash;
+
+    for (int i = 0; i < BLOOM_HASHES; i++, bit += step) {
+        unsigned int position = bit % BLOOM_BLOCK_BITS;
+        block[position / 64] |= 1ULL << (position % 64);
+    }
+    filter->inserted++;
+}
+
+/**
+ * @brief Checks whether a plate may have been added.
+ *
+ * @param filter The filter, or NULL to let every lookup through.
+ * @param plate The plate.
+ *
+ * @return 0 if the plate was never added, 1 if it may have been.
+ */
+int plate_filter_may_contain(PlateFilter *filter, char *plate) {
+    if (filter == NULL)
+        return 1;
+
+    unsigned long long hash = hash_plate(plate);
+    unsigned long long *block = filter->words + 
+                    (hash % filter->blocks) * BLOOM_BLOCK_WORDS;
+    unsigned int step = (unsigned int)(hash >> 32) | 1;
+    unsigned int bit = (unsigned int)hash;
+
+    for (int i = 0; i < BLOOM_HASHES; i++, bit += step) {
+        unsigned int position = bit % BLOOM_BLOCK_BITS;
+        if (!(block[position / 64] & (1ULL << (position % 64)))) {
+            filter->negatives++;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Notes that a lookup the filter let through found nothing.
+ *
+ * @param filter The filter, may be NULL.
+ */
+void plate_filter_missed(PlateFilter *filter) {
+    if (filter != NULL)
+        filter->falsePositives++;
+}
+
+/**
+ * @brief Prints the state of the filter.
+ *
+ * Prints `bloom <bits> <plates added> <fill> <estimated fp rate> <negatives>
+ * <false positives> <observed fp rate>`. The estimate is the chance that
+ * all the bits of an absent plate are set, given the fraction of set bits;
+ * the observed rate is over the lookups of absent plates.
+ *
+ * @param filter The filter, may be NULL.
+ */
+void show_plate_filter(PlateFilter *filter) {
+    if (filter == NULL)
+        return;
+
+    long long words = filter->blocks * BLOOM_BLOCK_WORDS, set = 0;
+    for (long long i = 0; i < words; i++)
+        set += __builtin_popcountll(filter->words[i]);
+
+    double fill = (double)set / (words * 64), estimate = 1;
+    for (int i = 0; i < BLOOM_HASHES; i++)
+        estimate *= fill;
+    long long absent = filter->negatives + filter->falsePositives;
+
+    printf("bloom %lld %lld %.4f %.6f %lld %lld %.6f%c",
+        words * 64,
+        filter->inserted,
+        fill,
+        estimate,
+        filter->negatives,
+        filter->falsePositives,
+        absent > 0 ? (double)filter->falsePositives / absent : 0.0,
+        NEW_LINE);
+}
@@ -0,0 +1,50 @@
+/**
+ * @file bloom.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Blocked Bloom filter of every plate the vehicles table has seen.
+ */
+#ifndef BLOOM_H
+#define BLOOM_H
+
+/// One block is a cache line of 512 bits
+#define BLOOM_BLOCK_WORDS 8
+#define BLOOM_BLOCK_BITS (BLOOM_BLOCK_WORDS * 64)
+/// About 1% false positives at the expected fleet size
+#define BLOOM_BITS_PER_PLATE 10
+#define BLOOM_HASHES 7
+#define BLOOM_DEFAULT_FLEET 100000
+#define BLOOM_FLEET_VARIABLE "PROJ1_FLEET_SIZE"
+
+/**
+ * @brief Bloom filter of plates, split in cache line blocks so a query
+ * reads a single line.
+ *
+ * Plates are never removed, so a plate the filter rejects was never in the
+ * table and the lookup can stop there.
+ *
+ * @param words The bits, BLOOM_BLOCK_WORDS words per block.
+ * @param blocks Number of blocks.
+ * @param inserted Plates added, once each time one joins the table.
+ * @param negatives Lookups answered by the filter alone.
+ * @param falsePositives Lookups the filter let through that then missed,
+ * for plates the table never held.
+ */
+typedef struct PlateFilter {
+    unsigned long long *words;
+    long long blocks;
+    long long inserted;
+    long long negatives;
+    long long falsePositives;
+} PlateFilter;
+
+
+PlateFilter *plate_filter_create(long long expectedPlates);
+long long plate_filter_fleet_size(void);
+void plate_filter_free(PlateFilter *filter);
+void plate_filter_add(PlateFilter *filter, char *plate);
+int plate_filter_may_contain(PlateFilter *filter, char *plate);
+void plate_filter_missed(PlateFilter *filter);
+void show_plate_filter(PlateFilter *filter);
+
+#endif
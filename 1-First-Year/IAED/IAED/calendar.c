@@ -0,0 +1,131 @@
+/**
+ * @file calendar.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Constant time date arithmetic for the park management system.
+ *
+ * Leap days are counted in closed form (years divisible by 4, except those
+ * divisible by 100 unless also divisible by 400), so the cost of any of
+ * these functions does not depend on how far apart the dates are.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "proj.h"
+#include "validation.h"
+#include "calendar.h"
+
+/**
+ * @brief Counts the leap days in the years before a given year.
+ *
+ * @param year The year, counted from 1.
+ * @return The number of 29 February days from year 1 to year - 1.
+ */
+long long leap_days_before_year(int year) {
+    long long previous = year - 1;
+
+    return previous / 4 - previous / 100 + previous / 400;
+}
+
+/**
+ * @brief Counts the 29 February days that start before a given date.
+ *
+ * @param date The date to count up to.
+ * @return The number of 29 February days from year 1 until the date.
+ */
+long long feb29_before(Date date) {
+    long long count = leap_days_before_year(date.year);
+
+    if (date.month > FEBRUARY && is_leap_year(date.year))
+        count++;
+    return count;
+}
+
+/**
+ * @brief Numbers a date by the days elapsed since 01-01-0001.
+ *
+ * @param date The date to number, its time is ignored.
+ * @return The number of days between 01-01-0001 and the date.
+ */
+long long day_number(Date date) {
+    const int daysBeforeMonth[] = DAYS_BEFORE_MONTH;
+    long long days = (long long)(date.year - 1) * DAYS_PER_YEAR;
+
+    days += leap_days_before_year(date.year);
+    days += daysBeforeMonth[date.month - 1];
+    if (date.month > FEBRUARY && is_leap_year(date.year))
+        days++;
+
+    return days + date.day - 1;
+}
+
+/**
+ * @brief Numbers a date and time by the minutes elapsed since 01-01-0001.
+ *
+ * @param date The date to number.
+ * @return The number of minutes between 01-01-0001 00:00 and the date.
+ */
+long long minute_number(Date date) {
+    return day_number(date) * MINUTES_PER_DAY +
+            date.time.hour * MINUTES_PER_HOUR +
+            date.time.minute;
+}
+
+/**
+ * @brief Finds the date with a given day number.
+ *
+ * Counts from 1 March 0000 so that the leap day falls at the end of each
+ * year, which makes the month a simple function of the day of the year.
+ *
+ * @param days The number of days since 01-01-0001, not negative.
+ * @return The date, at 00:00.
+ */
+Date date_from_day_number(long long days) {
+    Date date = {0, 0, 0, {0, 0}};
+    long long shifted = days + DAYS_FROM_MARCH_0000;
+    long long era = shifted / DAYS_PER_400_YEARS;
+    long long dayOfEra = shifted - era * DAYS_PER_400_YEARS;
+    long long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - 
+                            dayOfEra / (DAYS_PER_400_YEARS - 1)) / 
+                            DAYS_PER_YEAR;
+    long long dayOfYear = dayOfEra - (DAYS_PER_YEAR * yearOfEra + 
+                            yearOfEra / 4 - yearOfEra / 100);
+    long long monthFromMarch = (5 * dayOfYear + 2) / 153;
+
+    date.day = dayOfYear - (153 * monthFromMarch + 2) / 5 + 1;
+    date.month = monthFromMarch < 10 ? monthFromMarch + 3 : monthFromMarch - 9;
+    date.year = yearOfEra + era * 400 + (date.month <= FEBRUARY);
+    return date;
+}
+
+/**
+ * @brief Finds the date and time with a given minute number.
+ *
+ * @param minutes The number of minutes since 01-01-0001 00:00.
+ * @return The date and time.
+ */
+Date date_from_minute_number(long long minutes) {
+    long long days = minutes / MINUTES_PER_DAY;
+    int minuteOfDay = minutes - days * MINUTES_PER_DAY;
+    Date date = date_from_day_number(days);
+
+    date.time.hour = minuteOfDay / MINUTES_PER_HOUR;
+    date.time.minute = minuteOfDay % MINUTES_PER_HOUR;
+    return date;
+}
+
+/**
+ * @brief Computes the minutes a vehicle is charged for between two dates.
+ *
+ * This is the time between the dates without the 29 February days in
+ * between, during which the parks are closed.
+ *
+ * @param start The start date.
+ * @param end The end date.
+ * @return The chargeable minutes between the start and end dates.
+ */
+long long chargeable_minutes(Date start, Date end) {
+    long long closedDays = feb29_before(end) - feb29_before(start);
+
+    return minute_number(end) - minute_number(start) -
+            closedDays * MINUTES_PER_DAY;
+}
@@ -0,0 +1,28 @@
+/**
+ * @file calendar.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Constant time date arithmetic for the park management system.
+ *
+ * Dates are numbered in the proleptic Gregorian calendar from 01-01-0001.
+ * Parks are closed on 29 February, so that day never counts towards the
+ * time that is charged.
+ */
+#ifndef CALENDAR_H
+#define CALENDAR_H
+
+#define DAYS_BEFORE_MONTH {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334}
+#define MINUTES_PER_DAY (HOURS_PER_DAY * MINUTES_PER_HOUR)
+/// Constants of the inverse of day_number, which counts from 1 March 0000
+#define DAYS_PER_400_YEARS 146097
+#define DAYS_FROM_MARCH_0000 306
+
+long long leap_days_before_year(int year);
+long long feb29_before(Date date);
+long long day_number(Date date);
+long long minute_number(Date date);
+Date date_from_day_number(long long days);
+Date date_from_minute_number(long long minutes);
+long long chargeable_minutes(Date start, Date end);
+
+#endif
@@ -0,0 +1,216 @@
+/**
+ * @file chains.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Chain length statistics of the vehicles and billing hash tables.
+ *
+ * Every insertion and removal updates the chain length of its bucket, the
+ * histogram of lengths and the sum of their squares in constant time, which
+ * is all the expected probe counts need.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proj.h"
+#include "chains.h"
+#include "accounting.h"
+
+/**
+ * @brief Creates the statistics of an empty table.
+ *
+ * @param buckets Number of buckets of the table.
+ * @param chainsOnMiss Chains a lookup walks when the key is absent.
+ * @param tag The tag of the table, which the statistics are counted with.
+ *
+ * @return Pointer to the statistics, or NULL if memory allocation failed.
+ */
+ChainStats *chain_stats_create(int buckets, int chainsOnMiss, MemTag tag) {
+    ChainStats *stats = mem_calloc(tag, 1, sizeof(ChainStats));
+    if (stats == NULL)
+        return NULL;
+
+    stats->tag = tag;
+    stats->buckets = buckets;
+    stats->histogramSize = CHAINS_INITIAL_HISTOGRAM;
+    stats->lengths = mem_calloc(tag, buckets, sizeof(int));
+    stats->histogram = mem_calloc(tag, CHAINS_INITIAL_HISTOGRAM, 
+                                sizeof(long long));
+    if (stats->lengths == NULL || stats->histogram == NULL) {
+        chain_stats_free(stats);
+        return NULL;
+    }
+
+    stats->histogram[0] = buckets;
+    stats->chainsOnMiss = chainsOnMiss;
+    return stats;
+}
+
+/**
+ * @brief Frees the statistics of a table.
+ *
+ * @param stats The statistics, may be NULL.
+ */
+void chain_stats_free(ChainStats *stats) {
+    if (stats == NULL)
+        return;
+
+    mem_free(stats->tag, stats->lengths, stats->buckets * sizeof(int));
+    mem_free(stats->tag, stats->histogram, 
+            stats->histogramSize * sizeof(long long));
+    mem_free(stats->tag, stats, sizeof(ChainStats));
+}
+
+/**
+ * @brief Finds the histogram entry of a chain length.
+ *
+ * A histogram that could not grow counts the longer chains in its last
+ * entry.
+ *
+ * @param stats The statistics.
+ * @param length The chain length.
+ * @return The index in the histogram.
+ */
+static int histogram_slot(ChainStats *stats, int length) {
+    return length < stats->histogramSize ? length : stats->histogramSize - 1;
+}
+
+/**
+ * @brief Doubles the histogram, sorting out the chains its last entry held
+ * while it could not grow.
+ *
+ * @param stats The statistics.
+ * @return 1 on success, 0 if memory allocation failed.
+ */
+static int grow_histogram(ChainStats *stats) {
+    int size = stats->histogramSize;
+    int capped = stats->maxChain >= size;
+
+    long long *grown = mem_realloc(stats->tag, stats->histogram, 
+                                size * sizeof(long long),
+                                2 * size * sizeof(long long));
+    if (grown == NULL)
+        return 0;
+    memset(grown + size, 0, size * sizeof(long long));
+    stats->histogram = grown;
+    stats->histogramSize *= 2;
+
+    if (capped) {
+        memset(grown, 0, stats->histogramSize * sizeof(long long));
+        for (int i = 0; i < stats->buckets; i++)
+            grown[histogram_slot(stats, stats->lengths[i])]++;
+    }
+    return 1;
+}
+
+/**
+ * @brief Notes that a node was added to a bucket.
+ *
+ * The node is counted even if the histogram cannot grow, so a later
+ * removal finds the totals as they should be.
+ *
+ * @param stats The statistics, may be NULL.
+ * @param bucket The bucket.
+ * @param secondary Whether the bucket came from the secondary hash.
+ */
+void chain_stats_insert(ChainStats *stats, int bucket, int secondary) {
+    if (stats == NULL)
+        return;
+
+    int length = stats->lengths[bucket];
+
+    if (length + 1 >= stats->histogramSize)
+        grow_histogram(stats);
+
+    stats->lengths[bucket]++;
+    stats->histogram[histogram_slot(stats, length)]--;
+    stats->histogram[histogram_slot(stats, length + 1)]++;
+    stats->entries++;
+    stats->sumSquares += 2 * length + 1;
+    stats->secondary += secondary;
+    if (length + 1 > stats->maxChain)
+        stats->maxChain = length + 1;
+}
+
+/**
+ * @brief Notes that a node was removed from a bucket.
+ *
+ * @param stats The statistics, may be NULL.
+ * @param bucket The bucket.
+ * @param secondary Whether the bucket came from the secondary hash.
+ */
+void chain_stats_remove(ChainStats *stats, int bucket, int secondary) {
+    if (stats == NULL || stats->lengths[bucket] == 0)
+        return;
+
+    int length = stats->lengths[bucket]--;
+
+    stats->histogram[histogram_slot(stats, length)]--;
+    stats->histogram[histogram_slot(stats, length - 1)]++;
+    stats->entries--;
+    stats->sumSquares -= 2 * length - 1;
+    stats->secondary -= secondary;
+
+    /// Past the histogram, the longest chain is looked for in the buckets
+    if (stats->maxChain >= stats->histogramSize) {
+        if (length == stats->maxChain) {
+            stats->maxChain = 0;
+            for (int i = 0; i < stats->buckets; i++)
+                if (stats->lengths[i] > stats->maxChain)
+                    stats->maxChain = stats->lengths[i];
+        }
+        return;
+    }
+
+    /// The longest chain only moves down past lengths no bucket has
+    while (stats->maxChain > 0 && stats->histogram[stats->maxChain] == 0)
+        stats->maxChain--;
+}
+
+/**
+ * @brief Prints the statistics of a table.
+ *
+ * Prints `<table> <entries> <buckets> <load factor> <longest chain>
+ * <secondary fraction> <probes per hit> <probes per miss>`, then
+ * `<table> chains` followed by `<length>:<buckets>` for every length some
+ * chain has, the last one as `<length>+:<buckets>` if the histogram could
+ * not grow to the longest chain. A hit walks half its chain on average, plus the whole primary
+ * chain when the node lies in its secondary bucket; a miss walks
+ * chainsOnMiss chains of average length.
+ *
+ * @param stats The statistics, may be NULL.
+ * @param table Name of the table.
+ */
+void show_chain_stats(ChainStats *stats, const char *table) {
+    if (stats == NULL)
+        return;
+
+    double load = (double)stats->entries / stats->buckets;
+    double secondary = 0, hit = 0;
+
+    if (stats->entries > 0) {
+        secondary = (double)stats->secondary / stats->entries;
+        hit = (double)(stats->sumSquares + stats->entries) /
+                (2 * stats->entries) + secondary * load;
+    }
+
+    printf("%s %lld %d %.3f %d %.3f %.2f %.2f%c",
+        table,
+        stats->entries,
+        stats->buckets,
+        load,
+        stats->maxChain,
+        secondary,
+        hit,
+        load * stats->chainsOnMiss,
+        NEW_LINE);
+
+    printf("%s chains", table);
+    int last = histogram_slot(stats, stats->maxChain);
+    for (int length = 0; length <= last; length++)
+        if (stats->histogram[length] > 0)
+            printf(" %d%s:%lld", 
+                length, 
+                length < stats->maxChain && length == last ? "+" : "", 
+                stats->histogram[length]);
+    printf("%c", NEW_LINE);
+}
@@ -0,0 +1,50 @@
+/**
+ * @file chains.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Chain length statistics of the vehicles and billing hash tables.
+ */
+#ifndef CHAINS_H
+#define CHAINS_H
+
+#include "accounting.h"
+
+#define CHAINS_INITIAL_HISTOGRAM 16
+
+/**
+ * @brief Statistics of the chains of a hash table, kept up to date on every
+ * insertion and removal, so reading them costs nothing.
+ *
+ * @param lengths Length of the chain of each bucket.
+ * @param buckets Number of buckets.
+ * @param histogram Number of buckets by chain length. If it could not grow,
+ * its last entry also counts the longer chains.
+ * @param histogramSize Number of lengths the histogram can hold.
+ * @param entries Number of nodes in the table.
+ * @param sumSquares Sum of the squares of the chain lengths.
+ * @param secondary Nodes placed in the bucket of the secondary hash.
+ * @param maxChain The longest chain.
+ * @param chainsOnMiss Chains a lookup walks when the key is absent.
+ * @param tag The tag of the table, which the statistics are counted with.
+ */
+typedef struct ChainStats {
+    int *lengths;
+    int buckets;
+    long long *histogram;
+    int histogramSize;
+    long long entries;
+    long long sumSquares;
+    long long secondary;
+    int maxChain;
+    int chainsOnMiss;
+    MemTag tag;
+} ChainStats;
+
+
+ChainStats *chain_stats_create(int buckets, int chainsOnMiss, MemTag tag);
+void chain_stats_free(ChainStats *stats);
+void chain_stats_insert(ChainStats *stats, int bucket, int secondary);
+void chain_stats_remove(ChainStats *stats, int bucket, int secondary);
+void show_chain_stats(ChainStats *stats, const char *table);
+
+#endif
@@ -0,0 +1,257 @@
+/**
+ * @file dwell.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Streaming percentiles of how long vehicles stay in each park.
+ *
+ * Every billed exit adds its chargeable minutes to the all-time sketch of
+ * its park and to the sketch of its exit day. Exits are chronological, so
+ * only the last day ever changes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proj.h"
+#include "calendar.h"
+#include "dwell.h"
+#include "accounting.h"
+
+/**
+ * @brief Finds the bucket of a duration.
+ *
+ * @param minutes The duration, in minutes.
+ * @return The bucket index.
+ */
+static int bucket_of(long long minutes) {
+    if (minutes < DWELL_EXACT)
+        return minutes < 0 ? 0 : (int)minutes;
+    if (minutes >= 1LL << DWELL_MAX_BITS)
+        return DWELL_BUCKETS - 1;
+
+    int exponent = 63 - __builtin_clzll((unsigned long long)minutes);
+    int sub = (int)(minutes >> (exponent - DWELL_SUB_BITS)) &
+                (DWELL_SUB_BUCKETS - 1);
+    return DWELL_EXACT + (exponent - 6) * DWELL_SUB_BUCKETS + sub;
+}
+
+/**
+ * @brief Finds the duration a bucket stands for, the middle of its range.
+ *
+ * @param bucket The bucket index.
+ * @return The duration, in minutes.
+ */
+static long long bucket_value(int bucket) {
+    if (bucket < DWELL_EXACT)
+        return bucket;
+
+    int exponent = (bucket - DWELL_EXACT) / DWELL_SUB_BUCKETS + 6;
+    int sub = (bucket - DWELL_EXACT) % DWELL_SUB_BUCKETS;
+    long long width = 1LL << (exponent - DWELL_SUB_BITS);
+    return (DWELL_SUB_BUCKETS + sub) * width + width / 2;
+}
+
+/**
+ * @brief Empties a sketch.
+ *
+ * @param sketch The sketch.
+ */
+void dwell_sketch_clear(DwellSketch *sketch) {
+    memset(sketch, 0, sizeof(DwellSketch));
+}
+
+/**
+ * @brief Adds a stay to a sketch.
+ *
+ * @param sketch The sketch.
+ * @param minutes The duration of the stay.
+ */
+void dwell_sketch_add(DwellSketch *sketch, long long minutes) {
+    if (sketch->count == 0 || minutes < sketch->min)
+        sketch->min = minutes;
+    if (sketch->count == 0 || minutes > sketch->max)
+        sketch->max = minutes;
+
+    sketch->count++;
+    sketch->buckets[bucket_of(minutes)]++;
+}
+
+/**
+ * @brief Adds every stay of a sketch to another one.
+ *
+ * @param into The sketch that receives the stays.
+ * @param from The sketch to merge.
+ */
+void dwell_sketch_merge(DwellSketch *into, DwellSketch *from) {
+    if (from->count == 0)
+        return;
+
+    if (into->count == 0 || from->min < into->min)
+        into->min = from->min;
+    if (into->count == 0 || from->max > into->max)
+        into->max = from->max;
+
+    into->count += from->count;
+    for (int i = 0; i < DWELL_BUCKETS; i++)
+        into->buckets[i] += from->buckets[i];
+}
+
+/**
+ * @brief Estimates a percentile of the stays in a sketch.
+ *
+ * Uses the nearest rank, so the result is the duration of a stay that was
+ * actually seen, up to the precision of its bucket.
+ *
+ * @param sketch The sketch, with at least one stay.
+ * @param percent The percentile, from 1 to 100.
+ * @return The estimated duration, in minutes.
+ */
+long long dwell_sketch_percentile(DwellSketch *sketch, int percent) {
+    long long rank = (sketch->count * percent + 99) / 100;
+    long long seen = 0;
+    int bucket = 0;
+
+    if (rank < 1)
+        rank = 1;
+
+    for (; bucket < DWELL_BUCKETS - 1; bucket++) {
+        seen += sketch->buckets[bucket];
+        if (seen >= rank)
+            break;
+    }
+
+    long long value = bucket_value(bucket);
+    if (value < sketch->min)
+        value = sketch->min;
+    if (value > sketch->max)
+        value = sketch->max;
+    return value;
+}
+
+/**
+ * @brief Creates an empty series of stay durations.
+ *
+ * @return Pointer to the new series, or NULL if memory allocation failed.
+ */
+DwellSeries *dwell_create(void) {
+    DwellSeries *series = mem_alloc(MEM_PARKS, sizeof(DwellSeries));
+    if (series == NULL)
+        return NULL;
+
+    dwell_sketch_clear(&series->total);
+    series->days = mem_alloc(MEM_PARKS, DWELL_INITIAL_DAYS * sizeof(long long));
+    series->daily = mem_alloc(MEM_PARKS,
+                            DWELL_INITIAL_DAYS * sizeof(DwellSketch));
+    series->count = 0;
+    series->capacity = DWELL_INITIAL_DAYS;
+    return series;
+}
+
+/**
+ * @brief Frees a series of stay durations.
+ *
+ * @param series The series to free, may be NULL.
+ */
+void dwell_free(DwellSeries *series) {
+    if (series == NULL)
+        return;
+
+    mem_free(MEM_PARKS, series->days, series->capacity * sizeof(long long));
+    mem_free(MEM_PARKS, series->daily,
+            series->capacity * sizeof(DwellSketch));
+    mem_free(MEM_PARKS, series, sizeof(DwellSeries));
+}
+
+/**
+ * @brief Records the duration of a billed stay.
+ *
+ * @param series The series of the park, may be NULL.
+ * @param date The date of the exit, never before the previous one.
+ * @param minutes The chargeable minutes of the stay.
+ */
+void dwell_record(DwellSeries *series, Date date, long long minutes) {
+    if (series == NULL || series->days == NULL || series->daily == NULL)
+        return;
+
+    long long day = day_number(date);
+
+    if (series->count == 0 || series->days[series->count - 1] != day) {
+        if (series->count == series->capacity) {
+            int capacity = series->capacity * 2;
+
+            /// Both columns move at once, so a failure leaves them as they were
+            long long *days = mem_alloc(MEM_PARKS,
+                                        capacity * sizeof(long long));
+            DwellSketch *daily = mem_alloc(MEM_PARKS,
+                                        capacity * sizeof(DwellSketch));
+            if (days == NULL || daily == NULL) {
+                mem_free(MEM_PARKS, days, capacity * sizeof(long long));
+                mem_free(MEM_PARKS, daily, capacity * sizeof(DwellSketch));
+                return;
+            }
+
+            memcpy(days, series->days, series->count * sizeof(long long));
+            memcpy(daily, series->daily, series->count * sizeof(DwellSketch));
+            mem_free(MEM_PARKS, series->days,
+                    series->capacity * sizeof(long long));
+            mem_free(MEM_PARKS, series->daily,
+                    series->capacity * sizeof(DwellSketch));
+            series->days = days;
+            series->daily = daily;
+            series->capacity = capacity;
+        }
+
+        series->days[series->count] = day;
+        dwell_sketch_clear(&series->daily[series->count++]);
+    }
+
+    dwell_sketch_add(&series->daily[series->count - 1], minutes);
+    dwell_sketch_add(&series->total, minutes);
+}
+
+/**
+ * @brief Merges the sketches of the exits between two days, inclusive.
+ *
+ * @param series The series of the park, may be NULL.
+ * @param from The first day.
+ * @param to The last day.
+ * @param out The sketch that receives the merged stays.
+ */
+void dwell_range(DwellSeries *series, Date from, Date to, DwellSketch *out) {
+    long long first = day_number(from), last = day_number(to);
+
+    dwell_sketch_clear(out);
+    if (series == NULL)
+        return;
+
+    int low = 0, high = series->count;
+
+    /// Finds the first stored day not before the first one asked for
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (series->days[middle] < first)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    for (int i = low; i < series->count && series->days[i] <= last; i++)
+        dwell_sketch_merge(out, &series->daily[i]);
+}
+
+/**
+ * @brief Prints the number of stays and their percentiles.
+ *
+ * Prints `<stays> <p50> <p90> <p99>`, durations in minutes, or only `0`
+ * when there are no stays.
+ *
+ * @param sketch The sketch.
+ */
+void show_dwell(DwellSketch *sketch) {
+    int percentiles[DWELL_PERCENTILES_COUNT] = DWELL_PERCENTILES;
+
+    printf("%lld", sketch->count);
+    if (sketch->count > 0)
+        for (int i = 0; i < DWELL_PERCENTILES_COUNT; i++)
+            printf(" %lld", dwell_sketch_percentile(sketch, percentiles[i]));
+    printf("%c", NEW_LINE);
+}
@@ -0,0 +1,70 @@
+/**
+ * @file dwell.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Streaming percentiles of how long vehicles stay in each park.
+ */
+#ifndef DWELL_H
+#define DWELL_H
+
+/// Durations below this many minutes get a bucket each
+#define DWELL_EXACT 64
+/// Buckets per power of two above DWELL_EXACT, about 3% relative error
+#define DWELL_SUB_BITS 4
+#define DWELL_SUB_BUCKETS (1 << DWELL_SUB_BITS)
+/// Longest duration told apart, in minutes, about 500000 years
+#define DWELL_MAX_BITS 38
+#define DWELL_BUCKETS \
+    (DWELL_EXACT + (DWELL_MAX_BITS - 6) * DWELL_SUB_BUCKETS)
+#define DWELL_INITIAL_DAYS 32
+#define DWELL_PERCENTILES {50, 90, 99}
+#define DWELL_PERCENTILES_COUNT 3
+
+/**
+ * @brief Fixed memory histogram of stay durations.
+ *
+ * Buckets are exact for short stays and logarithmic above, so any
+ * percentile is found with a single walk over DWELL_BUCKETS counters. Two
+ * sketches are merged by adding their counters.
+ *
+ * @param count Number of stays.
+ * @param min Shortest stay, in minutes.
+ * @param max Longest stay, in minutes.
+ * @param buckets Number of stays in each bucket.
+ */
+typedef struct DwellSketch {
+    long long count;
+    long long min;
+    long long max;
+    unsigned int buckets[DWELL_BUCKETS];
+} DwellSketch;
+
+/**
+ * @brief Stay durations of a park, all-time and by exit day.
+ *
+ * @param total The sketch of every stay.
+ * @param days The day numbers with exits, in increasing order.
+ * @param daily The sketch of the stays that ended on each day.
+ * @param count Number of days stored.
+ * @param capacity Number of days allocated.
+ */
+typedef struct DwellSeries {
+    DwellSketch total;
+    long long *days;
+    DwellSketch *daily;
+    int count;
+    int capacity;
+} DwellSeries;
+
+
+void dwell_sketch_clear(DwellSketch *sketch);
+void dwell_sketch_add(DwellSketch *sketch, long long minutes);
+void dwell_sketch_merge(DwellSketch *into, DwellSketch *from);
+long long dwell_sketch_percentile(DwellSketch *sketch, int percent);
+DwellSeries *dwell_create(void);
+void dwell_free(DwellSeries *series);
+void dwell_record(DwellSeries *series, Date date, long long minutes);
+void dwell_range(DwellSeries *series, Date from, Date to, DwellSketch *out);
+void show_dwell(DwellSketch *sketch);
+
+#endif
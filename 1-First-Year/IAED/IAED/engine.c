@@ -0,0 +1,478 @@
+/**
+ * @file engine.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Embeddable interface to the parking engine.
+ *
+ * The handle bundles the structures that the commands receive one by one.
+ * Every function converts its typed arguments and goes through the same
+ * paths as the text commands, with the output turned off, so both front
+ * ends accept and reject exactly the same requests. The reason for a
+ * rejection is the code the failing check passed to reject.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proj.h"
+#include "movements.h"
+#include "auxiliary.h"
+#include "validation.h"
+#include "billing.h"
+#include "plates.h"
+#include "store.h"
+#include "accounting.h"
+#include "trace.h"
+#include "gates.h"
+#include "engine.h"
+
+/**
+ * @brief The state of one engine.
+ *
+ * @param parks The array of PARK_MAX parks.
+ * @param parksCounter The number of parks in use.
+ * @param head Head of the double linked list of movements.
+ * @param vehicles Hash table of vehicle movements.
+ * @param billing Billing hash table.
+ */
+struct Engine {
+    Park *parks;
+    int parksCounter;
+    Movement *head;
+    HashTable *vehicles;
+    BillingHashTable *billing;
+};
+
+/**
+ * @brief Converts an engine date to the date of the commands.
+ */
+static Date to_date(EngineDate date) {
+    Date converted = {date.day, date.month, date.year,
+                    {date.hour, date.minute}};
+    return converted;
+}
+
+/**
+ * @brief Converts a date of the commands to an engine date.
+ */
+static EngineDate from_date(Date date) {
+    EngineDate converted = {date.day, date.month, date.year,
+                            date.time.hour, date.time.minute};
+    return converted;
+}
+
+/**
+ * @brief Copies a plate into a buffer the command paths can take.
+ *
+ * @param plate The plate given by the caller.
+ * @param buffer Buffer of PLATE_LENGTH + 1 characters.
+ * @return 1 on success, 0 if the plate is too long to be valid.
+ */
+static int copy_plate(const char *plate, char *buffer) {
+    if (plate == NULL || strlen(plate) > PLATE_LENGTH)
+        return 0;
+
+    strcpy(buffer, plate);
+    return 1;
+}
+
+/**
+ * @brief Finds the identifier of a park by name, without reporting errors.
+ *
+ * @return The identifier, or -1 if there is no such park.
+ */
+static int park_id_of(Engine *engine, char *parkName) {
+    for (int i = 0; i < engine->parksCounter; i++) {
+        if (strcmp(engine->parks[i].parkName, parkName) == 0)
+            return engine->parks[i].id;
+    }
+    return -1;
+}
+
+/**
+ * @brief Applies one entry or exit to a park already looked up.
+ *
+ * @param engine The engine.
+ * @param park The park, or NULL if the identifier matched none.
+ * @param plate The vehicle plate.
+ * @param date The date of the movement.
+ * @param command ENGINE_ENTRY or ENGINE_EXIT.
+ * @param payment Where to store the amount charged by an exit, may be NULL.
+ * @return ENGINE_OK or the reason of the rejection.
+ */
+static int apply(Engine *engine,
+                Park *park,
+                char *plate,
+                Date date,
+                char command,
+                long long *payment) {
+
+    Movement *movement;
+
+    if (command != ENGINE_ENTRY && command != ENGINE_EXIT)
+        return ENGINE_INVALID_EVENT;
+    if (park == NULL)
+        return ENGINE_NO_SUCH_PARKING;
+
+    if (command == ENGINE_ENTRY)
+        movement = enter_vehicle(engine->parks,
+                                &engine->parksCounter,
+                                park->parkName,
+                                plate,
+                                &date,
+                                &engine->head,
+                                engine->vehicles);
+    else
+        movement = exit_vehicle(engine->parks,
+                                &engine->parksCounter,
+                                park->parkName,
+                                plate,
+                                &date,
+                                &engine->head,
+                                engine->vehicles,
+                                engine->billing,
+                                payment);
+
+    return movement != NULL ? ENGINE_OK : last_rejection();
+}
+
+/**
+ * @brief Creates an engine with no parks, and turns the output of the
+ * commands off while it exists.
+ *
+ * @return Pointer to the new engine, or NULL if memory allocation failed.
+ */
+Engine *engine_create(void) {
+    Engine *engine = mem_alloc(MEM_BUFFERS, sizeof(Engine));
+    if (engine == NULL)
+        return NULL;
+
+    initialize_program(&engine->parks,
+                        &engine->parksCounter,
+                        &engine->head,
+                        &engine->vehicles,
+                        &engine->billing);
+    set_echo(0);
+    return engine;
+}
+
+/**
+ * @brief Frees an engine and everything it holds. The output of the
+ * commands comes back once no other engine is left.
+ *
+ * @param engine The engine to free, may be NULL.
+ */
+void engine_free(Engine *engine) {
+    if (engine == NULL)
+        return;
+
+    free_program(engine->parks,
+                &engine->parksCounter,
+                &engine->head,
+                engine->vehicles,
+                engine->billing);
+    TRACE_DUMP();
+    mem_free(MEM_BUFFERS, engine, sizeof(Engine));
+    set_echo(1);
+}
+
+/**
+ * @brief Packs a plate for an EngineEvent.
+ *
+ * @param plate The plate, in the "XX-XX-XX" layout.
+ * @return The key of the plate, or 0 if the plate is not valid.
+ */
+unsigned int engine_plate_key(const char *plate) {
+    return plate_to_key(plate);
+}
+
+/**
+ * @brief Adds a park, as the 'p' command does.
+ *
+ * @param engine The engine.
+ * @param name The name of the park, copied.
+ * @param capacity The number of places.
+ * @param preValue Price of 15 minutes in the first hour, in cents.
+ * @param afterValue Price of 15 minutes after the first hour, in cents.
+ * @param maxValue Maximum price of a day, in cents, at most COST_MAX units.
+ * @param parkId Where to store the identifier of the new park, may be NULL.
+ * @return ENGINE_OK or the reason the park was refused.
+ */
+int engine_add_park(Engine *engine,
+                    const char *name,
+                    int capacity,
+                    int preValue,
+                    int afterValue,
+                    int maxValue,
+                    int *parkId) {
+
+    char *namePark = mem_strdup(MEM_BUFFERS, name);
+    if (namePark == NULL)
+        return ENGINE_NO_MEMORY;
+
+    /// The checks work in currency units, as for the 'p' command
+    if (!can_add_park(engine->parks,
+                    namePark,
+                    capacity,
+                    (double)preValue / CENTS_PER_UNIT,
+                    (double)afterValue / CENTS_PER_UNIT,
+                    (double)maxValue / CENTS_PER_UNIT,
+                    engine->parksCounter)) {
+        mem_free_string(MEM_BUFFERS, namePark);
+        return last_rejection();
+    }
+
+    Charging charge = {preValue, afterValue, maxValue};
+    mem_retag(MEM_BUFFERS, MEM_PARKS, strlen(namePark) + 1);
+    Park *park = insert_park(engine->parks,
+                            namePark,
+                            capacity,
+                            charge,
+                            &engine->parksCounter);
+    if (parkId != NULL)
+        *parkId = park->id;
+    return ENGINE_OK;
+}
+
+/**
+ * @brief Removes a park with its movements and billing, as the 'r' command
+ * does.
+ *
+ * @param engine The engine.
+ * @param parkId The identifier of the park.
+ * @return ENGINE_OK or the reason the park was not removed.
+ */
+int engine_remove_park(Engine *engine, int parkId) {
+    Park *park = find_park_by_id(engine->parks, engine->parksCounter, parkId);
+    if (park == NULL)
+        return ENGINE_NO_SUCH_PARKING;
+
+    /// The park frees its own name before the movements are unlinked
+    char *namePark = mem_strdup(MEM_BUFFERS, park->parkName);
+    if (namePark == NULL)
+        return ENGINE_NO_MEMORY;
+
+    remove_structures(engine->parks,
+                    &engine->parksCounter,
+                    namePark,
+                    &engine->head,
+                    engine->vehicles,
+                    engine->billing);
+    mem_free_string(MEM_BUFFERS, namePark);
+    return ENGINE_OK;
+}
+
+/**
+ * @brief Registers a vehicle entry, as the 'e' command does.
+ *
+ * @param engine The engine.
+ * @param parkId The identifier of the park.
+ * @param plate The vehicle plate.
+ * @param date The date of entry.
+ * @return ENGINE_OK or the reason the entry was rejected.
+ */
+int engine_enter(Engine *engine, int parkId, const char *plate, EngineDate date) {
+    char plateVehicle[PLATE_LENGTH + 1];
+
+    if (!copy_plate(plate, plateVehicle))
+        return ENGINE_INVALID_PLATE;
+
+    return apply(engine,
+                find_park_by_id(engine->parks, engine->parksCounter, parkId),
+                plateVehicle,
+                to_date(date),
+                ENGINE_ENTRY,
+                NULL);
+}
+
+/**
+ * @brief Registers a vehicle exit and bills the stay, as the 's' command
+ * does.
+ *
+ * @param engine The engine.
+ * @param parkId The identifier of the park.
+ * @param plate The vehicle plate.
+ * @param date The date of exit.
+ * @param payment Where to store the amount charged in cents, may be NULL.
+ * @return ENGINE_OK or the reason the exit was rejected.
+ */
+int engine_exit(Engine *engine,
+                int parkId,
+                const char *plate,
+                EngineDate date,
+                long long *payment) {
+
+    char plateVehicle[PLATE_LENGTH + 1];
+
+    if (!copy_plate(plate, plateVehicle))
+        return ENGINE_INVALID_PLATE;
+
+    return apply(engine,
+                find_park_by_id(engine->parks, engine->parksCounter, parkId),
+                plateVehicle,
+                to_date(date),
+                ENGINE_EXIT,
+                payment);
+}
+
+/**
+ * @brief Applies a batch of entries and exits, in order.
+ *
+ * The plates arrive packed, so nothing is parsed, and the park of an event
+ * is only looked up when it differs from the one of the previous event.
+ *
+ * @param engine The engine.
+ * @param events The events to apply.
+ * @param count The number of events.
+ * @param results Array of count codes, ENGINE_OK or the reason each event
+ * was rejected.
+ * @param payments Array of count amounts charged in cents, 0 for anything
+ * but an accepted exit, may be NULL.
+ * @return The number of accepted events.
+ */
+int engine_submit(Engine *engine,
+                const EngineEvent *events,
+                int count,
+                int *results,
+                long long *payments) {
+
+    char plate[PLATE_LENGTH + 1];
+    Park *park = NULL;
+    int accepted = 0;
+
+    for (int i = 0; i < count; i++) {
+        const EngineEvent *event = &events[i];
+        long long payment = 0;
+
+        if (park == NULL || park->id != event->parkId)
+            park = find_park_by_id(engine->parks,
+                                    engine->parksCounter,
+                                    event->parkId);
+
+        if (event->plateKey == PLATE_KEY_NONE)
+            results[i] = ENGINE_INVALID_PLATE;
+        else {
+            key_to_plate(event->plateKey, plate);
+            results[i] = apply(engine,
+                            park,
+                            plate,
+                            to_date(event->date),
+                            event->command,
+                            &payment);
+        }
+
+        if (results[i] == ENGINE_OK)
+            accepted++;
+        if (payments != NULL)
+            payments[i] = payment;
+    }
+    return accepted;
+}
+
+/**
+ * @brief Applies every event the gates have published so far.
+ *
+ * Meant to be called from the loop that owns the engine. Gates keep
+ * submitting from their own threads, and learn the outcome of each event
+ * from its completion.
+ *
+ * @param engine The engine.
+ * @param queue The queue the gates submit to.
+ * @return The number of events applied.
+ */
+int engine_process_gates(Engine *engine, struct GateQueue *queue) {
+    return gate_queue_process(queue,
+                            engine->parks,
+                            &engine->parksCounter,
+                            &engine->head,
+                            engine->vehicles,
+                            engine->billing);
+}
+
+/**
+ * @brief Lists the stays of a vehicle, as the 'v' command does: by park
+ * name, then by date of entry.
+ *
+ * @param engine The engine.
+ * @param plate The vehicle plate.
+ * @param stays Array receiving the first max stays.
+ * @param max The capacity of the stays array.
+ * @param count Where to store the number of stays, which may be more than
+ * max.
+ * @return ENGINE_OK, ENGINE_INVALID_PLATE or ENGINE_NO_ENTRIES.
+ */
+int engine_vehicle_history(Engine *engine,
+                            const char *plate,
+                            EngineStay *stays,
+                            int max,
+                            int *count) {
+
+    char plateVehicle[PLATE_LENGTH + 1];
+    int found = 0;
+
+    *count = 0;
+    if (!copy_plate(plate, plateVehicle) || !is_valid_plate(plateVehicle))
+        return ENGINE_INVALID_PLATE;
+
+    Node *node = hash_table_get(engine->vehicles, plateVehicle);
+    if (node == NULL)
+        return ENGINE_NO_ENTRIES;
+
+    while (node != NULL) {
+        Movement *movement = node->value;
+        EngineStay stay = {park_id_of(engine, movement->parkName),
+                            from_date(movement->date),
+                            {0, 0, 0, 0, 0},
+                            1};
+
+        node = next_node_with_key(node->next, plateVehicle);
+        /// An exit closes the stay it follows
+        if (node != NULL && node->value->command != COMMAND_E) {
+            stay.exit = from_date(node->value->date);
+            stay.inside = 0;
+            node = next_node_with_key(node->next, plateVehicle);
+        }
+
+        if (found < max)
+            stays[found] = stay;
+        found++;
+    }
+
+    *count = found;
+    return ENGINE_OK;
+}
+
+/**
+ * @brief Computes the revenue of a park between two days, inclusive, as
+ * the 'f' command does.
+ *
+ * @param engine The engine.
+ * @param parkId The identifier of the park.
+ * @param from The first day, the time is ignored.
+ * @param to The last day, no later than the last movement.
+ * @param revenue Where to store the revenue in cents.
+ * @return ENGINE_OK, ENGINE_NO_SUCH_PARKING or ENGINE_INVALID_DATE.
+ */
+int engine_billing(Engine *engine,
+                    int parkId,
+                    EngineDate from,
+                    EngineDate to,
+                    long long *revenue) {
+
+    Park *park = find_park_by_id(engine->parks, engine->parksCounter, parkId);
+    Date first = to_date(from), last = to_date(to), latest = DEFAULT_DATE;
+
+    if (park == NULL)
+        return ENGINE_NO_SUCH_PARKING;
+
+    Movement *tail = movement_store_last(engine->vehicles->store,
+                                        engine->head);
+    if (tail != NULL)
+        latest = tail->date;
+
+    if (!is_valid_date(&first) || !is_valid_date(&last) ||
+        !is_previous_date(first, last) || !is_previous_date(last, latest))
+        return ENGINE_INVALID_DATE;
+
+    *revenue = billing_range(park->revenue, first, last);
+    return ENGINE_OK;
+}
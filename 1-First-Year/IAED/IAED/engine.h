@@ -0,0 +1,104 @@
+/**
+ * @file engine.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Embeddable interface to the parking engine.
+ *
+ * A program that links the engine instead of talking text to proj1 creates
+ * an Engine and calls the typed functions below. They run the same checks
+ * as the commands but never print: each returns one of the ENGINE result
+ * codes. This header is self-contained and does not need proj.h.
+ *
+ * The engine is not reentrant. Every Engine shares the switch that keeps
+ * the commands quiet and the code of the last rejected request, so calls
+ * on any engines must come from one thread at a time, and a handle must
+ * not be used from a callback of another.
+ */
+#ifndef ENGINE_H
+#define ENGINE_H
+
+/// Result Codes
+#define ENGINE_OK 0
+#define ENGINE_NO_SUCH_PARKING 1
+#define ENGINE_PARKING_IS_FULL 2
+#define ENGINE_INVALID_PLATE 3
+#define ENGINE_INVALID_ENTRY 4
+#define ENGINE_INVALID_EXIT 5
+#define ENGINE_INVALID_DATE 6
+#define ENGINE_PARKING_EXISTS 7
+#define ENGINE_INVALID_CAPACITY 8
+#define ENGINE_INVALID_COST 9
+#define ENGINE_TOO_MANY_PARKS 10
+#define ENGINE_NO_ENTRIES 11
+#define ENGINE_INVALID_EVENT 12
+#define ENGINE_NO_MEMORY 13
+
+/// Event Commands
+#define ENGINE_ENTRY 'e'
+#define ENGINE_EXIT 's'
+
+/**
+ * @brief The state of one engine: its parks, movements and indexes.
+ */
+typedef struct Engine Engine;
+
+/**
+ * @brief Queue of gate events, declared in gates.h.
+ */
+struct GateQueue;
+
+/**
+ * @brief A date and time, as in the commands.
+ */
+typedef struct EngineDate {
+    int day;
+    int month;
+    int year;
+    int hour;
+    int minute;
+} EngineDate;
+
+/**
+ * @brief An entry or exit submitted in a batch.
+ *
+ * @param parkId The identifier returned by engine_add_park.
+ * @param plateKey The vehicle plate, packed with engine_plate_key.
+ * @param date The date of the movement.
+ * @param command ENGINE_ENTRY or ENGINE_EXIT.
+ */
+typedef struct EngineEvent {
+    int parkId;
+    unsigned int plateKey;
+    EngineDate date;
+    char command;
+} EngineEvent;
+
+/**
+ * @brief One stay of a vehicle, as listed by the 'v' command.
+ *
+ * @param parkId The park of the stay.
+ * @param entry The date of entry.
+ * @param exit The date of exit, when the stay is closed.
+ * @param inside 1 if the vehicle is still in the park, 0 otherwise.
+ */
+typedef struct EngineStay {
+    int parkId;
+    EngineDate entry;
+    EngineDate exit;
+    int inside;
+} EngineStay;
+
+
+Engine *engine_create(void);
+void engine_free(Engine *engine);
+unsigned int engine_plate_key(const char *plate);
+int engine_add_park(Engine *engine, const char *name, int capacity, int preValue, int afterValue, int maxValue, int *parkId);
+int engine_remove_park(Engine *engine, int parkId);
+int engine_enter(Engine *engine, int parkId, const char *plate, EngineDate date);
+int engine_exit(Engine *engine, int parkId, const char *plate, EngineDate date, long long *payment);
+int engine_submit(Engine *engine, const EngineEvent *events, int count, int *results, long long *payments);
+int engine_process_gates(Engine *engine, struct GateQueue *queue);
+int engine_vehicle_history(Engine *engine, const char *plate, EngineStay *stays, int max, int *count);
+int engine_billing(Engine *engine, int parkId, EngineDate from, EngineDate to, long long *revenue);
+
+#endif
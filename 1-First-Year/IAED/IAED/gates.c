@@ -0,0 +1,276 @@
+/**
+ * @file gates.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Bounded lock-free queue of gate events for the parking engine.
+ *
+ * The queue is a ring of slots, each tagged with a sequence number. A gate
+ * claims a ticket by advancing the tail with a compare-and-swap, writes its
+ * event into the slot of that ticket and then publishes it by bumping the
+ * slot sequence. The engine is the only consumer, so it reads the head
+ * without atomics and stops at the first slot that is not published yet,
+ * which keeps events in ticket order. Atomics use the compiler builtins so
+ * no extra headers are needed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proj.h"
+#include "movements.h"
+#include "auxiliary.h"
+#include "plates.h"
+#include "gates.h"
+
+/**
+ * @brief Creates an empty gate queue.
+ *
+ * @return Pointer to the new queue, or NULL if memory allocation failed.
+ */
+GateQueue *gate_queue_create(void) {
+    GateQueue *queue = malloc(sizeof(GateQueue));
+    if (queue == NULL)
+        return NULL;
+
+    queue->tail = 0;
+    queue->head = 0;
+
+    /// Slot i is first free for the producer holding ticket i
+    for (unsigned long i = 0; i < GATE_QUEUE_CAPACITY; i++)
+        queue->slots[i].sequence = i;
+
+    return queue;
+}
+
+/**
+ * @brief Frees a gate queue. Pending events are discarded.
+ *
+ * @param queue The queue to free.
+ */
+void gate_queue_free(GateQueue *queue) {
+    free(queue);
+}
+
+/**
+ * @brief Submits an event from a gate. Safe to call from many threads.
+ *
+ * @param queue The queue to submit to.
+ * @param event The event to copy into the queue.
+ * @return GATE_SUBMIT_OK, or GATE_QUEUE_FULL if the engine is behind and the
+ * gate must retry later.
+ */
+int gate_queue_submit(GateQueue *queue, GateEvent *event) {
+    unsigned long ticket = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    GateSlot *slot;
+
+    while (1) {
+        slot = &queue->slots[ticket & (GATE_QUEUE_CAPACITY - 1)];
+        unsigned long sequence =
+            __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        long difference = (long)(sequence - ticket);
+
+        if (difference == 0) {
+            /// The slot is free for this ticket, try to claim the ticket
+            if (__atomic_compare_exchange_n(&queue->tail,
+                                            &ticket,
+                                            ticket + 1,
+                                            1,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+                break;
+        }
+        else if (difference < 0)
+            return GATE_QUEUE_FULL; /// The engine has not freed it yet
+        else
+            ticket = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    }
+
+    if (event->completion != NULL)
+        __atomic_store_n(&event->completion->done, 0, __ATOMIC_RELAXED);
+
+    slot->event = *event;
+    /// Publish the event to the engine
+    __atomic_store_n(&slot->sequence, ticket + 1, __ATOMIC_RELEASE);
+    return GATE_SUBMIT_OK;
+}
+
+/**
+ * @brief Estimates how many events are waiting, for backpressure decisions.
+ *
+ * @param queue The queue to inspect.
+ * @return The number of claimed tickets not yet consumed by the engine.
+ */
+int gate_queue_depth(GateQueue *queue) {
+    unsigned long tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    unsigned long head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+
+    return (int)(tail - head);
+}
+
+/**
+ * @brief Removes up to max published events, in arrival order. Must only be
+ * called from the engine thread.
+ *
+ * @param queue The queue to drain.
+ * @param batch Array receiving the events.
+ * @param max The capacity of the batch array.
+ * @return The number of events copied into the batch.
+ */
+int gate_queue_drain(GateQueue *queue, GateEvent *batch, int max) {
+    unsigned long ticket = queue->head;
+    int count = 0;
+
+    while (count < max) {
+        GateSlot *slot = &queue->slots[ticket & (GATE_QUEUE_CAPACITY - 1)];
+        unsigned long sequence =
+            __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+
+        /// Stop at the first ticket whose gate has not published yet
+        if (sequence != ticket + 1)
+            break;
+
+        batch[count++] = slot->event;
+        /// Hand the slot back to the producer one lap ahead
+        __atomic_store_n(&slot->sequence,
+                        ticket + GATE_QUEUE_CAPACITY,
+                        __ATOMIC_RELEASE);
+        ticket++;
+    }
+
+    __atomic_store_n(&queue->head, ticket, __ATOMIC_RELAXED);
+    return count;
+}
+
+/**
+ * @brief Reports the outcome of an event back to its gate.
+ *
+ * @param completion The completion of the event, may be NULL.
+ * @param result One of the GATE_RESULT values.
+ * @param payment The amount charged in cents, 0 unless it was an accepted 
+ * exit.
+ */
+void gate_complete(GateCompletion *completion, int result, long long payment) {
+    if (completion == NULL)
+        return;
+
+    completion->result = result;
+    completion->payment = payment;
+    __atomic_store_n(&completion->done, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Checks, from the gate thread, whether an event has been applied.
+ *
+ * @param completion The completion passed with the event.
+ * @return 1 if result and payment are final, 0 otherwise.
+ */
+int gate_completion_done(GateCompletion *completion) {
+    return __atomic_load_n(&completion->done, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Applies a batch of drained events to the parks, in order.
+ *
+ * Each event goes through the same checks as the 'e' and 's' commands,
+ * with their output off: results only go to the completions, whichever
+ * thread drains the queue.
+ *
+ * @param batch The events to apply.
+ * @param count The number of events in the batch.
+ * @param parksTotal Pointer to the array of parks.
+ * @param parksCounter Pointer to the count of total parks.
+ * @param head Pointer to the head of the movement list.
+ * @param vehicles Pointer to the hash table of vehicle movements.
+ * @param billing Pointer to the billing hash table.
+ * @return The number of accepted events.
+ */
+int gate_apply_batch(GateEvent *batch,
+                    int count,
+                    Park *parksTotal,
+                    int *parksCounter,
+                    Movement **head,
+                    HashTable *vehicles,
+                    BillingHashTable *billing) {
+
+    char plate[PLATE_LENGTH + 1];
+    int accepted = 0;
+
+    set_echo(0);
+    for (int i = 0; i < count; i++) {
+        GateEvent *event = &batch[i];
+        Park *park = find_park_by_id(parksTotal, *parksCounter, event->parkId);
+        Movement *movement = NULL;
+        long long payment = 0;
+
+        if (park == NULL) {
+            gate_complete(event->completion, GATE_RESULT_NO_SUCH_PARKING, 0);
+            continue;
+        }
+
+        key_to_plate(event->plateKey, plate);
+
+        if (event->command == COMMAND_E)
+            movement = enter_vehicle(parksTotal,
+                                    parksCounter,
+                                    park->parkName,
+                                    plate,
+                                    &event->date,
+                                    head,
+                                    vehicles);
+        else if (event->command == COMMAND_S)
+            movement = exit_vehicle(parksTotal,
+                                    parksCounter,
+                                    park->parkName,
+                                    plate,
+                                    &event->date,
+                                    head,
+                                    vehicles,
+                                    billing,
+                                    &payment);
+
+        if (movement != NULL) {
+            accepted++;
+            gate_complete(event->completion, GATE_RESULT_ACCEPTED, payment);
+        }
+        else
+            gate_complete(event->completion, GATE_RESULT_REJECTED, 0);
+    }
+    set_echo(1);
+    return accepted;
+}
+
+/**
+ * @brief Drains and applies everything the gates have published so far.
+ *
+ * Called by engine_process_gates, or by any loop that owns the parks;
+ * events arriving while a batch is applied are picked up by the next batch.
+ *
+ * @param queue The queue to drain.
+ * @param parksTotal Pointer to the array of parks.
+ * @param parksCounter Pointer to the count of total parks.
+ * @param head Pointer to the head of the movement list.
+ * @param vehicles Pointer to the hash table of vehicle movements.
+ * @param billing Pointer to the billing hash table.
+ * @return The number of events applied.
+ */
+int gate_queue_process(GateQueue *queue,
+                        Park *parksTotal,
+                        int *parksCounter,
+                        Movement **head,
+                        HashTable *vehicles,
+                        BillingHashTable *billing) {
+
+    GateEvent batch[GATE_BATCH_MAX];
+    int total = 0, count;
+
+    while ((count = gate_queue_drain(queue, batch, GATE_BATCH_MAX)) > 0) {
+        gate_apply_batch(batch,
+                        count,
+                        parksTotal,
+                        parksCounter,
+                        head,
+                        vehicles,
+                        billing);
+        total += count;
+    }
+    return total;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file gates.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Bounded lock-free queue of gate events for the parking engine.
+ *
+ * Every entrance and exit gate is a producer that submits pre-parsed events
+ * from its own thread. A single engine thread drains them in batches, in the
+ * order the gates obtained their tickets, and applies them to the parks.
+ */
+#ifndef GATES_H
+#define GATES_H
+#include "movements.h"
+
+/// Queue Parameters (capacity must be a power of two)
+#define GATE_QUEUE_CAPACITY 1024
+#define GATE_BATCH_MAX 64
+#define GATE_CACHE_LINE 64
+
+/// Submission Results
+#define GATE_SUBMIT_OK 1
+#define GATE_QUEUE_FULL 0
+
+/// Event Results
+#define GATE_RESULT_PENDING 0
+#define GATE_RESULT_ACCEPTED 1
+#define GATE_RESULT_REJECTED 2
+#define GATE_RESULT_NO_SUCH_PARKING 3
+
+/**
+ * @brief Outcome of a gate event, filled in by the engine.
+ *
+ * @param result One of the GATE_RESULT values.
+ * @param payment The amount charged in cents, for accepted exits.
+ * @param done Set to 1, with release semantics, once the other fields are
+ * final.
+ */
+typedef struct GateCompletion {
+    int result;
+    long long payment;
+    int done;
+} GateCompletion;
+
+/**
+ * @brief A pre-parsed entry or exit reported by a gate.
+ *
+ * @param parkId The identifier of the park the gate belongs to.
+ * @param plateKey The vehicle plate, packed with plate_to_key.
+ * @param date The date of the movement.
+ * @param command COMMAND_E for an entry, COMMAND_S for an exit.
+ * @param completion Where to report the outcome, may be NULL.
+ */
+typedef struct GateEvent {
+    int parkId;
+    unsigned int plateKey;
+    Date date;
+    char command;
+    GateCompletion *completion;
+} GateEvent;
+
+/**
+ * @brief A slot of the ring buffer.
+ *
+ * @param sequence The ticket the slot is waiting for; a producer owns the
+ * slot when it equals its ticket, the engine when it is one past it.
+ * @param event The event stored in the slot.
+ */
+typedef struct GateSlot {
+    unsigned long sequence;
+    GateEvent event;
+} GateSlot;
+
+/**
+ * @brief Multi-producer, single-consumer ring buffer of gate events.
+ *
+ * @param tail The next ticket handed to a producer.
+ * @param head The next ticket the engine consumes.
+ * @param slots The ring of GATE_QUEUE_CAPACITY slots.
+ */
+typedef struct GateQueue {
+    unsigned long tail;
+    char tailPadding[GATE_CACHE_LINE - sizeof(unsigned long)];
+    unsigned long head;
+    char headPadding[GATE_CACHE_LINE - sizeof(unsigned long)];
+    GateSlot slots[GATE_QUEUE_CAPACITY];
+} GateQueue;
+
+
+GateQueue *gate_queue_create(void);
+void gate_queue_free(GateQueue *queue);
+int gate_queue_submit(GateQueue *queue, GateEvent *event);
+int gate_queue_depth(GateQueue *queue);
+int gate_queue_drain(GateQueue *queue, GateEvent *batch, int max);
+void gate_complete(GateCompletion *completion, int result, long long payment);
+int gate_completion_done(GateCompletion *completion);
+int gate_apply_batch(GateEvent *batch, int count, Park *parksTotal, int *parksCounter, Movement **head, HashTable *vehicles, BillingHashTable *billing);
+int gate_queue_process(GateQueue *queue, Park *parksTotal, int *parksCounter, Movement **head, HashTable *vehicles, BillingHashTable *billing);
+
+#endif
@@ -0,0 +1,838 @@
+/**
+ * @file image.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief State image of the system, restored lazily on startup.
+ *
+ * Startup reads the parks and the rows that are still needed to accept
+ * entries and exits: the open stays, which go back into the movement list,
+ * the store and the open stay indexes, and the last movement, which dates
+ * the system. The history columns are read on first use. A park gets its
+ * bills, revenue, occupancy and rankings when a command reads them, and a
+ * vehicle its movements when 'v' asks for it; restored movements go before
+ * the ones of the same park added since, so every index ends up in the
+ * order it would have had without the restart.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proj.h"
+#include "movements.h"
+#include "auxiliary.h"
+#include "calendar.h"
+#include "plates.h"
+#include "occupancy.h"
+#include "billing.h"
+#include "ranking.h"
+#include "search.h"
+#include "dwell.h"
+#include "overstay.h"
+#include "accounting.h"
+#include "store.h"
+#include "image.h"
+
+/**
+ * @brief Returns the date of a stamp.
+ */
+static Date stamp_date(long long stamp) {
+    return date_from_minute_number(stamp >> 1);
+}
+
+/**
+ * @brief Returns the command of a stamp.
+ */
+static char stamp_command(long long stamp) {
+    return stamp & STORE_EXIT_BIT ? COMMAND_S : COMMAND_E;
+}
+
+/**
+ * @brief Returns the first slot to probe for a plate key.
+ */
+static unsigned int key_slot(unsigned int key, unsigned int mask) {
+    return (key * 2654435761u) & mask;
+}
+
+/**
+ * @brief Builds an open addressing table from plate key to position.
+ *
+ * @param keys The plate keys, all different.
+ * @param count Number of keys.
+ * @param mask Set to the number of slots minus one.
+ * @param tag The tag of the slots.
+ *
+ * @return The slots, -1 when empty, or NULL if memory allocation failed.
+ */
+static int *plate_slots_build(unsigned int *keys,
+                            unsigned int count,
+                            unsigned int *mask,
+                            MemTag tag) {
+
+    unsigned int size = 16;
+    while (size < count * 2)
+        size *= 2;
+
+    int *slots = mem_alloc(tag, size * sizeof(int));
+    if (slots == NULL)
+        return NULL;
+    memset(slots, -1, size * sizeof(int));
+
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int slot = key_slot(keys[i], size - 1);
+        while (slots[slot] >= 0)
+            slot = (slot + 1) & (size - 1);
+        slots[slot] = i;
+    }
+    *mask = size - 1;
+    return slots;
+}
+
+/**
+ * @brief Finds the position of a plate key.
+ *
+ * @return The position, or -1 if the key is not in the table.
+ */
+static int plate_slots_find(int *slots,
+                            unsigned int mask,
+                            unsigned int *keys,
+                            unsigned int key) {
+
+    for (unsigned int slot = key_slot(key, mask); slots[slot] >= 0;
+            slot = (slot + 1) & mask)
+        if (keys[slots[slot]] == key)
+            return slots[slot];
+    return -1;
+}
+
+/**
+ * @brief Returns the number of bytes allocated for an array read from an
+ * image, never zero.
+ */
+static size_t array_bytes(size_t size, size_t count) {
+    return count > 0 ? count * size : 1;
+}
+
+/**
+ * @brief Allocates an array and fills it from a file.
+ *
+ * @return 1 on success, 0 if memory allocation or reading failed.
+ */
+static int read_array(FILE *file, void **array, size_t size, size_t count) {
+    *array = mem_alloc(MEM_MOVEMENTS, array_bytes(size, count));
+    return *array != NULL && fread(*array, size, count, file) == count;
+}
+
+/**
+ * @brief Reads the history columns of an image, the first time only.
+ *
+ * @return 1 if the history is available, 0 if it could not be read.
+ */
+static int load_history(StateImage *image) {
+    if (image->history != 0)
+        return image->history > 0;
+    image->history = -1;
+
+    FILE *file = fopen(image->path, "rb");
+    int ok = file != NULL &&
+        fseek(file, image->historyOffset, SEEK_SET) == 0 &&
+        read_array(file, (void **)&image->parkIds,
+                    sizeof(int), image->count) &&
+        read_array(file, (void **)&image->plateKeys,
+                    sizeof(unsigned int), image->count) &&
+        read_array(file, (void **)&image->stamps,
+                    sizeof(long long), image->count) &&
+        read_array(file, (void **)&image->previous,
+                    sizeof(unsigned int), image->count) &&
+        read_array(file, (void **)&image->plateKeysSeen,
+                    sizeof(unsigned int), image->plateCount) &&
+        read_array(file, (void **)&image->lastRows,
+                    sizeof(unsigned int), image->plateCount);
+    if (file != NULL)
+        fclose(file);
+
+    /// Rows only point back, so walking a plate always ends
+    for (unsigned int row = 0; ok && row < image->count; row++)
+        ok = image->parkIds[row] >= 0 && image->parkIds[row] < PARK_MAX &&
+            (image->previous[row] == IMAGE_ROW_NONE ||
+            image->previous[row] < row);
+    for (unsigned int id = 0; ok && id < image->plateCount; id++)
+        ok = image->lastRows[id] == IMAGE_ROW_NONE ||
+            image->lastRows[id] < image->count;
+
+    if (ok) {
+        image->plateDone = mem_calloc(MEM_MOVEMENTS, image->plateCount + 1, 1);
+        image->plateSlots = plate_slots_build(image->plateKeysSeen,
+                                            image->plateCount,
+                                            &image->slotMask,
+                                            MEM_MOVEMENTS);
+        ok = image->plateDone != NULL && image->plateSlots != NULL;
+    }
+
+    if (!ok) {
+        fprintf(stderr, "proj1: cannot read the history of %s\n", image->path);
+        return 0;
+    }
+    image->history = 1;
+    return 1;
+}
+
+/**
+ * @brief Returns the Movement of a row, creating it the first time.
+ *
+ * @param image The image.
+ * @param row The row.
+ * @param park The park of the row.
+ *
+ * @return The movement, owned by the image unless loaded on startup, or
+ * NULL if memory allocation failed.
+ */
+static Movement *restore_row(StateImage *image, unsigned int row, Park *park) {
+    if (image->movements[row] != NULL)
+        return image->movements[row];
+
+    char plate[PLATE_LENGTH + 1];
+    key_to_plate(image->plateKeys[row], plate);
+
+    Movement *movement = mem_alloc(MEM_MOVEMENTS, sizeof(Movement));
+    if (movement == NULL)
+        return NULL;
+
+    movement->plate = mem_strdup(MEM_MOVEMENTS, plate);
+    movement->parkName = mem_strdup(MEM_MOVEMENTS, park->parkName);
+    if (movement->plate == NULL || movement->parkName == NULL) {
+        mem_free_string(MEM_MOVEMENTS, movement->plate);
+        mem_free_string(MEM_MOVEMENTS, movement->parkName);
+        mem_free(MEM_MOVEMENTS, movement, sizeof(Movement));
+        return NULL;
+    }
+    movement->date = stamp_date(image->stamps[row]);
+    movement->command = stamp_command(image->stamps[row]);
+    movement->prev = NULL;
+    movement->next = NULL;
+    movement->stayPrev = NULL;
+    movement->stayNext = NULL;
+    movement->timer = NULL;
+    movement->row = STORE_ROW_NONE;
+
+    image->movements[row] = movement;
+    return movement;
+}
+
+/**
+ * @brief Adds a restored row to the vehicles hash table.
+ */
+static void link_row(StateImage *image, HashTable *vehicles, unsigned int row) {
+    Movement *movement = image->movements[row];
+    hash_table_add_history(vehicles, movement->plate, movement);
+    image->rowStates[row] = IMAGE_ROW_LINKED;
+}
+
+/**
+ * @brief Restores a state image: the parks, the open stays and the last
+ * movement. The history is left in the file until it is needed.
+ *
+ * @param path The image file.
+ * @param parksTotal Array of Park structures, still empty.
+ * @param parksCounter Count of parks.
+ * @param head Head of the double linked list of Movements, still empty.
+ * @param vehicles HashTable of vehicle movement information.
+ *
+ * @return The image, or NULL if there is none or it could not be read.
+ */
+StateImage *image_load(const char *path,
+                        Park *parksTotal,
+                        int *parksCounter,
+                        Movement **head,
+                        HashTable *vehicles) {
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    ImageHeader header;
+    ImagePark parks[PARK_MAX];
+    char *names[PARK_MAX] = {NULL};
+    unsigned char used[PARK_MAX] = {0};
+    StateImage *image = mem_calloc(MEM_MOVEMENTS, 1, sizeof(StateImage));
+
+    int ok = image != NULL && *parksCounter == 0 &&
+        fread(&header, sizeof(header), 1, file) == 1 &&
+        memcmp(header.magic, IMAGE_MAGIC, sizeof(header.magic)) == 0 &&
+        header.version == IMAGE_VERSION &&
+        header.parks >= 0 && header.parks <= PARK_MAX &&
+        header.eager <= header.movements &&
+        header.plates < IMAGE_PLATES_MAX &&
+        header.overstayLimit >= 0 &&
+        header.overstayClock >= 0 && header.overstayClock < WHEEL_HORIZON;
+
+    /// Set before anything is sized by them, so image_free always matches
+    if (ok) {
+        image->count = header.movements;
+        image->plateCount = header.plates;
+        image->eagerCount = header.eager;
+    }
+
+    for (int p = 0; ok && p < header.parks; p++) {
+        ImagePark *park = &parks[p];
+        ok = fread(park, sizeof(ImagePark), 1, file) == 1 &&
+            park->id >= 0 && park->id < PARK_MAX && !used[park->id] &&
+            park->nameLength > 0 && park->nameLength < PARK_NAME_SIZE_MAX &&
+            (names[p] = mem_alloc(MEM_PARKS, park->nameLength + 1)) != NULL &&
+            fread(names[p], 1, park->nameLength, file) ==
+                (size_t)park->nameLength;
+        if (ok) {
+            names[p][park->nameLength] = NULL_TERMINATOR;
+            used[park->id] = 1;
+            ok = strlen(names[p]) == (size_t)park->nameLength;
+        }
+    }
+
+    if (ok) {
+        image->eagerRows = mem_alloc(MEM_MOVEMENTS,
+                                    (header.eager + 1) * sizeof(ImageRow));
+        ok = image->eagerRows != NULL &&
+            fread(image->eagerRows, sizeof(ImageRow), header.eager, file) ==
+                header.eager;
+    }
+    for (unsigned int i = 0; ok && i < header.eager; i++) {
+        ImageRow *eager = &image->eagerRows[i];
+        ok = eager->row < header.movements &&
+            (i == 0 || eager->row > image->eagerRows[i - 1].row) &&
+            eager->parkId >= 0 && eager->parkId < PARK_MAX &&
+            used[eager->parkId];
+    }
+
+    if (ok) {
+        image->historyOffset = ftell(file);
+        image->path = mem_strdup(MEM_MOVEMENTS, path);
+        image->movements = mem_calloc(MEM_MOVEMENTS, header.movements + 1,
+                                    sizeof(Movement*));
+        image->rowStates = mem_calloc(MEM_MOVEMENTS, header.movements + 1, 1);
+        ok = image->historyOffset >= 0 && image->path != NULL &&
+            image->movements != NULL && image->rowStates != NULL &&
+            movement_store_reserve(vehicles->store, header.eager);
+    }
+    fclose(file);
+
+    if (!ok) {
+        fprintf(stderr, "proj1: %s is not a state image\n", path);
+        /// Names are read in order, so the first missing one ends them
+        for (int p = 0; p < PARK_MAX && names[p] != NULL; p++)
+            mem_free(MEM_PARKS, names[p], parks[p].nameLength + 1);
+        image_free(image);
+        return NULL;
+    }
+
+    image->eagerLive = header.eager;
+
+    /// Parks keep their order, identifiers and free spots
+    for (int p = 0; p < header.parks; p++) {
+        Park *park = insert_park(parksTotal,
+                                names[p],
+                                parks[p].capacity,
+                                parks[p].charge,
+                                parksCounter);
+        park->id = parks[p].id;
+        park->available = parks[p].available;
+        image->parkStates[park->id] = IMAGE_PARK_COLD;
+    }
+
+    /// The alert clock is back where it was before the stays are armed
+    overstay_set_limit(vehicles->overstays, header.overstayLimit,
+                        parksTotal, *parksCounter);
+    overstay_advance(vehicles->overstays,
+                    date_from_minute_number(header.overstayClock));
+
+    /// Open stays and the last movement, in order, as if just added
+    Movement *tail = NULL;
+    for (unsigned int i = 0; i < image->eagerCount; i++) {
+        ImageRow *eager = &image->eagerRows[i];
+        Park *park = find_park_by_id(parksTotal, *parksCounter, eager->parkId);
+        char command = stamp_command(eager->stamp);
+        char plate[PLATE_LENGTH + 1];
+        key_to_plate(eager->plateKey, plate);
+
+        tail = add_movement(head, tail, plate, park->parkName,
+                            stamp_date(eager->stamp), command);
+        /// The rows were reserved with the image, so this one has room
+        movement_store_append(vehicles->store, tail, park->id);
+        if (command == COMMAND_E) {
+            stay_set_insert(park->openStays, tail);
+            plate_index_enter(vehicles->plates, plate, tail);
+            overstay_restore(vehicles->overstays, tail);
+        }
+        hash_table_add(vehicles, plate, tail);
+
+        image->movements[eager->row] = tail;
+        image->rowStates[eager->row] = IMAGE_ROW_EAGER;
+        image->eagerByPark[park->id]++;
+    }
+    return image;
+}
+
+/**
+ * @brief Restores the movements of a vehicle into the vehicles hash table.
+ *
+ * @param vehicles HashTable of vehicle movement information.
+ * @param parksTotal Array of Park structures.
+ * @param parksCounter Count of parks.
+ * @param plate The plate of the vehicle.
+ */
+void image_materialize_plate(HashTable *vehicles,
+                            Park *parksTotal,
+                            int parksCounter,
+                            char *plate) {
+
+    StateImage *image = vehicles->image;
+    if (image == NULL || !load_history(image))
+        return;
+
+    int id = plate_slots_find(image->plateSlots, image->slotMask,
+                            image->plateKeysSeen, plate_to_key(plate));
+    if (id < 0 || image->plateDone[id])
+        return;
+    image->plateDone[id] = 1;
+
+    /// Newest first, each one before the ones restored after it
+    for (unsigned int row = image->lastRows[id]; row != IMAGE_ROW_NONE;
+            row = image->previous[row]) {
+
+        int parkId = image->parkIds[row];
+        if (image->rowStates[row] != IMAGE_ROW_COLD || image->dropped[parkId])
+            continue;
+
+        Park *park = find_park_by_id(parksTotal, parksCounter, parkId);
+        if (park == NULL)
+            continue;
+
+        /// The rows linked so far stay, the others are tried again later
+        if (restore_row(image, row, park) == NULL) {
+            image->plateDone[id] = 0;
+            return;
+        }
+        link_row(image, vehicles, row);
+    }
+}
+
+/**
+ * @brief Restores the bills, revenue, stay durations, rankings and
+ * occupancy of a park, and its movements into the vehicles hash table.
+ *
+ * @param vehicles HashTable of vehicle movement information.
+ * @param billing BillingHashTable of billing information.
+ * @param park The park.
+ */
+void image_materialize_park(HashTable *vehicles,
+                            BillingHashTable *billing,
+                            Park *park) {
+
+    StateImage *image = vehicles->image;
+    if (image == NULL || park == NULL ||
+        image->parkStates[park->id] != IMAGE_PARK_COLD ||
+        !load_history(image))
+        return;
+
+    int id = park->id, exits = 0;
+    for (unsigned int row = 0; row < image->count; row++)
+        exits += image->parkIds[row] == id &&
+                (image->stamps[row] & STORE_EXIT_BIT);
+
+    size_t size = (exits + 1) * sizeof(long long);
+    Movement **values = mem_alloc(MEM_BUFFERS, (exits + 1) * sizeof(Movement*));
+    long long *bills = mem_alloc(MEM_BUFFERS, size);
+    long long *minutes = mem_alloc(MEM_BUFFERS, size);
+    long long *days = mem_alloc(MEM_BUFFERS, size);
+    OccupancySeries *occupancy = occupancy_create();
+    BillingPrefix *revenue = billing_prefix_create();
+    DwellSeries *dwell = dwell_create();
+
+    /// Every row is restored before the park changes, so a failure leaves
+    /// it cold and the next command that reads it tries again
+    int ok = values != NULL && bills != NULL && minutes != NULL &&
+            days != NULL && occupancy != NULL && revenue != NULL &&
+            dwell != NULL;
+    for (unsigned int row = 0; ok && row < image->count; row++)
+        ok = image->parkIds[row] != id ||
+            restore_row(image, row, park) != NULL;
+
+    if (!ok) {
+        mem_free(MEM_BUFFERS, values, (exits + 1) * sizeof(Movement*));
+        mem_free(MEM_BUFFERS, bills, size);
+        mem_free(MEM_BUFFERS, minutes, size);
+        mem_free(MEM_BUFFERS, days, size);
+        occupancy_free(occupancy);
+        billing_prefix_free(revenue);
+        dwell_free(dwell);
+        return;
+    }
+    image->parkStates[id] = IMAGE_PARK_DONE;
+
+    /// Bill every exit against its entry, the previous row of its plate
+    int occupied = 0, billed = 0;
+    for (unsigned int row = 0; row < image->count; row++) {
+        if (image->parkIds[row] != id)
+            continue;
+
+        Movement *movement = restore_row(image, row, park);
+        unsigned int entryRow = image->previous[row];
+
+        if (movement->command == COMMAND_E) {
+            occupied++;
+        } else {
+            occupied--;
+            if (entryRow != IMAGE_ROW_NONE && image->parkIds[entryRow] == id) {
+                Movement *entry = restore_row(image, entryRow, park);
+                values[billed] = movement;
+                bills[billed] = calculate_payment(park, entry, movement);
+                minutes[billed] = calculate_minutes(entry->date,
+                                                    movement->date);
+                days[billed] = day_number(movement->date);
+                ledger_add(park->leaders, image->plateKeys[row],
+                            bills[billed], minutes[billed]);
+                ledger_add(billing->ledger, image->plateKeys[row],
+                            bills[billed], minutes[billed]);
+                billed++;
+            }
+        }
+        occupancy_record(occupancy, movement->date, occupied,
+                        movement->command);
+    }
+
+    /// The movements since startup follow the ones loaded with it
+    MovementStore *store = vehicles->store;
+    for (unsigned int row = image->eagerLive;
+            store != NULL && row < store->count; row++) {
+        if (store->parkIds[row] != id)
+            continue;
+
+        Movement *movement = store->rows[row];
+        occupied += movement->command == COMMAND_E ? 1 : -1;
+        occupancy_record(occupancy, movement->date, occupied,
+                        movement->command);
+    }
+    occupancy_free(park->occupancy);
+    park->occupancy = occupancy;
+
+    bill_hash_table_add_history(billing, park->parkName, values, bills,
+                                minutes, billed);
+    revenue_cube_merge(billing->cube, id, days, bills, billed);
+
+    /// The prefix and the durations are rebuilt from every bill, in order
+    BillingNode *node = bill_hash_table_get(billing, park->parkName);
+    for (; node != NULL; node = node->next) {
+        if (strcmp(node->key, park->parkName) != 0)
+            continue;
+        billing_prefix_add(revenue, node->value->date, node->bill);
+        dwell_record(dwell, node->value->date, node->minutes);
+    }
+    billing_prefix_free(park->revenue);
+    park->revenue = revenue;
+    billing_cache_clear(park->results);
+    dwell_free(park->dwell);
+    park->dwell = dwell;
+
+    /// Newest first, so the movements of each vehicle end up in order
+    for (unsigned int row = image->count; row-- > 0; )
+        if (image->parkIds[row] == id &&
+            image->rowStates[row] == IMAGE_ROW_COLD)
+            link_row(image, vehicles, row);
+
+    mem_free(MEM_BUFFERS, values, (exits + 1) * sizeof(Movement*));
+    mem_free(MEM_BUFFERS, bills, size);
+    mem_free(MEM_BUFFERS, minutes, size);
+    mem_free(MEM_BUFFERS, days, size);
+}
+
+/**
+ * @brief Restores every park.
+ *
+ * @param vehicles HashTable of vehicle movement information.
+ * @param billing BillingHashTable of billing information.
+ * @param parksTotal Array of Park structures.
+ * @param parksCounter Count of parks.
+ */
+void image_materialize_all(HashTable *vehicles,
+                            BillingHashTable *billing,
+                            Park *parksTotal,
+                            int parksCounter) {
+
+    if (vehicles->image == NULL)
+        return;
+
+    for (int i = 0; i < parksCounter; i++)
+        image_materialize_park(vehicles, billing, &parksTotal[i]);
+}
+
+/**
+ * @brief Restores the plate search index, with the plates of the image
+ * first, in the order they were first seen.
+ *
+ * @param vehicles HashTable of vehicle movement information.
+ */
+void image_materialize_plates(HashTable *vehicles) {
+    StateImage *image = vehicles->image;
+    if (image == NULL || image->platesDone || vehicles->plates == NULL ||
+        !load_history(image))
+        return;
+
+    PlateIndex *plates = plate_index_create(), *recent = vehicles->plates;
+    if (plates == NULL)
+        return;
+    image->platesDone = 1;
+
+    char plate[PLATE_LENGTH + 1];
+    /// Plates whose movements were all removed keep their place, unlisted
+    for (unsigned int id = 0; id < image->plateCount; id++) {
+        key_to_plate(image->plateKeysSeen[id], plate);
+        plate_index_enter(plates, plate, NULL);
+        if (image->lastRows[id] == IMAGE_ROW_NONE)
+            plate_index_forget(plates, plate);
+    }
+    for (int id = 0; id < recent->count; id++) {
+        key_to_plate(recent->keys[id], plate);
+        plate_index_enter(plates, plate, recent->inside[id]);
+    }
+
+    plate_index_free(recent);
+    vehicles->plates = plates;
+}
+
+/**
+ * @brief Forgets the rows of a removed park.
+ *
+ * Its movements loaded on startup are freed with the park, and a new park
+ * may reuse its identifier.
+ *
+ * @param vehicles HashTable of vehicle movement information.
+ * @param parkId The identifier of the removed park.
+ */
+void image_drop_park(HashTable *vehicles, int parkId) {
+    StateImage *image = vehicles->image;
+    if (image == NULL || parkId < 0 || parkId >= PARK_MAX)
+        return;
+
+    image->dropped[parkId] = 1;
+    image->parkStates[parkId] = IMAGE_PARK_DONE;
+    image->eagerLive -= image->eagerByPark[parkId];
+    image->eagerByPark[parkId] = 0;
+
+    for (unsigned int i = 0; i < image->eagerCount; i++)
+        if (image->eagerRows[i].parkId == parkId)
+            image->movements[image->eagerRows[i].row] = NULL;
+}
+
+/**
+ * @brief Writes the columns of a history.
+ *
+ * @return 1 on success, 0 if writing failed.
+ */
+static int write_history(FILE *file,
+                        int *parkIds,
+                        unsigned int *plateKeys,
+                        long long *stamps,
+                        unsigned int *previous,
+                        unsigned int count) {
+
+    return fwrite(parkIds, sizeof(int), count, file) == count &&
+        fwrite(plateKeys, sizeof(unsigned int), count, file) == count &&
+        fwrite(stamps, sizeof(long long), count, file) == count &&
+        fwrite(previous, sizeof(unsigned int), count, file) == count;
+}
+
+/**
+ * @brief Writes a state image: the parks, the open stays and the last
+ * movement, then the history of every park still in the system.
+ *
+ * The file is written next to the path and renamed over it at the end, so
+ * an image being read lazily is never overwritten. A file that the state
+ * was not restored from is left alone.
+ *
+ * @param path The image file.
+ * @param parksTotal Array of Park structures.
+ * @param parksCounter Count of parks.
+ * @param vehicles HashTable of vehicle movement information.
+ *
+ * @return 1 on success, 0 otherwise.
+ */
+int image_save(const char *path,
+                Park *parksTotal,
+                int parksCounter,
+                HashTable *vehicles) {
+
+    StateImage *image = vehicles->image;
+    MovementStore *store = vehicles->store;
+
+    /// Never overwrite a file the state was not restored from
+    FILE *existing = image == NULL ? fopen(path, "rb") : NULL;
+    if (existing != NULL) {
+        fclose(existing);
+        fprintf(stderr, "proj1: not overwriting %s\n", path);
+        return 0;
+    }
+
+    /// A history that could not be read would be lost
+    if (store == NULL || vehicles->plates == NULL ||
+        (image != NULL && !load_history(image)))
+        return 0;
+    image_materialize_plates(vehicles);
+    PlateIndex *plates = vehicles->plates;
+
+    /// The rows of the image, then the ones added since startup
+    unsigned int first = image != NULL ? image->eagerLive : 0, count = 0;
+    for (unsigned int row = 0; image != NULL && row < image->count; row++)
+        count += !image->dropped[image->parkIds[row]];
+    count += store->count - first;
+
+    size_t rows = count + 1, plateRows = plates->count + 1;
+    size_t pathSize = strlen(path) + sizeof(".tmp");
+    int *parkIds = mem_alloc(MEM_BUFFERS, rows * sizeof(int));
+    unsigned int *plateKeys = mem_alloc(MEM_BUFFERS,
+                                        rows * sizeof(unsigned int));
+    long long *stamps = mem_alloc(MEM_BUFFERS, rows * sizeof(long long));
+    unsigned int *previous = mem_alloc(MEM_BUFFERS,
+                                        rows * sizeof(unsigned int));
+    unsigned int *lastRows = mem_alloc(MEM_BUFFERS,
+                                        plateRows * sizeof(unsigned int));
+    ImageRow *eagerRows = mem_calloc(MEM_BUFFERS, plateRows, sizeof(ImageRow));
+    unsigned int mask = 0;
+    int *slots = plate_slots_build(plates->keys, plates->count, &mask,
+                                    MEM_BUFFERS);
+    char *temporary = mem_alloc(MEM_BUFFERS, pathSize);
+    int ok = parkIds != NULL && plateKeys != NULL && stamps != NULL &&
+            previous != NULL && lastRows != NULL && eagerRows != NULL &&
+            slots != NULL && temporary != NULL;
+
+    unsigned int row = 0;
+    for (unsigned int old = 0; ok && image != NULL && old < image->count;
+            old++) {
+        if (image->dropped[image->parkIds[old]])
+            continue;
+        parkIds[row] = image->parkIds[old];
+        plateKeys[row] = image->plateKeys[old];
+        stamps[row++] = image->stamps[old];
+    }
+    for (unsigned int recent = first; ok && recent < store->count; recent++) {
+        parkIds[row] = store->parkIds[recent];
+        plateKeys[row] = store->plateKeys[recent];
+        stamps[row++] = store->stamps[recent];
+    }
+
+    /// Chain the rows of each plate
+    for (int id = 0; ok && id < plates->count; id++)
+        lastRows[id] = IMAGE_ROW_NONE;
+    for (row = 0; ok && row < count; row++) {
+        int id = plate_slots_find(slots, mask, plates->keys, plateKeys[row]);
+        previous[row] = id >= 0 ? lastRows[id] : IMAGE_ROW_NONE;
+        if (id >= 0)
+            lastRows[id] = row;
+    }
+
+    /// Open entries are the last row of their plate
+    unsigned int eager = 0;
+    for (row = 0; ok && row < count; row++) {
+        int id = plate_slots_find(slots, mask, plates->keys, plateKeys[row]);
+        int open = id >= 0 && lastRows[id] == row &&
+                    !(stamps[row] & STORE_EXIT_BIT);
+        if (!open && row != count - 1)
+            continue;
+
+        ImageRow *eagerRow = &eagerRows[eager++];
+        eagerRow->row = row;
+        eagerRow->parkId = parkIds[row];
+        eagerRow->plateKey = plateKeys[row];
+        eagerRow->stamp = stamps[row];
+    }
+
+    FILE *file = NULL;
+    if (ok) {
+        sprintf(temporary, "%s.tmp", path);
+        file = fopen(temporary, "wb");
+        ok = file != NULL;
+    }
+
+    TimerWheel *wheel = vehicles->overstays;
+    ImageHeader header = {{0}, IMAGE_VERSION, parksCounter, eager, count,
+                            (unsigned int)plates->count,
+                            wheel != NULL ? wheel->limit : OVERSTAY_DISABLED,
+                            wheel != NULL ? wheel->now : 0};
+    memcpy(header.magic, IMAGE_MAGIC, sizeof(header.magic));
+    ok = ok && fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (int p = 0; ok && p < parksCounter; p++) {
+        Park *park = &parksTotal[p];
+        ImagePark record = {park->id, park->capacity, park->charge,
+                            park->available, (int)strlen(park->parkName)};
+        ok = fwrite(&record, sizeof(record), 1, file) == 1 &&
+            fwrite(park->parkName, 1, record.nameLength, file) ==
+                (size_t)record.nameLength;
+    }
+
+    ok = ok && fwrite(eagerRows, sizeof(ImageRow), eager, file) == eager &&
+        write_history(file, parkIds, plateKeys, stamps, previous, count) &&
+        fwrite(plates->keys, sizeof(unsigned int), plates->count, file) ==
+            (size_t)plates->count &&
+        fwrite(lastRows, sizeof(unsigned int), plates->count, file) ==
+            (size_t)plates->count;
+
+    if (file != NULL && fclose(file) != 0)
+        ok = 0;
+    if (ok)
+        ok = rename(temporary, path) == 0;
+    else if (file != NULL)
+        remove(temporary);
+
+    if (!ok)
+        fprintf(stderr, "proj1: cannot save the state to %s\n", path);
+
+    mem_free(MEM_BUFFERS, parkIds, rows * sizeof(int));
+    mem_free(MEM_BUFFERS, plateKeys, rows * sizeof(unsigned int));
+    mem_free(MEM_BUFFERS, stamps, rows * sizeof(long long));
+    mem_free(MEM_BUFFERS, previous, rows * sizeof(unsigned int));
+    mem_free(MEM_BUFFERS, lastRows, plateRows * sizeof(unsigned int));
+    mem_free(MEM_BUFFERS, eagerRows, plateRows * sizeof(ImageRow));
+    mem_free(MEM_BUFFERS, slots, (mask + 1) * sizeof(int));
+    mem_free(MEM_BUFFERS, temporary, pathSize);
+    return ok;
+}
+
+/**
+ * @brief Frees an image and the movements restored from it.
+ *
+ * @param image The image, may be NULL.
+ */
+void image_free(StateImage *image) {
+    if (image == NULL)
+        return;
+
+    for (unsigned int row = 0; image->movements != NULL && row < image->count;
+            row++) {
+        Movement *movement = image->movements[row];
+        if (movement == NULL || image->rowStates[row] == IMAGE_ROW_EAGER)
+            continue;
+        mem_free_string(MEM_MOVEMENTS, movement->plate);
+        mem_free_string(MEM_MOVEMENTS, movement->parkName);
+        mem_free(MEM_MOVEMENTS, movement, sizeof(Movement));
+    }
+
+    size_t rows = image->count, plates = image->plateCount;
+
+    mem_free_string(MEM_MOVEMENTS, image->path);
+    mem_free(MEM_MOVEMENTS, image->parkIds, array_bytes(sizeof(int), rows));
+    mem_free(MEM_MOVEMENTS, image->plateKeys,
+            array_bytes(sizeof(unsigned int), rows));
+    mem_free(MEM_MOVEMENTS, image->stamps,
+            array_bytes(sizeof(long long), rows));
+    mem_free(MEM_MOVEMENTS, image->previous,
+            array_bytes(sizeof(unsigned int), rows));
+    mem_free(MEM_MOVEMENTS, image->movements, (rows + 1) * sizeof(Movement*));
+    mem_free(MEM_MOVEMENTS, image->rowStates, rows + 1);
+    mem_free(MEM_MOVEMENTS, image->plateKeysSeen,
+            array_bytes(sizeof(unsigned int), plates));
+    mem_free(MEM_MOVEMENTS, image->lastRows,
+            array_bytes(sizeof(unsigned int), plates));
+    mem_free(MEM_MOVEMENTS, image->plateDone, plates + 1);
+    mem_free(MEM_MOVEMENTS, image->plateSlots,
+            (image->slotMask + 1) * sizeof(int));
+    mem_free(MEM_MOVEMENTS, image->eagerRows,
+            (image->eagerCount + 1) * sizeof(ImageRow));
+    mem_free(MEM_MOVEMENTS, image, sizeof(StateImage));
+}
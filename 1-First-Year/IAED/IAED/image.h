@@ -0,0 +1,146 @@
+/**
+ * @file image.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief State image of the system, restored lazily on startup.
+ *
+ * The image holds the parks, the open stays and the last movement, which
+ * are enough to accept entries and exits again, followed by the full
+ * history in columns. Loading reads only the first part. The history is
+ * read on the first command that needs it, and each park or vehicle is
+ * only added to the billing and vehicle indexes when a command asks for it.
+ */
+#ifndef IMAGE_H
+#define IMAGE_H
+
+/// File named by the variable the state is restored from and saved to
+#define IMAGE_FILE_VARIABLE "PROJ1_IMAGE"
+#define IMAGE_MAGIC "PIMG"
+#define IMAGE_VERSION 2
+/// Previous row of a plate without one, and last row of a plate without any
+#define IMAGE_ROW_NONE 0xFFFFFFFFu
+/// More plates than the slots of their table can hold
+#define IMAGE_PLATES_MAX 0x40000000u
+
+/// Rows
+#define IMAGE_ROW_COLD 0    ///< Only in the image columns.
+#define IMAGE_ROW_EAGER 1   ///< Loaded on startup, owned by the movement list.
+#define IMAGE_ROW_LINKED 2  ///< Restored into the vehicle index.
+
+/// Parks
+#define IMAGE_PARK_DONE 0   ///< Nothing left to restore.
+#define IMAGE_PARK_COLD 1   ///< Billing and occupancy not restored yet.
+
+/**
+ * @brief Header of an image file.
+ *
+ * @param magic IMAGE_MAGIC, without the terminator.
+ * @param version IMAGE_VERSION.
+ * @param parks Number of park records.
+ * @param eager Number of rows loaded on startup.
+ * @param movements Number of rows in the history.
+ * @param plates Number of plates, in the order they were first seen.
+ * @param overstayLimit The overstay limit, in minutes.
+ * @param overstayClock The minute the overstay alerts were checked up to.
+ */
+typedef struct ImageHeader {
+    char magic[4];
+    int version;
+    int parks;
+    unsigned int eager;
+    unsigned int movements;
+    unsigned int plates;
+    long long overstayLimit;
+    long long overstayClock;
+} ImageHeader;
+
+/**
+ * @brief A park, followed in the file by its nameLength characters.
+ */
+typedef struct ImagePark {
+    int id;
+    int capacity;
+    Charging charge;
+    int available;
+    int nameLength;
+} ImagePark;
+
+/**
+ * @brief A row loaded on startup: an open stay or the last movement.
+ */
+typedef struct ImageRow {
+    unsigned int row;
+    int parkId;
+    unsigned int plateKey;
+    long long stamp;
+} ImageRow;
+
+/**
+ * @brief The image the system was restored from.
+ *
+ * The columns hold every movement of the history in order, with the
+ * stamps of the movement store and, for each row, the previous row of the
+ * same plate, which for an exit is its entry.
+ *
+ * @param path The file, read again for the history.
+ * @param historyOffset Where the history starts in the file.
+ * @param history 1 once the history is read, -1 if it could not be.
+ * @param count Number of rows.
+ * @param parkIds Park of each row.
+ * @param plateKeys Plate of each row, as plate_to_key.
+ * @param stamps Minute and kind of each row, as in the movement store.
+ * @param previous Previous row of the same plate, or IMAGE_ROW_NONE.
+ * @param movements The Movement of each row, once restored.
+ * @param rowStates IMAGE_ROW state of each row.
+ * @param plateCount Number of plates.
+ * @param plateKeysSeen Plates in the order they were first seen.
+ * @param lastRows Last row of each plate.
+ * @param plateDone Whether each plate is restored.
+ * @param plateSlots Open addressing table from plate key to plate.
+ * @param slotMask Number of slots minus one.
+ * @param platesDone Whether the plate search index is restored.
+ * @param eagerRows The rows loaded on startup, in order.
+ * @param eagerCount Number of rows loaded on startup.
+ * @param eagerLive Rows loaded on startup still in the movement store,
+ * which keeps them before every new row.
+ * @param eagerByPark Rows loaded on startup still in each park.
+ * @param parkStates IMAGE_PARK state of each park id.
+ * @param dropped Whether the park that had each id was removed.
+ */
+typedef struct StateImage {
+    char *path;
+    long historyOffset;
+    int history;
+    unsigned int count;
+    int *parkIds;
+    unsigned int *plateKeys;
+    long long *stamps;
+    unsigned int *previous;
+    Movement **movements;
+    unsigned char *rowStates;
+    unsigned int plateCount;
+    unsigned int *plateKeysSeen;
+    unsigned int *lastRows;
+    unsigned char *plateDone;
+    int *plateSlots;
+    unsigned int slotMask;
+    int platesDone;
+    ImageRow *eagerRows;
+    unsigned int eagerCount;
+    unsigned int eagerLive;
+    int eagerByPark[PARK_MAX];
+    unsigned char parkStates[PARK_MAX];
+    unsigned char dropped[PARK_MAX];
+} StateImage;
+
+
+StateImage *image_load(const char *path, Park *parksTotal, int *parksCounter, Movement **head, HashTable *vehicles);
+int image_save(const char *path, Park *parksTotal, int parksCounter, HashTable *vehicles);
+void image_free(StateImage *image);
+void image_materialize_plate(HashTable *vehicles, Park *parksTotal, int parksCounter, char *plate);
+void image_materialize_park(HashTable *vehicles, BillingHashTable *billing, Park *park);
+void image_materialize_all(HashTable *vehicles, BillingHashTable *billing, Park *parksTotal, int parksCounter);
+void image_materialize_plates(HashTable *vehicles);
+void image_drop_park(HashTable *vehicles, int parkId);
+
+#endif
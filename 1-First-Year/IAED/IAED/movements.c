@@ -5,12 +5,17 @@
 #include "proj.h"
 #include "movements.h"
 #include "auxiliary.h"
+#include "accounting.h"
+#include "chains.h"
+#include "bloom.h"
+#include "search.h"
 
 /**
  * @brief Creates a new movement and adds it to the double linked list of
  * movements.
  * 
  * @param head Pointer to the head of the linked list of movements.
+ * @param tail The last movement of the list, or NULL to look for it.
  * @param plate Pointer to the string representing the vehicle's plate.
  * @param parkName Pointer to the string representing the park's name.
  * @param date Struct representing the date of the movement.
@@ -18,15 +23,16 @@
  * @return Pointer to the newly created movement.
  */
 Movement* add_movement(Movement **head, 
+                        Movement *tail, 
                         char *plate, 
                         char *parkName, 
                         Date date, 
                         char command) {
 
-    Movement *newMovement = (Movement*)malloc(sizeof(Movement));
+    Movement *newMovement = mem_alloc(MEM_MOVEMENTS, sizeof(Movement));
     
-    newMovement->plate = strdup(plate);
-    newMovement->parkName = strdup(parkName);
+    newMovement->plate = mem_strdup(MEM_MOVEMENTS, plate);
+    newMovement->parkName = mem_strdup(MEM_MOVEMENTS, parkName);
 
     /// Assign the date and command to the new movement
     newMovement->date = date;
@@ -34,13 +40,17 @@ Movement* add_movement(Movement **head,
 
     newMovement->prev = NULL;
     newMovement->next = NULL;
+    newMovement->stayPrev = NULL;
+    newMovement->stayNext = NULL;
+    newMovement->timer = NULL;
+    newMovement->row = 0;
     
     if (*head == NULL) 
         *head = newMovement;
     
     // If the linked list is not empty, add the new movement in the end
     else {
-        Movement *current = *head;
+        Movement *current = tail != NULL ? tail : *head;
         while (current->next != NULL) {
             current = current->next;
         }
@@ -64,9 +74,9 @@ void free_all_movements(Movement *head) {
         if (current != NULL) {
             current->prev = NULL;
         }
-        free(temp->plate);
-        free(temp->parkName);
-        free(temp);
+        mem_free_string(MEM_MOVEMENTS, temp->plate);
+        mem_free_string(MEM_MOVEMENTS, temp->parkName);
+        mem_free(MEM_MOVEMENTS, temp, sizeof(Movement));
     }
 }
 
@@ -107,9 +117,9 @@ void remove_movements(Movement **head, char *parkName) {
             /// Move to the next node
             current = current->next;
             /// Free the memory allocated for the plate, parkName and node 
-            free(temp->plate);
-            free(temp->parkName);
-            free(temp);
+            mem_free_string(MEM_MOVEMENTS, temp->plate);
+            mem_free_string(MEM_MOVEMENTS, temp->parkName);
+            mem_free(MEM_MOVEMENTS, temp, sizeof(Movement));
         } else 
             current = current->next;
     }
@@ -196,9 +206,16 @@ unsigned int hash_function(char *str) {
  * @return Pointer to the newly created hash table.
  */
 HashTable *hash_table_create(int size) {
-    HashTable *hash_table = malloc(sizeof(HashTable));
-    hash_table->buckets = malloc(sizeof(Node*) * size);
+    HashTable *hash_table = mem_alloc(MEM_VEHICLES, sizeof(HashTable));
+    hash_table->buckets = mem_alloc(MEM_VEHICLES, sizeof(Node*) * size);
     hash_table->size = size;
+    hash_table->keys = 0;
+    hash_table->plates = NULL;
+    hash_table->overstays = NULL;
+    hash_table->chains = NULL;
+    hash_table->store = NULL;
+    hash_table->seen = NULL;
+    hash_table->image = NULL;
 
     /// Initialize all buckets to NULL
     for (int i = 0; i < size; i++) {
@@ -224,6 +241,48 @@ unsigned int secondary_hash_function(char *str) {
     return hash;
 }
 
+/**
+ * @brief Returns whether a chain holds a key.
+ */
+static int chain_has_key(Node *node, char *key) {
+    return next_node_with_key(node, key) != NULL;
+}
+
+/**
+ * @brief Chooses the bucket of a key: the one that already holds it, if
+ * any, otherwise the primary one if it is empty and the secondary one if 
+ * it is not.
+ *
+ * Looking for the key, rather than only at the head of the primary chain,
+ * keeps all the movements of a plate in one chain, even after the removal
+ * of a park empties its primary bucket.
+ *
+ * @param hash_table The hash table.
+ * @param key The key.
+ * @param secondary Set to 1 if the bucket is not the primary one.
+ * @param found Set to 1 if the table already holds the key.
+ * @return The index of the bucket.
+ */
+static int hash_table_bucket(HashTable *hash_table, 
+                            char *key, 
+                            int *secondary, 
+                            int *found) {
+    int hash = hash_function(key) % hash_table->size;
+    int new_hash = secondary_hash_function(key) % hash_table->size;
+
+    *secondary = 0;
+    *found = chain_has_key(hash_table->buckets[hash], key);
+    if (*found)
+        return hash;
+
+    *found = chain_has_key(hash_table->buckets[new_hash], key);
+    if (hash_table->buckets[hash] == NULL && !*found)
+        return hash;
+
+    *secondary = new_hash != hash;
+    return new_hash;
+}
+
 /**
  * @brief Adds a new key-value pair to a hash table.
  *
@@ -232,19 +291,47 @@ unsigned int secondary_hash_function(char *str) {
  * @param value The value of the new key-value pair.
  */
 void hash_table_add(HashTable *hash_table, char *key, Movement *value) {
-    int hash = hash_function(key) % hash_table->size;
+    int secondary, found;
+    int hash = hash_table_bucket(hash_table, key, &secondary, &found);
 
-    Node *new_node = malloc(sizeof(Node));
-    new_node->key = strdup(key);
+    Node *new_node = mem_alloc(MEM_VEHICLES, sizeof(Node));
+    new_node->key = mem_strdup(MEM_VEHICLES, key);
     new_node->value = value;
+    if (!found) {
+        plate_filter_add(hash_table->seen, key);
+        hash_table->keys++;
+    }
 
-    if (hash_table->buckets[hash] == NULL || 
-        strcmp(hash_table->buckets[hash]->key, key) == 0) {
-        insert_node(&hash_table->buckets[hash], new_node);
-    } else {
-        int new_hash = secondary_hash_function(key) % hash_table->size;
-        insert_node(&hash_table->buckets[new_hash], new_node);
+    insert_node(&hash_table->buckets[hash], new_node);
+    chain_stats_insert(hash_table->chains, hash, secondary);
+}
+
+/**
+ * @brief Adds a movement that happened before every movement of the same
+ * vehicle and park already in a hash table.
+ *
+ * The node goes before the other nodes of its park, so restoring a history
+ * newest first leaves it in the same order as if it had been added as it 
+ * happened.
+ *
+ * @param hash_table The hash table to add the key-value pair to.
+ * @param key The key of the new key-value pair.
+ * @param value The value of the new key-value pair.
+ */
+void hash_table_add_history(HashTable *hash_table, char *key, Movement *value) {
+    int secondary, found;
+    int hash = hash_table_bucket(hash_table, key, &secondary, &found);
+
+    Node *new_node = mem_alloc(MEM_VEHICLES, sizeof(Node));
+    new_node->key = mem_strdup(MEM_VEHICLES, key);
+    new_node->value = value;
+    if (!found) {
+        plate_filter_add(hash_table->seen, key);
+        hash_table->keys++;
     }
+
+    insert_node_first(&hash_table->buckets[hash], new_node);
+    chain_stats_insert(hash_table->chains, hash, secondary);
 }
 
 /**
@@ -272,6 +359,32 @@ void insert_node(Node **bucket, Node *new_node) {
     }
 }
 
+/**
+ * @brief Inserts a new node into a sorted linked list, before the nodes 
+ * of the same park.
+ *
+ * @param bucket Pointer to the head of the linked list.
+ * @param new_node The new node to insert.
+ */
+void insert_node_first(Node **bucket, Node *new_node) {
+    Node *current = *bucket;
+    Node *previous = NULL;
+
+    while (current != NULL && 
+        strcmp(current->value->parkName, new_node->value->parkName) < 0){
+        previous = current;
+        current = current->next;
+    }
+
+    if (previous == NULL) {
+        new_node->next = *bucket;
+        *bucket = new_node;
+    } else {
+        new_node->next = current;
+        previous->next = new_node;
+    }
+}
+
 /**
  * @brief Retrieves a node from a hash table by its key.
  *
@@ -281,6 +394,10 @@ void insert_node(Node **bucket, Node *new_node) {
  * returns NULL.
  */
 Node* hash_table_get(HashTable *hash_table, char *key) {
+    /// Plates the filter never saw are in neither chain
+    if (!plate_filter_may_contain(hash_table->seen, key))
+        return NULL;
+
     /// Compute the hash of the key
     int hash = hash_function(key) % hash_table->size;
 
@@ -306,21 +423,42 @@ Node* hash_table_get(HashTable *hash_table, char *key) {
     }
 
     /// Key not found in both hashes, return NULL
+    /// Plates whose movements were removed stay in the filter
+    if (!plate_index_knows(hash_table->plates, key))
+        plate_filter_missed(hash_table->seen);
     return NULL;
 }
 
 /**
- * @brief Prints the details of a series of movements.
+ * @brief Returns the first node of a chain, from a given one, with a key.
  *
- * @param node Pointer to the head of the linked list of movements.
+ * Other plates can share the chain of a plate, so its nodes are not always
+ * next to each other.
+ *
+ * @param node The node to start from, may be NULL.
+ * @param key The key to look for.
+ * @return The node, or NULL if the rest of the chain has no such key.
+ */
+Node *next_node_with_key(Node *node, char *key) {
+    while (node != NULL && strcmp(node->key, key) != 0)
+        node = node->next;
+    return node;
+}
+
+/**
+ * @brief Prints the details of the movements of a vehicle.
+ *
+ * @param node The first node of the vehicle in its chain.
  */
 void print_movement_details(Node *node) {
+    char *plate = node->key;
+
     while (node != NULL) {
         Movement *movement = node->value;
         printf("%s ", movement->parkName);
         format_date(movement->date);
 
-        node = node->next;
+        node = next_node_with_key(node->next, plate);
 
         if (node != NULL) {
             Movement *nextMovement = node->value;
@@ -332,7 +470,7 @@ void print_movement_details(Node *node) {
         printf("\n");
 
         if (node != NULL && node->value->command != COMMAND_E) {
-            node = node->next;
+            node = next_node_with_key(node->next, plate);
         }
     }
 }
@@ -340,6 +478,8 @@ void print_movement_details(Node *node) {
 /**
  * @brief Removes all nodes with a specific park name from a hash table.
  *
+ * Plates left without nodes are dropped from the search index.
+ *
  * @param hash_table The hash table to remove the nodes from.
  * @param parkName The park name of the nodes to remove.
  */
@@ -361,10 +501,18 @@ void hash_table_remove(HashTable *hash_table, char *parkName) {
 
                 // Store the next node before freeing the current node
                 Node *nextNode = current->next;
+                int hash = hash_function(current->key) % hash_table->size;
+                chain_stats_remove(hash_table->chains, i, hash != i);
+
+                /// A plate keeps all its nodes in one chain
+                if (!chain_has_key(hash_table->buckets[i], current->key)) {
+                    plate_index_forget(hash_table->plates, current->key);
+                    hash_table->keys--;
+                }
 
                 // Free the Node and its data
-                free(current->key);
-                free(current);
+                mem_free_string(MEM_VEHICLES, current->key);
+                mem_free(MEM_VEHICLES, current, sizeof(Node));
 
                 // Move to the next node
                 current = nextNode;
@@ -389,22 +537,27 @@ void hash_table_free(HashTable *hash_table) {
         // Free the linked list in each bucket
         while (node != NULL) {
             Node *next_node = node->next;
-            free(node->key);
-            free(node);
+            mem_free_string(MEM_VEHICLES, node->key);
+            mem_free(MEM_VEHICLES, node, sizeof(Node));
             node = next_node;
         }
     }
     // Free the array of buckets
-    free(hash_table->buckets);
+    mem_free(MEM_VEHICLES, hash_table->buckets, 
+            sizeof(Node*) * hash_table->size);
 
     // Free the hash table itself
-    free(hash_table);
+    mem_free(MEM_VEHICLES, hash_table, sizeof(HashTable));
 }
 
 BillingHashTable *bill_hash_table_create(int size) {
-    BillingHashTable *hash_table = malloc(sizeof(BillingHashTable));
-    hash_table->buckets = malloc(sizeof(BillingNode*) * size);
+    BillingHashTable *hash_table = mem_alloc(MEM_BILLING, 
+                                            sizeof(BillingHashTable));
+    hash_table->buckets = mem_alloc(MEM_BILLING, sizeof(BillingNode*) * size);
     hash_table->size = size;
+    hash_table->cube = NULL;
+    hash_table->ledger = NULL;
+    hash_table->chains = NULL;
 
     // Initialize all buckets to NULL
     for (int i = 0; i < size; i++) {
@@ -420,21 +573,24 @@ BillingHashTable *bill_hash_table_create(int size) {
  * @param hash_table The billing hash table to add the node to.
  * @param key The key of the new node.
  * @param value The value of the new node.
- * @param bill The bill associated with the new node.
+ * @param bill The bill associated with the new node, in cents.
+ * @param minutes The chargeable minutes of the billed stay.
  */
 void bill_hash_table_add(BillingHashTable *hash_table, 
                         char *key, 
                         Movement *value, 
-                        double bill) {
+                        long long bill, 
+                        long long minutes) {
 
     // Compute the hash of the key
     int hash = hash_function(key) % hash_table->size;
 
     // Create a new node
-    BillingNode *new_node = malloc(sizeof(BillingNode));
-    new_node->key = strdup(key);
+    BillingNode *new_node = mem_alloc(MEM_BILLING, sizeof(BillingNode));
+    new_node->key = mem_strdup(MEM_BILLING, key);
     new_node->value = value;
     new_node->bill = bill;
+    new_node->minutes = minutes;
     new_node->next = NULL;
 
     // If the bucket is empty, add the new node directly
@@ -448,6 +604,49 @@ void bill_hash_table_add(BillingHashTable *hash_table,
         }
         current->next = new_node;
     }
+    chain_stats_insert(hash_table->chains, hash, 0);
+}
+
+/**
+ * @brief Adds, in order, bills older than every bill of the same park
+ * already in a billing hash table.
+ *
+ * The nodes go right before the first node of the park, or at the end of
+ * the chain when the park has none, so the bills of a park stay in the 
+ * order they happened.
+ *
+ * @param hash_table The billing hash table to add the nodes to.
+ * @param key The park name of the new nodes.
+ * @param values The exit movements, oldest first.
+ * @param bills The bill of each exit, in cents.
+ * @param minutes The chargeable minutes of each billed stay.
+ * @param count The number of bills.
+ */
+void bill_hash_table_add_history(BillingHashTable *hash_table, 
+                                char *key, 
+                                Movement **values, 
+                                long long *bills, 
+                                long long *minutes, 
+                                int count) {
+
+    int hash = hash_function(key) % hash_table->size;
+
+    /// Find the link to the first node of the park
+    BillingNode **link = &hash_table->buckets[hash];
+    while (*link != NULL && strcmp((*link)->key, key) != 0)
+        link = &(*link)->next;
+
+    for (int i = 0; i < count; i++) {
+        BillingNode *new_node = mem_alloc(MEM_BILLING, sizeof(BillingNode));
+        new_node->key = mem_strdup(MEM_BILLING, key);
+        new_node->value = values[i];
+        new_node->bill = bills[i];
+        new_node->minutes = minutes[i];
+        new_node->next = *link;
+        *link = new_node;
+        link = &new_node->next;
+        chain_stats_insert(hash_table->chains, hash, 0);
+    }
 }
 
 /**
@@ -503,10 +702,11 @@ void bill_hash_table_remove(BillingHashTable *hash_table, char *parkName) {
 
             /// Store the next node before freeing the current node
             BillingNode *nextNode = current->next;
+            chain_stats_remove(hash_table->chains, hash, 0);
 
             /// Free the key and the BillingNode 
-            free(current->key);
-            free(current);
+            mem_free_string(MEM_BILLING, current->key);
+            mem_free(MEM_BILLING, current, sizeof(BillingNode));
 
             /// Move to the next node
             current = nextNode;
@@ -532,18 +732,115 @@ void bill_hash_table_free(BillingHashTable *billing) {
             BillingNode *next_node = node->next;
 
             /// Free the key and the value
-            free(node->key);
+            mem_free_string(MEM_BILLING, node->key);
            
             /// Free the node itself
-            free(node);
+            mem_free(MEM_BILLING, node, sizeof(BillingNode));
 
             node = next_node;
         }
     }
 
     // Free the array of buckets
-    free(billing->buckets);
+    mem_free(MEM_BILLING, billing->buckets, 
+            sizeof(BillingNode*) * billing->size);
 
     // Free the hash table itself
-    free(billing);
-}
\ No newline at end of file
+    mem_free(MEM_BILLING, billing, sizeof(BillingHashTable));
+}
+
+/**
+ * @brief Creates an empty set of open stays.
+ *
+ * @return Pointer to the new set, or NULL if memory allocation failed.
+ */
+StaySet *stay_set_create(void) {
+    StaySet *stays = mem_alloc(MEM_PARKS, sizeof(StaySet));
+    if (stays == NULL)
+        return NULL;
+
+    stays->first = NULL;
+    stays->last = NULL;
+    stays->count = 0;
+    return stays;
+}
+
+/**
+ * @brief Frees a set of open stays, but not the movements in it.
+ *
+ * @param stays The set to free, may be NULL.
+ */
+void stay_set_free(StaySet *stays) {
+    mem_free(MEM_PARKS, stays, sizeof(StaySet));
+}
+
+/**
+ * @brief Adds an entry to the open stays of its park.
+ *
+ * Entries arrive in chronological order, so the set stays in entry order.
+ *
+ * @param stays The open stays of the park, may be NULL.
+ * @param entry The entry movement.
+ */
+void stay_set_insert(StaySet *stays, Movement *entry) {
+    if (stays == NULL)
+        return;
+
+    entry->stayPrev = stays->last;
+    entry->stayNext = NULL;
+
+    if (stays->last != NULL)
+        stays->last->stayNext = entry;
+    else
+        stays->first = entry;
+
+    stays->last = entry;
+    stays->count++;
+}
+
+/**
+ * @brief Removes an entry from the open stays of its park.
+ *
+ * @param stays The open stays of the park, may be NULL.
+ * @param entry The entry movement, which must be in the set.
+ */
+void stay_set_remove(StaySet *stays, Movement *entry) {
+    if (stays == NULL)
+        return;
+
+    if (entry->stayPrev != NULL)
+        entry->stayPrev->stayNext = entry->stayNext;
+    else
+        stays->first = entry->stayNext;
+
+    if (entry->stayNext != NULL)
+        entry->stayNext->stayPrev = entry->stayPrev;
+    else
+        stays->last = entry->stayPrev;
+
+    entry->stayPrev = NULL;
+    entry->stayNext = NULL;
+    stays->count--;
+}
+
+/**
+ * @brief Prints the open stays of a park, from the oldest entry.
+ *
+ * Prints `<plate> <date> <time>` for each vehicle inside the park.
+ *
+ * @param stays The open stays of the park, may be NULL.
+ */
+void stay_set_print(StaySet *stays) {
+    if (stays == NULL)
+        return;
+
+    for (Movement *entry = stays->first; entry; entry = entry->stayNext)
+        printf("%s %02d-%02d-%04d %02d:%02d%c",
+            entry->plate,
+            entry->date.day,
+            entry->date.month,
+            entry->date.year,
+            entry->date.time.hour,
+            entry->date.time.minute,
+            NEW_LINE);
+}
@@ -16,6 +16,10 @@
  * @param command The command that represents the type of movement (entry or exit).
  * @param prev Pointer to the previous movement in the linked list of movements.
  * @param next Pointer to the next movement in the linked list of movements.
+ * @param stayPrev Previous open stay of the same park, for entries only.
+ * @param stayNext Next open stay of the same park, for entries only.
+ * @param timer The pending overstay alert of an open entry, or NULL.
+ * @param row Position of the movement in the movement store.
  */
 typedef struct Movement {
     char *plate; 
@@ -24,8 +28,28 @@ typedef struct Movement {
     char command;      
     struct Movement *prev;
     struct Movement *next;
+    struct Movement *stayPrev;
+    struct Movement *stayNext;
+    struct OverstayTimer *timer;
+    unsigned int row;
 } Movement;
 
+/**
+ * @brief Represents the vehicles currently inside a park.
+ *
+ * The entry movements are linked through their own stayPrev and stayNext
+ * fields, so adding or removing a stay never allocates or searches.
+ *
+ * @param first The oldest open entry.
+ * @param last The newest open entry.
+ * @param count The number of open entries.
+ */
+typedef struct StaySet {
+    Movement *first;
+    Movement *last;
+    int count;
+} StaySet;
+
 /**
  * @brief Represents a node in a hash table.
  *
@@ -44,10 +68,24 @@ typedef struct Node {
  *
  * @param buckets The array of linked lists of nodes.
  * @param size The number of buckets in the hash table.
+ * @param keys The number of distinct plates with nodes in the table.
+ * @param plates The search index of every plate in the table.
+ * @param overstays The overstay timers of the open stays.
+ * @param chains Chain length statistics of the table.
+ * @param store Columns of the movements, for the scans over them.
+ * @param seen Bloom filter of every plate ever added.
+ * @param image The state image the table was restored from, or NULL.
  */
 typedef struct HashTable {
     Node **buckets;
     int size;
+    int keys;
+    struct PlateIndex *plates;
+    struct TimerWheel *overstays;
+    struct ChainStats *chains;
+    struct MovementStore *store;
+    struct PlateFilter *seen;
+    struct StateImage *image;
 } HashTable;
 
 /**
@@ -55,13 +93,15 @@ typedef struct HashTable {
  *
  * @param key The key of the node.
  * @param value The value of the node, which is a movement.
- * @param bill The bill associated with the node.
+ * @param bill The bill associated with the node, in cents.
+ * @param minutes The chargeable minutes of the stay that was billed.
  * @param next Pointer to the next node in the linked list of nodes.
  */
 typedef struct BillingNode {
     char *key;
     Movement *value;
-    double bill;
+    long long bill;
+    long long minutes;
     struct BillingNode *next;
 } BillingNode;
 
@@ -70,32 +110,48 @@ typedef struct BillingNode {
  *
  * @param buckets The array of linked lists of nodes.
  * @param size The number of buckets in the billing hash table.
+ * @param cube The revenue of every park by day, kept next to the records.
+ * @param ledger The spend and dwell of each vehicle in every park.
+ * @param chains Chain length statistics of the table.
  */
 typedef struct BillingHashTable {
     BillingNode **buckets;
     int size;
+    struct RevenueCube *cube;
+    struct VehicleLedger *ledger;
+    struct ChainStats *chains;
 } BillingHashTable;
 
 
-Movement*  add_movement(Movement **head, char *plate, char *parkName, Date date, char command);
+Movement*  add_movement(Movement **head, Movement *tail, char *plate, char *parkName, Date date, char command);
 void free_all_movements(Movement *head);
 void remove_movements(Movement **head, char *parkName);
 Date get_last_movement_date(Movement *head);
 Movement* find_entry_movement(Movement *head, char *plateVehicle);
 Movement* get_tail(Movement *head);
 unsigned int hash_function(char *str);
+unsigned int secondary_hash_function(char *str);
 HashTable *hash_table_create(int size);
 void hash_table_add(HashTable *hash_table, char *key, Movement *value);
+void hash_table_add_history(HashTable *hash_table, char *key, Movement *value);
 Node* hash_table_get(HashTable *hash_table, char *key);
 void hash_table_remove(HashTable *hash_table, char *parkName);
 void insert_node(Node **bucket, Node *new_node);
+void insert_node_first(Node **bucket, Node *new_node);
+Node *next_node_with_key(Node *node, char *key);
 void print_movement_details(Node *node);
 void hash_table_print(HashTable *hash_table);
 void hash_table_free(HashTable *hash_table);
 BillingHashTable *bill_hash_table_create(int size);
-void bill_hash_table_add(BillingHashTable *hash_table, char *key, Movement *value, double bill);
+void bill_hash_table_add(BillingHashTable *hash_table, char *key, Movement *value, long long bill, long long minutes);
+void bill_hash_table_add_history(BillingHashTable *hash_table, char *key, Movement **values, long long *bills, long long *minutes, int count);
 BillingNode* bill_hash_table_get(BillingHashTable *hash_table, char *key);
 void bill_hash_table_remove(BillingHashTable *hash_table, char *parkName);
 void bill_hash_table_free(BillingHashTable *billing);
+StaySet *stay_set_create(void);
+void stay_set_free(StaySet *stays);
+void stay_set_insert(StaySet *stays, Movement *entry);
+void stay_set_remove(StaySet *stays, Movement *entry);
+void stay_set_print(StaySet *stays);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,234 @@
+/**
+ * @file occupancy.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Hourly occupancy of a park, kept up to date on every movement.
+ *
+ * Movements arrive in chronological order, so only the last stored hour
+ * ever changes and recording a movement is constant time. The average of
+ * an hour is weighted by how long each occupancy lasted within it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "proj.h"
+#include "calendar.h"
+#include "occupancy.h"
+#include "accounting.h"
+
+/**
+ * @brief Creates an empty occupancy series.
+ *
+ * @return Pointer to the new series, or NULL if memory allocation failed.
+ */
+OccupancySeries *occupancy_create(void) {
+    OccupancySeries *series = mem_alloc(MEM_PARKS, sizeof(OccupancySeries));
+    if (series == NULL)
+        return NULL;
+
+    series->slots = mem_alloc(MEM_PARKS,
+                            OCCUPANCY_INITIAL_HOURS * sizeof(HourSlot));
+    series->count = 0;
+    series->capacity = OCCUPANCY_INITIAL_HOURS;
+    return series;
+}
+
+/**
+ * @brief Frees an occupancy series.
+ *
+ * @param series The series to free, may be NULL.
+ */
+void occupancy_free(OccupancySeries *series) {
+    if (series == NULL)
+        return;
+
+    mem_free(MEM_PARKS, series->slots, series->capacity * sizeof(HourSlot));
+    mem_free(MEM_PARKS, series, sizeof(OccupancySeries));
+}
+
+/**
+ * @brief Starts a new hour with the occupancy left by the previous one.
+ *
+ * @param series The series to extend.
+ * @param hour The number of the new hour.
+ * @return The new hour, or NULL if memory allocation failed.
+ */
+static HourSlot *open_hour(OccupancySeries *series, long long hour) {
+    int occupied = 0;
+
+    if (series->count == series->capacity) {
+        int capacity = series->capacity * 2;
+        HourSlot *slots = mem_realloc(MEM_PARKS, series->slots,
+                                    series->capacity * sizeof(HourSlot),
+                                    capacity * sizeof(HourSlot));
+        if (slots == NULL)
+            return NULL;
+
+        series->slots = slots;
+        series->capacity = capacity;
+    }
+
+    if (series->count > 0)
+        occupied = series->slots[series->count - 1].occupied;
+
+    HourSlot *slot = &series->slots[series->count++];
+    slot->hour = hour;
+    slot->occupied = occupied;
+    slot->peak = occupied;
+    slot->minimum = occupied;
+    slot->entries = 0;
+    slot->exits = 0;
+    slot->lastMinute = 0;
+    slot->spotMinutes = 0;
+    return slot;
+}
+
+/**
+ * @brief Records a movement in the occupancy of its park.
+ *
+ * @param series The series of the park, may be NULL.
+ * @param date The date of the movement.
+ * @param occupied Occupied spots after the movement.
+ * @param command COMMAND_E for an entry, COMMAND_S for an exit.
+ */
+void occupancy_record(OccupancySeries *series,
+                        Date date,
+                        int occupied,
+                        char command) {
+
+    if (series == NULL || series->slots == NULL)
+        return;
+
+    long long hour = minute_number(date) / MINUTES_PER_HOUR;
+    HourSlot *slot = NULL;
+
+    if (series->count > 0 && series->slots[series->count - 1].hour == hour)
+        slot = &series->slots[series->count - 1];
+    else if ((slot = open_hour(series, hour)) == NULL)
+        return;
+
+    /// The previous occupancy lasted until this minute
+    slot->spotMinutes +=
+        (long long)slot->occupied * (date.time.minute - slot->lastMinute);
+    slot->lastMinute = date.time.minute;
+    slot->occupied = occupied;
+
+    if (occupied > slot->peak)
+        slot->peak = occupied;
+    if (occupied < slot->minimum)
+        slot->minimum = occupied;
+
+    if (command == COMMAND_E)
+        slot->entries++;
+    else
+        slot->exits++;
+}
+
+/**
+ * @brief Finds the first stored hour that is not before a given hour.
+ *
+ * @param series The series to search.
+ * @param hour The hour to look for.
+ * @return The index of that hour, or count if there is none.
+ */
+static int find_hour(OccupancySeries *series, long long hour) {
+    int low = 0, high = series->count;
+
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (series->slots[middle].hour < hour)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+/**
+ * @brief Prints one hour of occupancy.
+ *
+ * The average is printed with two decimal places.
+ *
+ * @param hour The number of the hour.
+ * @param spotMinutes Occupied spots times minutes over the whole hour.
+ * @param peak Most spots occupied during the hour.
+ * @param minimum Fewest spots occupied during the hour.
+ * @param entries Entries during the hour.
+ * @param exits Exits during the hour.
+ */
+static void print_hour(long long hour,
+                        long long spotMinutes,
+                        int peak,
+                        int minimum,
+                        int entries,
+                        int exits) {
+
+    Date date = date_from_minute_number(hour * MINUTES_PER_HOUR);
+    long long average = (spotMinutes * 100 + MINUTES_PER_HOUR / 2) /
+                        MINUTES_PER_HOUR;
+
+    printf("%02d-%02d-%04d %02d:00 %lld.%02lld %d %d %d %d%c",
+        date.day,
+        date.month,
+        date.year,
+        date.time.hour,
+        average / 100,
+        average % 100,
+        peak,
+        minimum,
+        entries,
+        exits,
+        NEW_LINE);
+}
+
+/**
+ * @brief Prints the hourly occupancy of a park between two days.
+ *
+ * Prints one line per hour, from the first hour with a movement in the park
+ * and never past the current hour, with the average, peak and minimum
+ * occupied spots and the entries and exits of the hour.
+ *
+ * @param series The series of the park.
+ * @param from The first day to show.
+ * @param to The last day to show.
+ * @param now The date of the last movement in the system.
+ */
+void show_occupancy(OccupancySeries *series, Date from, Date to, Date now) {
+    long long firstHour = day_number(from) * HOURS_PER_DAY;
+    long long lastHour = (day_number(to) + 1) * HOURS_PER_DAY - 1;
+    long long nowHour = minute_number(now) / MINUTES_PER_HOUR;
+
+    if (series == NULL || series->count == 0)
+        return;
+
+    if (lastHour > nowHour)
+        lastHour = nowHour;
+    if (firstHour < series->slots[0].hour)
+        firstHour = series->slots[0].hour;
+
+    int index = find_hour(series, firstHour);
+    /// Occupancy carried into the first hour from the last stored one
+    int occupied = index > 0 ? series->slots[index - 1].occupied : 0;
+
+    for (long long hour = firstHour; hour <= lastHour; hour++) {
+        if (index < series->count && series->slots[index].hour == hour) {
+            HourSlot *slot = &series->slots[index++];
+            long long spotMinutes = slot->spotMinutes + (long long)
+                slot->occupied * (MINUTES_PER_HOUR - slot->lastMinute);
+
+            print_hour(hour,
+                        spotMinutes,
+                        slot->peak,
+                        slot->minimum,
+                        slot->entries,
+                        slot->exits);
+            occupied = slot->occupied;
+        }
+        else
+            print_hour(hour,
+                        (long long)occupied * MINUTES_PER_HOUR,
+                        occupied,
+                        occupied,
+                        0,
+                        0);
+    }
+}
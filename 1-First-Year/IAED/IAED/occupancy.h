@@ -0,0 +1,57 @@
+/**
+ * @file occupancy.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Hourly occupancy of a park, kept up to date on every movement.
+ */
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#define OCCUPANCY_INITIAL_HOURS 64
+
+/**
+ * @brief Occupancy of a park during one hour with at least one movement.
+ *
+ * @param hour The hour, numbered from 01-01-0001 00:00.
+ * @param occupied Occupied spots after the last movement seen so far.
+ * @param peak Most spots occupied at any moment of the hour.
+ * @param minimum Fewest spots occupied at any moment of the hour.
+ * @param entries Entries during the hour.
+ * @param exits Exits during the hour.
+ * @param lastMinute Minute of the hour of the last movement seen so far.
+ * @param spotMinutes Occupied spots times minutes, up to lastMinute.
+ */
+typedef struct HourSlot {
+    long long hour;
+    int occupied;
+    int peak;
+    int minimum;
+    int entries;
+    int exits;
+    int lastMinute;
+    long long spotMinutes;
+} HourSlot;
+
+/**
+ * @brief Hour by hour occupancy of a park, in chronological order.
+ *
+ * Hours without movements are not stored: their occupancy is the one left
+ * by the previous stored hour.
+ *
+ * @param slots The hours with movements.
+ * @param count The number of stored hours.
+ * @param capacity The number of hours allocated.
+ */
+typedef struct OccupancySeries {
+    HourSlot *slots;
+    int count;
+    int capacity;
+} OccupancySeries;
+
+
+OccupancySeries *occupancy_create(void);
+void occupancy_free(OccupancySeries *series);
+void occupancy_record(OccupancySeries *series, Date date, int occupied, char command);
+void show_occupancy(OccupancySeries *series, Date from, Date to, Date now);
+
+#endif
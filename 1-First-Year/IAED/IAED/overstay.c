@@ -0,0 +1,288 @@
+/**
+ * @file overstay.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Overstay alerts driven by a hierarchical timer wheel.
+ *
+ * Every entry arms a timer for the moment its stay goes over the limit and
+ * its exit cancels it. The clock is the date of the last movement, so the
+ * wheel moves forward whenever a vehicle enters or leaves and prints one
+ * alert for each stay whose deadline it passed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "proj.h"
+#include "movements.h"
+#include "calendar.h"
+#include "overstay.h"
+#include "auxiliary.h"
+#include "accounting.h"
+
+/**
+ * @brief Creates an empty timer wheel with overstay alerts disabled.
+ *
+ * @return Pointer to the new wheel, or NULL if memory allocation failed.
+ */
+TimerWheel *overstay_create(void) {
+    TimerWheel *wheel = mem_calloc(MEM_VEHICLES, 1, sizeof(TimerWheel));
+    if (wheel == NULL)
+        return NULL;
+
+    wheel->limit = OVERSTAY_DISABLED;
+    return wheel;
+}
+
+/**
+ * @brief Unlinks a timer from its slot.
+ *
+ * @param wheel The timer wheel.
+ * @param timer The timer.
+ */
+static void unlink_timer(TimerWheel *wheel, OverstayTimer *timer) {
+    int slot = timer->slot;
+
+    if (timer->prev != NULL)
+        timer->prev->next = timer->next;
+    else
+        wheel->heads[slot] = timer->next;
+
+    if (timer->next != NULL)
+        timer->next->prev = timer->prev;
+    else
+        wheel->tails[slot] = timer->prev;
+
+    if (wheel->heads[slot] == NULL)
+        wheel->occupied[slot / WHEEL_SLOTS] &=
+            ~(1ULL << (slot % WHEEL_SLOTS));
+}
+
+/**
+ * @brief Frees a timer wheel and every pending timer.
+ *
+ * @param wheel The wheel to free, may be NULL.
+ */
+void overstay_free(TimerWheel *wheel) {
+    if (wheel == NULL)
+        return;
+
+    for (int slot = 0; slot < WHEEL_LEVELS * WHEEL_SLOTS; slot++) {
+        OverstayTimer *timer = wheel->heads[slot];
+        while (timer != NULL) {
+            OverstayTimer *next = timer->next;
+            timer->entry->timer = NULL;
+            mem_free(MEM_VEHICLES, timer, sizeof(OverstayTimer));
+            timer = next;
+        }
+    }
+    mem_free(MEM_VEHICLES, wheel, sizeof(TimerWheel));
+}
+
+/**
+ * @brief Prints the alert of a stay that went over the limit and drops its
+ * timer.
+ *
+ * Prints `overstay <plate> <park> <date> <time>` with the time of entry,
+ * unless the output of the commands is off.
+ *
+ * @param timer The timer, already unlinked.
+ */
+static void fire(OverstayTimer *timer) {
+    Movement *entry = timer->entry;
+
+    if (echo_enabled())
+        printf("%s %s %s %02d-%02d-%04d %02d:%02d%c",
+            OVERSTAY_ALERT,
+            entry->plate,
+            entry->parkName,
+            entry->date.day,
+            entry->date.month,
+            entry->date.year,
+            entry->date.time.hour,
+            entry->date.time.minute,
+            NEW_LINE);
+
+    entry->timer = NULL;
+    mem_free(MEM_VEHICLES, timer, sizeof(OverstayTimer));
+}
+
+/**
+ * @brief Puts a timer in the slot its deadline belongs to, or fires it if
+ * the deadline has been reached.
+ *
+ * Timers that share a slot keep the order they were placed in, so equal
+ * deadlines fire in order of entry.
+ *
+ * @param wheel The timer wheel.
+ * @param timer The timer, not linked.
+ */
+static void place(TimerWheel *wheel, OverstayTimer *timer) {
+    if (timer->deadline <= wheel->now) {
+        fire(timer);
+        return;
+    }
+
+    unsigned long long differ = timer->deadline ^ wheel->now;
+    int level = (63 - __builtin_clzll(differ)) / WHEEL_SLOT_BITS;
+    int digit = (timer->deadline >> (level * WHEEL_SLOT_BITS)) &
+                (WHEEL_SLOTS - 1);
+    int slot = level * WHEEL_SLOTS + digit;
+
+    timer->slot = slot;
+    timer->next = NULL;
+    timer->prev = wheel->tails[slot];
+
+    if (wheel->tails[slot] != NULL)
+        wheel->tails[slot]->next = timer;
+    else
+        wheel->heads[slot] = timer;
+
+    wheel->tails[slot] = timer;
+    wheel->occupied[level] |= 1ULL << digit;
+}
+
+/**
+ * @brief Arms the overstay timer of a new entry.
+ *
+ * @param wheel The timer wheel, may be NULL.
+ * @param entry The entry movement.
+ */
+void overstay_arm(TimerWheel *wheel, Movement *entry) {
+    if (wheel == NULL || wheel->limit == OVERSTAY_DISABLED)
+        return;
+
+    OverstayTimer *timer = mem_alloc(MEM_VEHICLES, sizeof(OverstayTimer));
+    if (timer == NULL)
+        return;
+
+    /// The stay is over the limit one minute after reaching it
+    timer->entry = entry;
+    timer->deadline = minute_number(entry->date) + wheel->limit + 1;
+    if (timer->deadline >= WHEEL_HORIZON)
+        timer->deadline = WHEEL_HORIZON - 1;
+
+    entry->timer = timer;
+    place(wheel, timer);
+}
+
+/**
+ * @brief Arms the overstay timer of an open stay restored from an image.
+ *
+ * The clock must already be where it was before the restart. A stay over
+ * the limit by then had its alert printed already, so it gets no timer.
+ *
+ * @param wheel The timer wheel, may be NULL.
+ * @param entry The entry movement.
+ */
+void overstay_restore(TimerWheel *wheel, Movement *entry) {
+    if (wheel == NULL || wheel->limit == OVERSTAY_DISABLED)
+        return;
+    if (minute_number(entry->date) + wheel->limit + 1 <= wheel->now)
+        return;
+
+    overstay_arm(wheel, entry);
+}
+
+/**
+ * @brief Cancels the overstay timer of a stay that ended.
+ *
+ * @param wheel The timer wheel, may be NULL.
+ * @param entry The entry movement of the stay.
+ */
+void overstay_cancel(TimerWheel *wheel, Movement *entry) {
+    if (wheel == NULL || entry == NULL || entry->timer == NULL)
+        return;
+
+    unlink_timer(wheel, entry->timer);
+    mem_free(MEM_VEHICLES, entry->timer, sizeof(OverstayTimer));
+    entry->timer = NULL;
+}
+
+/**
+ * @brief Moves the clock forward, firing every deadline it reaches.
+ *
+ * @param wheel The timer wheel, may be NULL.
+ * @param date The date of the latest movement.
+ */
+void overstay_advance(TimerWheel *wheel, Date date) {
+    if (wheel == NULL)
+        return;
+
+    long long target = minute_number(date);
+
+    while (wheel->now < target) {
+        long long next = target;
+        int level = 0, digit = 0;
+
+        /// Lower levels hold earlier deadlines, so the first occupied slot
+        /// after the clock is the next thing that happens
+        for (; level < WHEEL_LEVELS; level++) {
+            int shift = level * WHEEL_SLOT_BITS;
+            int current = (wheel->now >> shift) & (WHEEL_SLOTS - 1);
+            unsigned long long later = current == WHEEL_SLOTS - 1 ? 0 :
+                wheel->occupied[level] & (~0ULL << (current + 1));
+
+            if (later != 0) {
+                digit = __builtin_ctzll(later);
+                next = (wheel->now >> (shift + WHEEL_SLOT_BITS)
+                        << (shift + WHEEL_SLOT_BITS)) |
+                        ((long long)digit << shift);
+                break;
+            }
+        }
+
+        if (next > target) {
+            wheel->now = target;
+            return;
+        }
+
+        wheel->now = next;
+        if (level == WHEEL_LEVELS)
+            return;
+
+        /// Takes the slot out of the wheel and places its timers again,
+        /// which fires them at level 0 and cascades them above it
+        int slot = level * WHEEL_SLOTS + digit;
+        OverstayTimer *timer = wheel->heads[slot];
+        wheel->heads[slot] = NULL;
+        wheel->tails[slot] = NULL;
+        wheel->occupied[level] &= ~(1ULL << digit);
+
+        while (timer != NULL) {
+            OverstayTimer *nextTimer = timer->next;
+            place(wheel, timer);
+            timer = nextTimer;
+        }
+    }
+}
+
+/**
+ * @brief Changes the longest stay allowed and rearms every open stay.
+ *
+ * Stays already over the new limit are reported at once.
+ *
+ * @param wheel The timer wheel, may be NULL.
+ * @param limit The new limit in minutes, or OVERSTAY_DISABLED.
+ * @param parksTotal Pointer to the array of parks.
+ * @param parksCounter The total number of parks.
+ */
+void overstay_set_limit(TimerWheel *wheel,
+                        long long limit,
+                        Park *parksTotal,
+                        int parksCounter) {
+
+    if (wheel == NULL)
+        return;
+
+    wheel->limit = limit;
+
+    for (int i = 0; i < parksCounter; i++) {
+        if (parksTotal[i].openStays == NULL)
+            continue;
+
+        Movement *entry = parksTotal[i].openStays->first;
+        for (; entry != NULL; entry = entry->stayNext) {
+            overstay_cancel(wheel, entry);
+            overstay_arm(wheel, entry);
+        }
+    }
+}
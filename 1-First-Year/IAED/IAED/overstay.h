@@ -0,0 +1,67 @@
+/**
+ * @file overstay.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Overstay alerts driven by a hierarchical timer wheel.
+ */
+#ifndef OVERSTAY_H
+#define OVERSTAY_H
+
+#define WHEEL_SLOT_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_SLOT_BITS)
+/// Six levels of 64 slots cover 2^36 minutes, past the year 9999
+#define WHEEL_LEVELS 6
+#define WHEEL_HORIZON (1LL << (WHEEL_SLOT_BITS * WHEEL_LEVELS))
+#define OVERSTAY_DISABLED 0
+#define OVERSTAY_ALERT "overstay"
+
+/**
+ * @brief Pending overstay deadline of an open stay.
+ *
+ * @param entry The entry movement of the stay.
+ * @param deadline First minute at which the stay is over the limit.
+ * @param slot Index of the wheel slot that holds the timer.
+ * @param prev Previous timer in the same slot.
+ * @param next Next timer in the same slot.
+ */
+typedef struct OverstayTimer {
+    Movement *entry;
+    long long deadline;
+    int slot;
+    struct OverstayTimer *prev;
+    struct OverstayTimer *next;
+} OverstayTimer;
+
+/**
+ * @brief Hierarchical timer wheel of the open stays.
+ *
+ * A timer is kept at the level of the highest base 64 digit in which its
+ * deadline differs from the clock, in the slot of that digit. Moving the
+ * clock jumps straight to the next occupied slot: level 0 slots fire, the
+ * others cascade their timers to lower levels. Each timer cascades at most
+ * WHEEL_LEVELS times, so firing is constant amortized time.
+ *
+ * @param now The event clock, in minutes.
+ * @param limit Longest stay allowed, in minutes, or OVERSTAY_DISABLED.
+ * @param heads The first timer of each slot, by level then slot.
+ * @param tails The last timer of each slot.
+ * @param occupied Bit of each non empty slot, by level.
+ */
+typedef struct TimerWheel {
+    long long now;
+    long long limit;
+    OverstayTimer *heads[WHEEL_LEVELS * WHEEL_SLOTS];
+    OverstayTimer *tails[WHEEL_LEVELS * WHEEL_SLOTS];
+    unsigned long long occupied[WHEEL_LEVELS];
+} TimerWheel;
+
+
+TimerWheel *overstay_create(void);
+void overstay_free(TimerWheel *wheel);
+void overstay_arm(TimerWheel *wheel, Movement *entry);
+void overstay_restore(TimerWheel *wheel, Movement *entry);
+void overstay_cancel(TimerWheel *wheel, Movement *entry);
+void overstay_advance(TimerWheel *wheel, Date date);
+void overstay_set_limit(TimerWheel *wheel, long long limit, Park *parksTotal, int parksCounter);
+
+#endif
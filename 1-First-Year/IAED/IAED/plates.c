@@ -0,0 +1,240 @@
+/**
+ * @file plates.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Compact integer keys for licence plates.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proj.h"
+#include "plates.h"
+
+/**
+ * @brief Numbers a single pair of a plate.
+ *
+ * @param first The first character of the pair.
+ * @param second The second character of the pair.
+ * @return 0-99 for digit pairs, 100-775 for letter pairs, -1 for a pair that
+ * mixes letters and digits or contains any other character.
+ */
+static int pair_code(char first, char second) {
+    if (IS_DIGIT(first) && IS_DIGIT(second))
+        return (first - '0') * 10 + (second - '0');
+
+    if (IS_UPPERCASE_LETTER(first) && IS_UPPERCASE_LETTER(second))
+        return PLATE_DIGIT_PAIRS + (first - 'A') * 26 + (second - 'A');
+
+    return -1;
+}
+
+/**
+ * @brief Packs a plate into an integer key.
+ *
+ * @param plate The plate, in the exact "XX-XX-XX" layout.
+ * @return The key of the plate, or PLATE_KEY_NONE if the plate is not a valid
+ * plate in that layout.
+ */
+unsigned int plate_to_key(const char *plate) {
+    unsigned int key = 0;
+    int digitPairs = 0;
+
+    if (strlen(plate) != PLATE_LENGTH ||
+        plate[2] != PLATE_SEPARATOR ||
+        plate[5] != PLATE_SEPARATOR)
+        return PLATE_KEY_NONE;
+
+    for (int i = 0; i < PLATE_PAIRS; i++) {
+        int code = pair_code(plate[i * 3], plate[i * 3 + 1]);
+        if (code < 0)
+            return PLATE_KEY_NONE;
+
+        if (code < PLATE_DIGIT_PAIRS)
+            digitPairs++;
+        key = key * PLATE_PAIR_CODES + code;
+    }
+
+    /// A plate needs at least one pair of each kind
+    if (digitPairs == 0 || digitPairs == PLATE_PAIRS)
+        return PLATE_KEY_NONE;
+
+    return key;
+}
+
+/**
+ * @brief Unpacks an integer key back into its plate.
+ *
+ * @param key A key returned by plate_to_key.
+ * @param plate Buffer of at least PLATE_LENGTH + 1 characters.
+ */
+void key_to_plate(unsigned int key, char *plate) {
+    for (int i = PLATE_PAIRS - 1; i >= 0; i--) {
+        int code = key % PLATE_PAIR_CODES;
+        key /= PLATE_PAIR_CODES;
+
+        if (code < PLATE_DIGIT_PAIRS) {
+            plate[i * 3] = '0' + code / 10;
+            plate[i * 3 + 1] = '0' + code % 10;
+        } else {
+            code -= PLATE_DIGIT_PAIRS;
+            plate[i * 3] = 'A' + code / 26;
+            plate[i * 3 + 1] = 'A' + code % 26;
+        }
+        if (i > 0)
+            plate[i * 3 - 1] = PLATE_SEPARATOR;
+    }
+    plate[PLATE_LENGTH] = NULL_TERMINATOR;
+}
+
+/**
+ * @brief Loads the 8 bytes of a plate into a word, byte i in bits 8i-8i+7.
+ *
+ * @param plate The first of the 8 bytes.
+ * @return The word holding the plate.
+ */
+static unsigned long long plate_word(const char *plate) {
+    unsigned long long word = 0;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(&word, plate, sizeof(word));
+#else
+    for (int i = PLATE_LENGTH - 1; i >= 0; i--)
+        word = (word << 8) | (unsigned char)plate[i];
+#endif
+    return word;
+}
+
+/**
+ * @brief Packs a plate whose layout is already known to be valid.
+ *
+ * @param plate The 8 bytes of the plate.
+ * @return The key of the plate.
+ */
+static unsigned int valid_plate_key(const char *plate) {
+    unsigned int key = 0;
+
+    for (int i = 0; i < PLATE_PAIRS; i++)
+        key = key * PLATE_PAIR_CODES + pair_code(plate[i * 3], plate[i*3 + 1]);
+    return key;
+}
+
+/**
+ * @brief Checks a single 8 byte plate with the word-wide kernel.
+ *
+ * @param plate The 8 bytes of the plate, no terminator needed.
+ * @return 1 if the plate is valid, 0 otherwise.
+ */
+int plate_word_is_valid(const char *plate) {
+    unsigned long long word = plate_word(plate);
+    unsigned long long valid;
+
+    PLATE_SWAR_VALID(word, valid);
+    return valid != 0;
+}
+
+/**
+ * @brief Validates and packs plates one at a time.
+ *
+ * Reference version of validate_plates, with identical results.
+ *
+ * @param plates count plates of 8 bytes each, one after the other.
+ * @param count The number of plates.
+ * @param mask Bit i of word i / 64 is set if plate i is valid.
+ * @param keys Receives the key of each plate, PLATE_KEY_NONE if invalid.
+ * @return The number of valid plates.
+ */
+int validate_plates_scalar(const char *plates,
+                            int count,
+                            unsigned long long *mask,
+                            unsigned int *keys) {
+    int validCount = 0;
+
+    for (int i = 0; i < (count + 63) / 64; i++)
+        mask[i] = 0;
+
+    for (int i = 0; i < count; i++) {
+        const char *plate = plates + (long)i * PLATE_LENGTH;
+        int digitPairs = 0, letterPairs = 0;
+
+        keys[i] = PLATE_KEY_NONE;
+        if (plate[2] != PLATE_SEPARATOR || plate[5] != PLATE_SEPARATOR)
+            continue;
+
+        for (int j = 0; j < PLATE_PAIRS; j++) {
+            int code = pair_code(plate[j * 3], plate[j * 3 + 1]);
+            if (code >= PLATE_DIGIT_PAIRS)
+                letterPairs++;
+            else if (code >= 0)
+                digitPairs++;
+        }
+
+        if (digitPairs + letterPairs == PLATE_PAIRS && 
+            digitPairs > 0 && letterPairs > 0) {
+            mask[i / 64] |= 1ULL << (i % 64);
+            keys[i] = valid_plate_key(plate);
+            validCount++;
+        }
+    }
+    return validCount;
+}
+
+/**
+ * @brief Validates and packs many plates, PLATE_LANES at a time.
+ *
+ * Each plate is held in one 64 bit lane and all of its bytes are classified
+ * at once (digit, letter, separator), so a whole group of plates is checked
+ * with a handful of vector operations. Compilers without vector extensions
+ * use validate_plates_scalar instead.
+ *
+ * @param plates count plates of 8 bytes each, one after the other.
+ * @param count The number of plates.
+ * @param mask Bit i of word i / 64 is set if plate i is valid.
+ * @param keys Receives the key of each plate, PLATE_KEY_NONE if invalid.
+ * @return The number of valid plates.
+ */
+int validate_plates(const char *plates,
+                    int count,
+                    unsigned long long *mask,
+                    unsigned int *keys) {
+#if defined(__GNUC__)
+    int validCount = 0, i = 0;
+
+    for (int w = 0; w < (count + 63) / 64; w++)
+        mask[w] = 0;
+
+    for (; i + PLATE_LANES <= count; i += PLATE_LANES) {
+        PlateLanes lanes, valid;
+
+        for (int lane = 0; lane < PLATE_LANES; lane++)
+            lanes[lane] = plate_word(plates + (long)(i + lane) * PLATE_LENGTH);
+
+        PLATE_SWAR_VALID(lanes, valid);
+
+        for (int lane = 0; lane < PLATE_LANES; lane++) {
+            const char *plate = plates + (long)(i + lane) * PLATE_LENGTH;
+
+            keys[i + lane] = PLATE_KEY_NONE;
+            if (valid[lane]) {
+                mask[(i + lane) / 64] |= 1ULL << ((i + lane) % 64);
+                keys[i + lane] = valid_plate_key(plate);
+                validCount++;
+            }
+        }
+    }
+
+    /// The last plates that do not fill a group
+    for (; i < count; i++) {
+        const char *plate = plates + (long)i * PLATE_LENGTH;
+
+        keys[i] = PLATE_KEY_NONE;
+        if (plate_word_is_valid(plate)) {
+            mask[i / 64] |= 1ULL << (i % 64);
+            keys[i] = valid_plate_key(plate);
+            validCount++;
+        }
+    }
+    return validCount;
+#else
+    return validate_plates_scalar(plates, count, mask, keys);
+#endif
+}
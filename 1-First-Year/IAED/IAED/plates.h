@@ -0,0 +1,67 @@
+/**
+ * @file plates.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Compact integer keys for licence plates.
+ *
+ * A valid plate has the fixed layout "XX-XX-XX", so each pair can be
+ * numbered (00-99 for digits, AA-ZZ after them) and the whole plate packed
+ * into a single unsigned int. The same layout lets a plate be validated as
+ * one 64 bit word, and many plates at once with vector extensions.
+ */
+#ifndef PLATES_H
+#define PLATES_H
+
+#define PLATE_LENGTH 8
+#define PLATE_PAIRS 3
+#define PLATE_SEPARATOR '-'
+#define PLATE_DIGIT_PAIRS 100
+#define PLATE_LETTER_PAIRS 676
+#define PLATE_PAIR_CODES (PLATE_DIGIT_PAIRS + PLATE_LETTER_PAIRS)
+#define PLATE_KEY_NONE 0u
+
+/// Word-wide Plate Validation
+#define PLATE_LANES 4
+#define SWAR_ONES 0x0101010101010101ULL
+#define SWAR_HIGH 0x8080808080808080ULL
+#define SWAR_REPEAT(c) (SWAR_ONES * (unsigned char)(c))
+/// High bit of bytes 0, 3 and 6, where the pairs start
+#define PLATE_PAIR_STARTS 0x0080000080000080ULL
+/// High bit of bytes 2 and 5, where the separators are
+#define PLATE_SEPARATORS 0x0000800000800000ULL
+
+/// Sets the high bit of every ASCII byte of x between low and high
+#define SWAR_IN_RANGE(x, low, high) \
+    ((((x) | SWAR_HIGH) - SWAR_REPEAT(low)) & \
+    ~(((x) | SWAR_HIGH) - SWAR_REPEAT((high) + 1)) & ~(x) & SWAR_HIGH)
+
+/// Sets the high bit of every byte of x equal to c
+#define SWAR_EQUALS(x, c) \
+    (~(((((x) ^ SWAR_REPEAT(c)) & ~SWAR_HIGH) + ~SWAR_HIGH) | \
+    ((x) ^ SWAR_REPEAT(c)) | ~SWAR_HIGH))
+
+/// Sets valid to non-zero, per word or per lane, for each valid plate in x
+#define PLATE_SWAR_VALID(x, valid) do { \
+    __typeof__(x) digits_ = SWAR_IN_RANGE(x, '0', '9'); \
+    __typeof__(x) letters_ = SWAR_IN_RANGE(x, 'A', 'Z'); \
+    __typeof__(x) dashes_ = SWAR_EQUALS(x, PLATE_SEPARATOR); \
+    __typeof__(x) digitPairs_ = digits_ & (digits_ >> 8) & PLATE_PAIR_STARTS; \
+    __typeof__(x) letterPairs_ = letters_ & (letters_>>8) & PLATE_PAIR_STARTS; \
+    (valid) = ((dashes_ & PLATE_SEPARATORS) == PLATE_SEPARATORS) & \
+        ((digitPairs_ | letterPairs_) == PLATE_PAIR_STARTS) & \
+        (digitPairs_ != 0) & (letterPairs_ != 0); \
+} while (0)
+
+#if defined(__GNUC__)
+/// One plate per 64 bit lane
+typedef unsigned long long PlateLanes 
+    __attribute__((vector_size(PLATE_LANES * sizeof(unsigned long long))));
+#endif
+
+unsigned int plate_to_key(const char *plate);
+void key_to_plate(unsigned int key, char *plate);
+int plate_word_is_valid(const char *plate);
+int validate_plates_scalar(const char *plates, int count, unsigned long long *mask, unsigned int *keys);
+int validate_plates(const char *plates, int count, unsigned long long *mask, unsigned int *keys);
+
+#endif
@@ -18,6 +18,9 @@
 #define BUFFSIZ 8192
 #define HASH_CAPACITY 10067
 #define HASH_INIT 5381
+#define INT_TEXT_SIZE 12
+/// Sign, 17 digits of units, the point, the cents and the terminator
+#define MONEY_TEXT_SIZE 24
 #define DEFAULT_DATE {0, 0, 0, {0, 0}}
 
 /// Character Constants
@@ -40,6 +43,10 @@
 #define ERROR_INVALID_DATE "invalid date."
 #define ERROR_INVALID_VEHICLE_EXIT "invalid vehicle exit."
 #define ERROR_NO_ENTRIES_FOUND "no entries found in any parking."
+#define ERROR_INVALID_PATTERN "invalid pattern."
+#define ERROR_INVALID_LIMIT "invalid limit."
+#define ERROR_TOO_MANY_TARIFFS "too many tariffs."
+#define ERROR_NO_MEMORY "no memory."
 
 // Function to check if a character is a digit
 #define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
@@ -69,6 +76,15 @@
 #define HOURS_PER_DAY 24
 #define DAYS_PER_YEAR 365
 
+/// Tariff Constants
+#define CENTS_PER_UNIT 100
+/// Largest cost, in units, whose cents still fit in an int
+#define COST_MAX 21474836
+#define MINUTES_PER_PERIOD 15
+#define PERIODS_FIRST_HOUR 4
+#define PERIODS_PER_DAY 96
+#define CHARGE_TABLE_SIZE (PERIODS_PER_DAY + 1)
+
 /**
  * @brief Structure representing a time.
  */
@@ -88,21 +104,30 @@ typedef struct{
 }Date;
 
 /**
- * @brief Structure representing charging information.
+ * @brief Structure representing charging information, in cents.
  */
 typedef struct{
-    float preValue;   ///< The value before charging.
-    float afterValue; ///< The value after charging.
-    float maxValue;   ///< The maximum value that can be charged.
+    int preValue;   ///< The value per 15 minutes in the first hour.
+    int afterValue; ///< The value per 15 minutes after the first hour.
+    int maxValue;   ///< The maximum value that can be charged per day.
 }Charging;
 
 /**
  * @brief Structure representing a park.
  */
 typedef struct{
+    int id;           ///< Stable identifier of the park.
     char *parkName;   ///< The name of the park.
     int capacity;     ///< The capacity of the park.
     Charging charge;  ///< The charging information for the park.
     int available;    ///< The number of available spots in the park.
+    /// Charge in cents by number of started periods, for stays under a day.
+    int chargeTable[CHARGE_TABLE_SIZE];
+    struct OccupancySeries *occupancy; ///< Hourly occupancy of the park.
+    struct BillingPrefix *revenue;     ///< Cumulative revenue by day.
+    struct VehicleLedger *leaders;     ///< Spend and dwell of each vehicle.
+    struct StaySet *openStays;         ///< Vehicles currently inside.
+    struct DwellSeries *dwell;         ///< Stay durations, by exit day.
+    struct BillingCache *results;      ///< Outputs of 'f', kept until stale.
 }Park;
 
@@ -19,9 +19,25 @@
 #include "auxiliary.h"
 #include "validation.h"
 #include "movements.h"
+#include "whatif.h"
+#include "occupancy.h"
+#include "billing.h"
+#include "ranking.h"
+#include "search.h"
+#include "dwell.h"
+#include "overstay.h"
+#include "stats.h"
+#include "accounting.h"
+#include "trace.h"
+#include "chains.h"
+#include "store.h"
+#include "bloom.h"
+#include "arena.h"
+#include "image.h"
 
 /**
- * @brief Frees all allocated memory before program termination.
+ * @brief Saves the state image, if one is configured, and frees all 
+ * allocated memory before program termination.
  *
  * @param parksTotal Array of Park structures.
  * @param parksCounter Count of parks.
@@ -35,10 +51,12 @@ void command_q(Park *parksTotal,
                 HashTable *vehicles, 
                 BillingHashTable *billing){
 
-    hash_table_free(vehicles);
-    bill_hash_table_free(billing);
-    free_all_movements(*head);
-    free_parks(parksTotal, *parksCounter);
+    const char *image = getenv(IMAGE_FILE_VARIABLE);
+    if (image != NULL)
+        image_save(image, parksTotal, *parksCounter, vehicles);
+
+    free_program(parksTotal, parksCounter, head, vehicles, billing);
+    TRACE_DUMP();
 }
 
 /**
@@ -46,21 +64,18 @@ void command_q(Park *parksTotal,
  *
  * @param parksTotal Array of Park structures.
  * @param parksCounter Count of parks.
+ * @param inputLine The rest of the command line.
  */
-void command_p(Park *parksTotal, int *parksCounter){
-    char inputLine[BUFFSIZ], *namePark;
+void command_p(Park *parksTotal, int *parksCounter, char *inputLine){
+    char *namePark;
 
-    /// Read Input 
-    fgets(inputLine, sizeof(inputLine), stdin);
     namePark = get_park_name(inputLine);
 
     /// If a park name is provided, add a new park or list parks
     if(namePark != NULL)
         add_Park(parksTotal, namePark, inputLine, parksCounter);
-    else {
+    else
         list_system_parks(parksTotal,parksCounter);
-        free(namePark);
-    }    
 }
 
 /**
@@ -71,41 +86,31 @@ void command_p(Park *parksTotal, int *parksCounter){
  * @param parksCounter Count of parks.
  * @param head Head of the double linked list of Movements.
  * @param Vehicles HashTable of vehicle movement information.
+ * @param inputLine The rest of the command line.
  */
 void command_e(Park *parksTotal,
                 int *parksCounter, 
                 Movement **head, 
-                HashTable *Vehicles){
+                HashTable *Vehicles, 
+                char *inputLine){
 
-    char inputLine[BUFFSIZ], *namePark, *plateVehicle, command = COMMAND_E;
+    char *namePark, *plateVehicle;
     char *currentPosition;
 
-    /// Read Input 
-    fgets(inputLine, sizeof(inputLine), stdin);
-
     currentPosition = inputLine;
     namePark = get_park_name(inputLine);
     plateVehicle = get_plate(inputLine);
     currentPosition += strlen(plateVehicle) + 1;
     Date *entryDate = get_date(currentPosition);
 
-
     /// Register entry and add to vehicles hash table if successful 
-    Movement *newMovement = register_entry(parksTotal, 
-                                            namePark, 
-                                            plateVehicle, 
-                                            entryDate,
-                                            command, 
-                                            parksCounter, 
-                                            head, 
-                                            Vehicles);
-    free(entryDate);
-
-    if(newMovement)
-        hash_table_add(Vehicles, plateVehicle, newMovement);
-        
-    free(plateVehicle);
-    free(namePark);
+    enter_vehicle(parksTotal, 
+                parksCounter, 
+                namePark, 
+                plateVehicle, 
+                entryDate, 
+                head, 
+                Vehicles);
 }
 
 /**
@@ -116,111 +121,107 @@ void command_e(Park *parksTotal,
  * @param head Head of the double linked list of Movements.
  * @param Vehicles HashTable of vehicle movement information.
  * @param billing BillingHashTable of billing information.
+ * @param inputLine The rest of the command line.
  */
-void command_s(Park *parksTotal, int *parksCounter, Movement **head, HashTable *Vehicles, BillingHashTable *billing){
+void command_s(Park *parksTotal, int *parksCounter, Movement **head, HashTable *Vehicles, BillingHashTable *billing, char *inputLine){
 
-    char inputLine[BUFFSIZ], *namePark, *plateVehicle, command = COMMAND_S;
+    char *namePark, *plateVehicle;
     char *currentPosition;
 
-    /// Read Input 
-    fgets(inputLine, sizeof(inputLine), stdin);
-
     currentPosition = inputLine;
     namePark = get_park_name(inputLine);
     plateVehicle = get_plate(inputLine);
     currentPosition += strlen(plateVehicle) + 1;
     Date *exitDate = get_date(currentPosition);
 
-    /// Register exit and add to vehicles hash table if successful 
-    Movement *entryMovement = find_entry_movement(*head, plateVehicle);
-    char *parkEntry = NULL;
-    if (entryMovement != NULL) {
-        parkEntry = entryMovement->parkName;
-    }
-    Movement *exitMovement = register_exit(parksTotal, parkEntry, namePark, plateVehicle, exitDate, command, parksCounter, head, Vehicles);
-    
-    free(exitDate);
-
-    if(exitMovement) {
-        process_exit(parksTotal, parksCounter, namePark, entryMovement, exitMovement, billing);
-
-        hash_table_add(Vehicles, plateVehicle, exitMovement); 
-    }
-    free(plateVehicle);
-    free(namePark);
+    /// Register exit, bill it and add to vehicles hash table if successful 
+    exit_vehicle(parksTotal, 
+                parksCounter, 
+                namePark, 
+                plateVehicle, 
+                exitDate, 
+                head, 
+                Vehicles, 
+                billing, 
+                NULL);
 }
 
 /**
  * @brief Handles the 'v' command, which prints the details of a vehicle's 
  * movements.
  *
+ * @param parksTotal Array of Park structures.
+ * @param ParksCounter Count of parks.
  * @param vehicles HashTable of vehicle movements information.
+ * @param inputLine The rest of the command line.
  */
-void command_v(HashTable *vehicles){
-    char inputLine[BUFFSIZ];
+void command_v(Park *parksTotal, 
+                int *ParksCounter, 
+                HashTable *vehicles, 
+                char *inputLine){
     char *plateVehicle;
 
-    /// Read Input 
-    fgets(inputLine, sizeof(inputLine), stdin);
     plateVehicle = get_plate(inputLine);
 
-    if (!handle_invalid_plate(plateVehicle)) {
-        free(plateVehicle);
+    if (!handle_invalid_plate(plateVehicle))
         return;
-    } 
+
+    /// Movements from before a restart join the table on first use
+    image_materialize_plate(vehicles, parksTotal, *ParksCounter, plateVehicle);
 
     /// Get vehicle movements from hash table
     Node *node = hash_table_get(vehicles, plateVehicle);
 
     /// Print movements for a vehicle if movements are found
     if (node == NULL) {
+        stats_error();
         printf("%s: %s%c", plateVehicle, ERROR_NO_ENTRIES_FOUND, NEW_LINE);
-        free(plateVehicle);
         return;
     }
 
     print_movement_details(node);
-
-    free(plateVehicle);
 }
 
 /**
  * @brief Handles the 'f' command, which shows the billing for a specific 
- * park and date.
+ * park and date, or its total between two dates.
  *
  * @param parksTotal Array of Park structures.
  * @param ParksCounter Count of parks.
+ * @param vehicles HashTable of vehicle movement information.
  * @param billing BillingHashTable of billing information.
  * @param head Head of the double linked list of Movements.
+ * @param inputLine The rest of the command line.
  */
 void command_f(Park *parksTotal, 
                 int *ParksCounter, 
+                HashTable *vehicles, 
                 BillingHashTable *billing, 
-                Movement **head){
-
-    char inputLine[BUFFSIZ];
-
-    /// Read input line
-    fgets(inputLine, sizeof(inputLine), stdin);
-
+                Movement **head, 
+                char *inputLine){
     char *namePark = get_park_name(inputLine);
     Park *park = find_park_by_name(parksTotal, *ParksCounter, namePark);
 
     /// If park not found, print error and return
     
-    if (park == NULL) {
-        free(namePark);
+    if (park == NULL)
         return;
-    }
+    image_materialize_park(vehicles, billing, park);
 
     /// Get date to bill and last movement date
-    Date *dateToBill = get_date_without_time(inputLine);
     Date dateToCheck = get_last_movement_date(*head);
+    Date from = DEFAULT_DATE, to = DEFAULT_DATE;
 
-    handle_billing(dateToBill, billing, namePark, dateToCheck);
+    /// Two dates ask for the revenue between them
+    if (sscanf(inputLine, "%d-%d-%d %d-%d-%d", 
+                &from.day, &from.month, &from.year, 
+                &to.day, &to.month, &to.year) == 6) {
+        show_billing_range(park, from, to, dateToCheck);
+        return;
+    }
 
-    free(dateToBill);
-    free(namePark);
+    Date *dateToBill = get_date_without_time(inputLine);
+    handle_billing(dateToBill, billing, park, dateToCheck);
 }
 
 /**
@@ -232,35 +233,390 @@ void command_f(Park *parksTotal,
  * @param head Head of the double linked list of Movements.
  * @param vehicles HashTable of vehicle movement information.
  * @param billing BillingHashTable of billing information.
+ * @param inputLine The rest of the command line.
  */
 void command_r(Park *parksTotal, 
                 int *ParksCounter, 
                 Movement **head, 
                 HashTable *vehicles, 
-                BillingHashTable *billing){
+                BillingHashTable *billing, 
+                char *inputLine){
 
-    char inputLine[BUFFSIZ], *namePark;
+    char *namePark;
 
-    /// Read input line
-    fgets(inputLine, sizeof(inputLine), stdin);
     namePark = get_park_name(inputLine);
     Park *park = find_park_by_name(parksTotal, *ParksCounter, namePark);
     
     /// If park not found, if not, remove all associated structures
-    if (park == NULL) {
-        free(namePark);
+    if (park == NULL)
         return;
-    }
 
     remove_structures(parksTotal, 
                     ParksCounter, 
                     namePark, 
                     head, 
                     vehicles,billing);
-    
-    free(namePark);
 }
 
+/**
+ * @brief Handles the 'h' command, which shows the hourly occupancy of a 
+ * park between two days.
+ *
+ * @param parksTotal Array of Park structures.
+ * @param ParksCounter Count of parks.
+ * @param head Head of the double linked list of Movements.
+ * @param vehicles HashTable of vehicle movement information.
+ * @param billing BillingHashTable of billing information.
+ * @param inputLine The rest of the command line.
+ */
+void command_h(Park *parksTotal, 
+                int *ParksCounter, 
+                Movement **head, 
+                HashTable *vehicles, 
+                BillingHashTable *billing, 
+                char *inputLine){
+
+    Date from = DEFAULT_DATE, to = DEFAULT_DATE;
+
+    char *namePark = get_park_name(inputLine);
+    if (namePark == NULL)
+        return;
+
+    Park *park = find_park_by_name(parksTotal, *ParksCounter, namePark);
+    if (park == NULL)
+        return;
+
+    /// Both days must be valid and in order
+    if (sscanf(inputLine, "%d-%d-%d %d-%d-%d", 
+                &from.day, &from.month, &from.year, 
+                &to.day, &to.month, &to.year) != 6 || 
+        !is_valid_date(&from) || !is_valid_date(&to) || 
+        !is_previous_date(from, to)) {
+        stats_error();
+        printf("%s%c", ERROR_INVALID_DATE, NEW_LINE);
+        return;
+    }
+
+    image_materialize_park(vehicles, billing, park);
+    show_occupancy(park->occupancy, from, to, get_last_movement_date(*head));
+}
+
+/**
+ * @brief Handles the 'b' command, which shows the daily revenue of every 
+ * park at once.
+ *
+ * @param parksTotal Array of Park structures.
+ * @param ParksCounter Count of parks.
+ * @param vehicles HashTable of vehicle movement information.
+ * @param billing BillingHashTable of billing information.
+ */
+void command_b(Park *parksTotal, 
+                int *ParksCounter, 
+                HashTable *vehicles, 
+                BillingHashTable *billing){
+    image_materialize_all(vehicles, billing, parksTotal, *ParksCounter);
+    show_revenue_report(billing->cube, parksTotal, *ParksCounter);
+}
+
+/**
+ * @brief Handles the 't' command, which shows the vehicles that spent the 
+ * most and stayed the longest.
+ *
+ * Input is the number of vehicles, optionally followed by a park name to 
+ * rank only the stays in that park.
+ *
+ * @param parksTotal Array of Park structures.
+ * @param ParksCounter Count of parks.
+ * @param vehicles HashTable of vehicle movement information.
+ * @param billing BillingHashTable of billing information.
+ * @param inputLine The rest of the command line.
+ */
+void command_t(Park *parksTotal, 
+                int *ParksCounter, 
+                HashTable *vehicles, 
+                BillingHashTable *billing, 
+                char *inputLine){
+
+    int n = 0, length = 0;
+
+    if (sscanf(inputLine, "%d%n", &n, &length) != 1 || n <= 0)
+        return;
+
+    /// A park name after the number ranks that park only
+    char *rest = inputLine + length;
+    if (rest[0] == ' ' && rest[1] != NEW_LINE && rest[1] != NULL_TERMINATOR) {
+        char *namePark = get_park_name(rest);
+        if (namePark == NULL)
+            return;
+
+        Park *park = find_park_by_name(parksTotal, *ParksCounter, namePark);
+        if (park != NULL) {
+            image_materialize_park(vehicles, billing, park);
+            show_top_vehicles(park->leaders, n);
+        }
+        return;
+    }
+
+    image_materialize_all(vehicles, billing, parksTotal, *ParksCounter);
+    show_top_vehicles(billing->ledger, n);
+}
+
+/**
+ * @brief Handles the 'l' command, which lists the vehicles currently inside 
+ * a park.
+ *
+ * @param parksTotal Array of Park structures.
+ * @param ParksCounter Count of parks.
+ * @param inputLine The rest of the command line.
+ */
+void command_l(Park *parksTotal, int *ParksCounter, char *inputLine){
+    char *namePark = get_park_name(inputLine);
+    if (namePark == NULL)
+        return;
+
+    Park *park = find_park_by_name(parksTotal, *ParksCounter, namePark);
+    if (park == NULL)
+        return;
+
+    stay_set_print(park->openStays);
+}
+
+/**
+ * @brief Handles the 'g' command, which finds the known plates that match 
+ * a partial plate and shows where they are.
+ *
+ * @param vehicles HashTable of vehicle movement information.
+ * @param inputLine The rest of the command line.
+ */
+void command_g(HashTable *vehicles, char *inputLine){
+    char *pattern = arena_alloc(scratch_arena(), strlen(inputLine) + 1);
+
+    if (pattern == NULL || 
+        sscanf(inputLine, "%s", pattern) != 1 || 
+        !is_valid_pattern(pattern)) {
+        stats_error();
+        printf("%s%c", ERROR_INVALID_PATTERN, NEW_LINE);
+        return;
+    }
+
+    image_materialize_plates(vehicles);
+    show_plate_search(vehicles->plates, pattern);
+}
+
+/**
+ * @brief Handles the 'd' command, which shows the median and tail of how 
+ * long vehicles stay in a park.
+ *
+ * Input is a park name, optionally followed by two days to only count the 
+ * stays that ended between them.
+ *
+ * @param parksTotal Array of Park structures.
+ * @param ParksCounter Count of parks.
+ * @param vehicles HashTable of vehicle movement information.
+ * @param billing BillingHashTable of billing information.
+ * @param inputLine The rest of the command line.
+ */
+void command_d(Park *parksTotal, 
+                int *ParksCounter, 
+                HashTable *vehicles, 
+                BillingHashTable *billing, 
+                char *inputLine){
+    Date from = DEFAULT_DATE, to = DEFAULT_DATE;
+    DwellSketch range;
+
+    char *namePark = get_park_name(inputLine);
+    if (namePark == NULL)
+        return;
+
+    Park *park = find_park_by_name(parksTotal, *ParksCounter, namePark);
+    if (park == NULL)
+        return;
+
+    image_materialize_park(vehicles, billing, park);
+    if (park->dwell == NULL)
+        return;
+
+    int read = sscanf(inputLine, "%d-%d-%d %d-%d-%d", 
+                        &from.day, &from.month, &from.year, 
+                        &to.day, &to.month, &to.year);
+    if (read <= 0) {
+        show_dwell(&park->dwell->total);
+        return;
+    }
+
+    /// Both days must be valid and in order
+    if (read != 6 || !is_valid_date(&from) || !is_valid_date(&to) || 
+        !is_previous_date(from, to)) {
+        stats_error();
+        printf("%s%c", ERROR_INVALID_DATE, NEW_LINE);
+        return;
+    }
+
+    dwell_range(park->dwell, from, to, &range);
+    show_dwell(&range);
+}
+
+/**
+ * @brief Handles the 'o' command, which sets the longest stay allowed 
+ * before an overstay alert.
+ *
+ * Input is the limit in minutes, 0 to disable the alerts. Without input, 
+ * prints the current limit.
+ *
+ * @param parksTotal Array of Park structures.
+ * @param ParksCounter Count of parks.
+ * @param vehicles HashTable of vehicle movement information.
+ * @param inputLine The rest of the command line.
+ */
+void command_o(Park *parksTotal, 
+                int *ParksCounter, 
+                HashTable *vehicles, 
+                char *inputLine){
+
+    long long limit = 0;
+
+    if (vehicles->overstays == NULL)
+        return;
+
+    int read = sscanf(inputLine, "%lld", &limit);
+    if (read <= 0) {
+        printf("%lld%c", vehicles->overstays->limit, NEW_LINE);
+        return;
+    }
+
+    if (limit < 0) {
+        stats_error();
+        printf("%s%c", ERROR_INVALID_LIMIT, NEW_LINE);
+        return;
+    }
+
+    overstay_set_limit(vehicles->overstays, limit, parksTotal, *ParksCounter);
+}
+
+/**
+ * @brief Handles the 'k' command, which shows the chain statistics of the 
+ * vehicles and billing hash tables.
+ *
+ * @param vehicles HashTable of vehicle movement information.
+ * @param billing BillingHashTable of billing information.
+ */
+void command_k(HashTable *vehicles, BillingHashTable *billing){
+    show_chain_stats(vehicles->chains, "vehicles");
+    show_chain_stats(billing->chains, "billing");
+}
+
+/**
+ * @brief Handles the 'm' command, which shows the memory held by each kind
+ * of allocation and the use of the scratch arena.
+ */
+void command_m(void){
+    show_memory();
+    show_arena(scratch_arena(), "scratch");
+}
+
+/**
+ * @brief Handles the 'x' command, which shows the runtime statistics.
+ *
+ * Input is empty, or the threshold in microseconds above which commands 
+ * are logged as slow.
+ *
+ * @param parksTotal Array of Park structures.
+ * @param ParksCounter Count of parks.
+ * @param head Head of the double linked list of Movements.
+ * @param vehicles HashTable of vehicle movement information.
+ * @param billing BillingHashTable of billing information.
+ * @param inputLine The rest of the command line.
+ */
+void command_x(Park *parksTotal, 
+                int *ParksCounter, 
+                Movement **head, 
+                HashTable *vehicles, 
+                BillingHashTable *billing, 
+                char *inputLine){
+
+    long long micros = 0;
+
+    int read = sscanf(inputLine, "%lld", &micros);
+    if (read <= 0) {
+        show_stats(parksTotal, *ParksCounter, *head, vehicles, billing);
+        return;
+    }
+
+    if (micros < 0) {
+        stats_error();
+        printf("%s%c", ERROR_INVALID_LIMIT, NEW_LINE);
+        return;
+    }
+
+    stats_set_slow_threshold(micros);
+}
+
+/**
+ * @brief Handles the 'w' command, which shows what the billed stays would 
+ * have paid under other tariffs.
+ *
+ * Input is a list of at most WHATIF_CANDIDATES_MAX X Y Z triples; a longer
+ * list is rejected. For each triple, in order, prints the revenue of every
+ * park by day and in total.
+ *
+ * @param parksTotal Array of Park structures.
+ * @param ParksCounter Count of parks.
+ * @param vehicles HashTable of vehicle movement information.
+ * @param billing BillingHashTable of billing information.
+ * @param inputLine The rest of the command line.
+ */
+void command_w(Park *parksTotal, 
+                int *ParksCounter, 
+                HashTable *vehicles, 
+                BillingHashTable *billing, 
+                char *inputLine){
+
+    char *position = inputLine;
+    Charging candidates[WHATIF_CANDIDATES_MAX];
+    double preValue, afterValue, maxValue;
+    int count = 0, consumed;
+
+    while (sscanf(position, "%lf %lf %lf%n", 
+                &preValue, &afterValue, &maxValue, &consumed) == 3) {
+
+        /// Answering for only part of the candidates would mislead
+        if (count == WHATIF_CANDIDATES_MAX) {
+            stats_error();
+            printf("%s%c", ERROR_TOO_MANY_TARIFFS, NEW_LINE);
+            return;
+        }
+
+        /// Checked as typed, before rounding, as the 'p' command does
+        if (is_invalid_cost(preValue, afterValue, maxValue)) {
+            stats_error();
+            printf("%s%c", ERROR_INVALID_COST, NEW_LINE);
+            return;
+        }
+
+        Charging charge = {money_to_cents(preValue), 
+                            money_to_cents(afterValue), 
+                            money_to_cents(maxValue)};
+        candidates[count++] = charge;
+        position += consumed;
+    }
+
+    if (count == 0)
+        return;
+
+    image_materialize_all(vehicles, billing, parksTotal, *ParksCounter);
+    StayHistory *history = stay_history_build(parksTotal, 
+                                            *ParksCounter, 
+                                            billing);
+    if (history == NULL)
+        return;
+
+    long long *revenue = simulate_tariffs(history, candidates, count);
+    if (revenue != NULL)
+        show_simulation(history, revenue, count);
+
+    simulation_free(history, revenue, count);
+    stay_history_free(history);
+}
 
 /**
  * @brief Reads commands from the input and calls the corresponding function.
@@ -274,63 +630,91 @@ void command_r(Park *parksTotal,
  */
 int read_commands(Park *parksTotal, int *ParksCounter, Movement **head, HashTable *vehicles, BillingHashTable *billing){
 
-    int c = getchar();
-    switch (c)
+    /// The line and everything parsed from it live in the scratch arena
+    Arena *scratch = scratch_arena();
+    char *line = arena_alloc(scratch, BUFFSIZ);
+    int more = 1;
+
+    /// The end of the input ends the program like 'q'
+    if (fgets(line, BUFFSIZ, stdin) == NULL)
+        line[0] = 'q';
+
+    /// Handlers get the line after the command letter
+    char *inputLine = line + 1;
+
+    stats_begin(line);
+    switch (line[0])
     {
     case 'q':
         command_q(parksTotal,ParksCounter, head, vehicles, billing);
-        return 0;
+        more = 0;
+        break;
     case 'p':
-        command_p(parksTotal,ParksCounter);
-        return 1;
+        command_p(parksTotal,ParksCounter, inputLine);
+        break;
         
     case 'e':
-        command_e(parksTotal, ParksCounter, head, vehicles);
-        return 1;
+        command_e(parksTotal, ParksCounter, head, vehicles, inputLine);
+        break;
         
     case 's':
-        command_s(parksTotal,ParksCounter,head, vehicles, billing);
-        return 1;
+        command_s(parksTotal,ParksCounter,head, vehicles, billing, inputLine);
+        break;
         
     case 'v':
-        command_v(vehicles);
-        return 1;
+        command_v(parksTotal, ParksCounter, vehicles, inputLine);
+        break;
         
     case 'f':
-        command_f(parksTotal, ParksCounter, billing, head);
-        return 1;
+        command_f(parksTotal, ParksCounter, vehicles, billing, head, inputLine);
+        break;
     case 'r':
-        command_r(parksTotal, ParksCounter, head, vehicles,billing);
-        return 1;
+        command_r(parksTotal, ParksCounter, head, vehicles,billing, inputLine);
+        break;
+    case 'w':
+        command_w(parksTotal, ParksCounter, vehicles, billing, inputLine);
+        break;
+    case 'h':
+        command_h(parksTotal, ParksCounter, head, vehicles, billing, inputLine);
+        break;
+    case 'b':
+        command_b(parksTotal, ParksCounter, vehicles, billing);
+        break;
+    case 't':
+        command_t(parksTotal, ParksCounter, vehicles, billing, inputLine);
+        break;
+    case 'l':
+        command_l(parksTotal, ParksCounter, inputLine);
+        break;
+    case 'g':
+        command_g(vehicles, inputLine);
+        break;
+    case 'd':
+        command_d(parksTotal, ParksCounter, vehicles, billing, inputLine);
+        break;
+    case 'o':
+        command_o(parksTotal, ParksCounter, vehicles, inputLine);
+        break;
+    case 'k':
+        command_k(vehicles, billing);
+        break;
+    case 'm':
+        command_m();
+        break;
+    case 'x':
+        command_x(parksTotal, ParksCounter, head, vehicles, billing, inputLine);
+        break;
          
     default:
         ///continue if another unknown command is read
-        return 1;
+        break;
     }
+    stats_end();
+    arena_reset(scratch);
+    return more;
 }
 
-/**
- * @brief Initializes program structures.
- *
- * @param parksTotal Pointer to Park array.
- * @param ParksCounter Pointer to park count.
- * @param head Pointer to Movement list head.
- * @param vehicles Pointer to vehicle HashTable.
- * @param billing Pointer to billing HashTable.
- */
-void initialize_program(Park **parksTotal, 
-                        int *ParksCounter, 
-                        Movement **head, 
-                        HashTable **vehicles, 
-                        BillingHashTable **billing){
-
-    *parksTotal = malloc(PARK_MAX * sizeof(Park));
-    *ParksCounter = 0;
-    *head = NULL;
-    *vehicles = hash_table_create(HASH_CAPACITY);
-    *billing = bill_hash_table_create(HASH_CAPACITY);
-}
-
+#ifndef PROJ1_NO_MAIN
 /**
  * @brief Entry point of the program.
  *
@@ -348,7 +732,14 @@ int main(){
 
     initialize_program(&parksTotal, &ParksCounter, &head, &vehicles, &billing);
 
+    /// Restart from the state saved by the last run, if any
+    const char *image = getenv(IMAGE_FILE_VARIABLE);
+    if (image != NULL)
+        vehicles->image = image_load(image, parksTotal, &ParksCounter, &head, 
+                                    vehicles);
+
     while (read_commands(parksTotal, &ParksCounter, &head, vehicles, billing)){
     }
     return 0;
 }
+#endif
@@ -0,0 +1,368 @@
+/**
+ * @file ranking.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Per-vehicle spend and dwell totals with their current leaders.
+ *
+ * Every billed exit adds to the totals of its vehicle, in its park and in
+ * the whole system, and moves the vehicle within bounded min-heaps of the
+ * leaders. Answering a query only sorts the heap, never the whole fleet.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "proj.h"
+#include "auxiliary.h"
+#include "plates.h"
+#include "ranking.h"
+#include "accounting.h"
+
+/**
+ * @brief Creates an empty ledger.
+ *
+ * @return Pointer to the new ledger, or NULL if memory allocation failed.
+ */
+VehicleLedger *ledger_create(void) {
+    VehicleLedger *ledger = mem_alloc(MEM_BILLING, sizeof(VehicleLedger));
+    if (ledger == NULL)
+        return NULL;
+
+    ledger->vehicles = mem_alloc(MEM_BILLING,
+                                LEDGER_INITIAL_SIZE * sizeof(VehicleTotals));
+    ledger->index = mem_alloc(MEM_BILLING,
+                            LEDGER_INITIAL_SIZE * 2 * sizeof(int));
+    ledger->count = 0;
+    ledger->capacity = LEDGER_INITIAL_SIZE;
+    ledger->indexSize = LEDGER_INITIAL_SIZE * 2;
+
+    if (ledger->index != NULL)
+        for (int i = 0; i < ledger->indexSize; i++)
+            ledger->index[i] = NO_ENTRY;
+
+    for (int kind = 0; kind < RANK_KINDS; kind++)
+        ledger->leaders[kind].size = 0;
+    return ledger;
+}
+
+/**
+ * @brief Frees a ledger.
+ *
+ * @param ledger The ledger to free, may be NULL.
+ */
+void ledger_free(VehicleLedger *ledger) {
+    if (ledger == NULL)
+        return;
+
+    mem_free(MEM_BILLING, ledger->vehicles,
+            ledger->capacity * sizeof(VehicleTotals));
+    mem_free(MEM_BILLING, ledger->index, ledger->indexSize * sizeof(int));
+    mem_free(MEM_BILLING, ledger, sizeof(VehicleLedger));
+}
+
+/**
+ * @brief Finds the index slot of a plate key, or the empty slot where it
+ * would go.
+ *
+ * @param ledger The ledger to search.
+ * @param key The plate key.
+ * @return The slot of the key in the index.
+ */
+static int find_slot(VehicleLedger *ledger, unsigned int key) {
+    int mask = ledger->indexSize - 1;
+    int slot = (int)((key * 2654435761u) & (unsigned int)mask);
+
+    while (ledger->index[slot] != NO_ENTRY &&
+            ledger->vehicles[ledger->index[slot]].key != key)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+/**
+ * @brief Doubles the index and the vehicles array of a full ledger.
+ *
+ * @param ledger The ledger to grow.
+ * @return 1 on success, 0 if memory allocation failed.
+ */
+static int grow_ledger(VehicleLedger *ledger) {
+    int capacity = ledger->capacity * 2;
+
+    /// The index is rebuilt anyway, so it is taken first and given back
+    /// if the vehicles cannot grow
+    int *index = mem_alloc(MEM_BILLING, capacity * 2 * sizeof(int));
+    if (index == NULL)
+        return 0;
+
+    VehicleTotals *vehicles = mem_realloc(MEM_BILLING, ledger->vehicles,
+                                ledger->capacity * sizeof(VehicleTotals),
+                                capacity * sizeof(VehicleTotals));
+    if (vehicles == NULL) {
+        mem_free(MEM_BILLING, index, capacity * 2 * sizeof(int));
+        return 0;
+    }
+    ledger->vehicles = vehicles;
+
+    mem_free(MEM_BILLING, ledger->index, ledger->indexSize * sizeof(int));
+    ledger->index = index;
+    ledger->indexSize = capacity * 2;
+    ledger->capacity = capacity;
+
+    for (int i = 0; i < ledger->indexSize; i++)
+        ledger->index[i] = NO_ENTRY;
+    for (int i = 0; i < ledger->count; i++)
+        ledger->index[find_slot(ledger, ledger->vehicles[i].key)] = i;
+    return 1;
+}
+
+/**
+ * @brief Checks whether a vehicle ranks below another one.
+ *
+ * Ties go to the smaller plate key, so the order is total.
+ *
+ * @param ledger The ledger of both vehicles.
+ * @param kind RANK_BY_SPEND or RANK_BY_DWELL.
+ * @param a Index of the first vehicle.
+ * @param b Index of the second vehicle.
+ * @return 1 if a ranks below b, 0 otherwise.
+ */
+static int ranks_below(VehicleLedger *ledger, int kind, int a, int b) {
+    VehicleTotals *first = &ledger->vehicles[a];
+    VehicleTotals *second = &ledger->vehicles[b];
+
+    if (first->totals[kind] != second->totals[kind])
+        return first->totals[kind] < second->totals[kind];
+    return first->key > second->key;
+}
+
+/**
+ * @brief Places a vehicle at a heap position and records it there.
+ *
+ * @param ledger The ledger of the heap.
+ * @param kind RANK_BY_SPEND or RANK_BY_DWELL.
+ * @param position The position in the heap.
+ * @param v The index of the vehicle.
+ */
+static void heap_place(VehicleLedger *ledger, int kind, int position, int v) {
+    ledger->leaders[kind].entries[position] = v;
+    ledger->vehicles[v].heapSlot[kind] = position;
+}
+
+/**
+ * @brief Moves the vehicle at a heap position down to where it belongs.
+ *
+ * @param ledger The ledger of the heap.
+ * @param kind RANK_BY_SPEND or RANK_BY_DWELL.
+ * @param position The position of the vehicle.
+ */
+static void sift_down(VehicleLedger *ledger, int kind, int position) {
+    TopHeap *heap = &ledger->leaders[kind];
+    int vehicle = heap->entries[position];
+
+    while (2 * position + 1 < heap->size) {
+        int child = 2 * position + 1;
+        if (child + 1 < heap->size &&
+            ranks_below(ledger, kind, heap->entries[child + 1],
+                        heap->entries[child]))
+            child++;
+        if (!ranks_below(ledger, kind, heap->entries[child], vehicle))
+            break;
+
+        heap_place(ledger, kind, position, heap->entries[child]);
+        position = child;
+    }
+    heap_place(ledger, kind, position, vehicle);
+}
+
+/**
+ * @brief Moves the vehicle at a heap position up to where it belongs.
+ *
+ * @param ledger The ledger of the heap.
+ * @param kind RANK_BY_SPEND or RANK_BY_DWELL.
+ * @param position The position of the vehicle.
+ */
+static void sift_up(VehicleLedger *ledger, int kind, int position) {
+    TopHeap *heap = &ledger->leaders[kind];
+    int vehicle = heap->entries[position];
+
+    while (position > 0) {
+        int parent = (position - 1) / 2;
+        if (!ranks_below(ledger, kind, vehicle, heap->entries[parent]))
+            break;
+
+        heap_place(ledger, kind, position, heap->entries[parent]);
+        position = parent;
+    }
+    heap_place(ledger, kind, position, vehicle);
+}
+
+/**
+ * @brief Updates the leaders after the totals of a vehicle grew.
+ *
+ * @param ledger The ledger of the vehicle.
+ * @param kind RANK_BY_SPEND or RANK_BY_DWELL.
+ * @param vehicle The index of the vehicle.
+ */
+static void promote(VehicleLedger *ledger, int kind, int vehicle) {
+    TopHeap *heap = &ledger->leaders[kind];
+    int position = ledger->vehicles[vehicle].heapSlot[kind];
+
+    if (position != NOT_IN_HEAP)
+        sift_down(ledger, kind, position);
+    else if (heap->size < TOP_CAPACITY) {
+        heap->entries[heap->size] = vehicle;
+        sift_up(ledger, kind, heap->size++);
+    }
+    else if (ranks_below(ledger, kind, heap->entries[0], vehicle)) {
+        ledger->vehicles[heap->entries[0]].heapSlot[kind] = NOT_IN_HEAP;
+        heap->entries[0] = vehicle;
+        sift_down(ledger, kind, 0);
+    }
+}
+
+/**
+ * @brief Adds a billed stay to the totals of a vehicle.
+ *
+ * @param ledger The ledger, may be NULL.
+ * @param key The plate key of the vehicle.
+ * @param spend The amount billed, in cents.
+ * @param dwell The minutes charged.
+ */
+void ledger_add(VehicleLedger *ledger,
+                unsigned int key,
+                long long spend,
+                long long dwell) {
+
+    if (ledger == NULL || ledger->vehicles == NULL || ledger->index == NULL ||
+        key == PLATE_KEY_NONE)
+        return;
+
+    int slot = find_slot(ledger, key);
+    if (ledger->index[slot] == NO_ENTRY) {
+        if (ledger->count == ledger->capacity) {
+            if (!grow_ledger(ledger))
+                return;
+            slot = find_slot(ledger, key);
+        }
+
+        VehicleTotals *vehicle = &ledger->vehicles[ledger->count];
+        vehicle->key = key;
+        for (int kind = 0; kind < RANK_KINDS; kind++) {
+            vehicle->totals[kind] = 0;
+            vehicle->heapSlot[kind] = NOT_IN_HEAP;
+        }
+        ledger->index[slot] = ledger->count++;
+    }
+
+    int vehicle = ledger->index[slot];
+    ledger->vehicles[vehicle].totals[RANK_BY_SPEND] += spend;
+    ledger->vehicles[vehicle].totals[RANK_BY_DWELL] += dwell;
+
+    for (int kind = 0; kind < RANK_KINDS; kind++)
+        promote(ledger, kind, vehicle);
+}
+
+/**
+ * @brief Takes the totals of a removed park out of the system ledger.
+ *
+ * Totals shrink, so the leaders are rebuilt from every vehicle. This only
+ * happens when a park is removed, which already walks its whole history.
+ *
+ * @param ledger The system ledger, may be NULL.
+ * @param part The ledger of the removed park, may be NULL.
+ */
+void ledger_subtract(VehicleLedger *ledger, VehicleLedger *part) {
+    if (ledger == NULL || part == NULL || ledger->index == NULL)
+        return;
+
+    for (int i = 0; i < part->count; i++) {
+        int slot = find_slot(ledger, part->vehicles[i].key);
+        if (ledger->index[slot] == NO_ENTRY)
+            continue;
+
+        VehicleTotals *vehicle = &ledger->vehicles[ledger->index[slot]];
+        for (int kind = 0; kind < RANK_KINDS; kind++)
+            vehicle->totals[kind] -= part->vehicles[i].totals[kind];
+    }
+
+    for (int kind = 0; kind < RANK_KINDS; kind++) {
+        ledger->leaders[kind].size = 0;
+        for (int i = 0; i < ledger->count; i++)
+            ledger->vehicles[i].heapSlot[kind] = NOT_IN_HEAP;
+        for (int i = 0; i < ledger->count; i++)
+            if (ledger->vehicles[i].totals[kind] > 0)
+                promote(ledger, kind, i);
+    }
+}
+
+/**
+ * @brief Lists the leaders of one kind, from first to last.
+ *
+ * @param ledger The ledger, may be NULL.
+ * @param kind RANK_BY_SPEND or RANK_BY_DWELL.
+ * @param n The number of leaders wanted.
+ * @param top Array of at least TOP_CAPACITY pointers to fill.
+ * @return The number of leaders listed, at most n and TOP_CAPACITY.
+ */
+int ledger_top(VehicleLedger *ledger, int kind, int n, VehicleTotals **top) {
+    if (ledger == NULL)
+        return 0;
+
+    TopHeap *heap = &ledger->leaders[kind];
+    int count = heap->size;
+
+    /// Heap sort of a copy: the minimum goes to the end on every step
+    int entries[TOP_CAPACITY];
+    for (int i = 0; i < count; i++)
+        entries[i] = heap->entries[i];
+
+    for (int size = count; size > 1; size--) {
+        int last = entries[size - 1], position = 0;
+        entries[size - 1] = entries[0];
+
+        while (2 * position + 1 < size - 1) {
+            int child = 2 * position + 1;
+            if (child + 1 < size - 1 &&
+                ranks_below(ledger, kind, entries[child + 1], entries[child]))
+                child++;
+            if (!ranks_below(ledger, kind, entries[child], last))
+                break;
+
+            entries[position] = entries[child];
+            position = child;
+        }
+        entries[position] = last;
+    }
+
+    if (n > count)
+        n = count;
+    for (int i = 0; i < n; i++)
+        top[i] = &ledger->vehicles[entries[i]];
+    return n;
+}
+
+/**
+ * @brief Prints the vehicles that spent the most and stayed the longest.
+ *
+ * Prints `spend <plate> <amount>` for each of the first n vehicles by spend
+ * and then `dwell <plate> <minutes>` for each of the first n by time parked.
+ *
+ * @param ledger The ledger of a park or of the whole system.
+ * @param n The number of vehicles of each ranking.
+ */
+void show_top_vehicles(VehicleLedger *ledger, int n) {
+    VehicleTotals *top[TOP_CAPACITY];
+    char plate[PLATE_LENGTH + 1];
+
+    int count = ledger_top(ledger, RANK_BY_SPEND, n, top);
+    for (int i = 0; i < count; i++) {
+        key_to_plate(top[i]->key, plate);
+        printf("spend %s ", plate);
+        print_money(top[i]->totals[RANK_BY_SPEND]);
+        printf("%c", NEW_LINE);
+    }
+
+    count = ledger_top(ledger, RANK_BY_DWELL, n, top);
+    for (int i = 0; i < count; i++) {
+        key_to_plate(top[i]->key, plate);
+        printf("dwell %s %lld%c", plate, top[i]->totals[RANK_BY_DWELL],
+                NEW_LINE);
+    }
+}
@@ -0,0 +1,73 @@
+/**
+ * @file ranking.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Per-vehicle spend and dwell totals with their current leaders.
+ */
+#ifndef RANKING_H
+#define RANKING_H
+
+#define TOP_CAPACITY 100
+#define LEDGER_INITIAL_SIZE 64
+#define RANK_BY_SPEND 0
+#define RANK_BY_DWELL 1
+#define RANK_KINDS 2
+#define NOT_IN_HEAP -1
+#define NO_ENTRY -1
+
+/**
+ * @brief Totals of one vehicle.
+ *
+ * @param key The plate key of the vehicle.
+ * @param totals The amount spent in cents and the minutes parked.
+ * @param heapSlot Position of the vehicle in each leaders heap, or
+ * NOT_IN_HEAP.
+ */
+typedef struct VehicleTotals {
+    unsigned int key;
+    long long totals[RANK_KINDS];
+    int heapSlot[RANK_KINDS];
+} VehicleTotals;
+
+/**
+ * @brief The TOP_CAPACITY largest totals of one kind, as a min-heap.
+ *
+ * Totals only grow, so a vehicle outside the heap can never be ahead of
+ * its smallest member and the heap always holds the exact leaders.
+ *
+ * @param entries Indices of the vehicles in the heap.
+ * @param size Number of vehicles in the heap.
+ */
+typedef struct TopHeap {
+    int entries[TOP_CAPACITY];
+    int size;
+} TopHeap;
+
+/**
+ * @brief Totals of every vehicle seen by a park or by the whole system.
+ *
+ * @param vehicles The totals, in order of first exit.
+ * @param count Number of vehicles.
+ * @param capacity Number of vehicles allocated.
+ * @param index Open addressing table from plate key to vehicle index.
+ * @param indexSize Number of slots of the index, a power of two.
+ * @param leaders The leaders by spend and by dwell time.
+ */
+typedef struct VehicleLedger {
+    VehicleTotals *vehicles;
+    int count;
+    int capacity;
+    int *index;
+    int indexSize;
+    TopHeap leaders[RANK_KINDS];
+} VehicleLedger;
+
+
+VehicleLedger *ledger_create(void);
+void ledger_free(VehicleLedger *ledger);
+void ledger_add(VehicleLedger *ledger, unsigned int key, long long spend, long long dwell);
+void ledger_subtract(VehicleLedger *ledger, VehicleLedger *part);
+int ledger_top(VehicleLedger *ledger, int kind, int n, VehicleTotals **top);
+void show_top_vehicles(VehicleLedger *ledger, int n);
+
+#endif
@@ -0,0 +1,393 @@
+/**
+ * @file search.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Prefix and wildcard search over every plate seen by the system.
+ *
+ * A pattern follows the "XX-XX-XX" layout, where '?' matches any single
+ * character and a final '*', or the end of a shorter pattern, matches the
+ * rest of the plate.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proj.h"
+#include "movements.h"
+#include "plates.h"
+#include "search.h"
+#include "accounting.h"
+
+/**
+ * @brief Numbers a plate character.
+ *
+ * @param c The character.
+ * @return 0-9 for digits, 10-35 for uppercase letters, -1 otherwise.
+ */
+static int symbol_of(char c) {
+    if (IS_DIGIT(c))
+        return c - '0';
+    if (IS_UPPERCASE_LETTER(c))
+        return 10 + (c - 'A');
+    return -1;
+}
+
+/**
+ * @brief Finds the bitmap of a symbol at a position.
+ *
+ * @param index The plate index.
+ * @param position The position, not counting separators.
+ * @param symbol The number of the symbol.
+ * @return The first word of the bitmap.
+ */
+static unsigned long long *bitmap(PlateIndex *index, int position, int symbol){
+    int words = index->capacity / BITS_PER_WORD;
+    return index->bits + ((long long)position * PLATE_SYMBOLS + symbol) * words;
+}
+
+/**
+ * @brief Finds the bitmap of the plates that still have movements.
+ *
+ * @param index The plate index.
+ * @return The first word of the bitmap.
+ */
+static unsigned long long *live_bitmap(PlateIndex *index) {
+    return bitmap(index, PLATE_POSITIONS, 0);
+}
+
+/**
+ * @brief Creates an empty plate index.
+ *
+ * @return Pointer to the new index, or NULL if memory allocation failed.
+ */
+PlateIndex *plate_index_create(void) {
+    PlateIndex *index = mem_alloc(MEM_VEHICLES, sizeof(PlateIndex));
+    if (index == NULL)
+        return NULL;
+
+    int words = SEARCH_INITIAL_PLATES / BITS_PER_WORD;
+    index->keys = mem_alloc(MEM_VEHICLES,
+                            SEARCH_INITIAL_PLATES * sizeof(unsigned int));
+    index->inside = mem_alloc(MEM_VEHICLES,
+                            SEARCH_INITIAL_PLATES * sizeof(Movement*));
+    index->slots = mem_alloc(MEM_VEHICLES,
+                            SEARCH_INITIAL_PLATES * 2 * sizeof(int));
+    index->bits = mem_calloc(MEM_VEHICLES, (size_t)SEARCH_ROWS * words,
+                            sizeof(unsigned long long));
+    index->count = 0;
+    index->capacity = SEARCH_INITIAL_PLATES;
+
+    if (index->slots != NULL)
+        for (int i = 0; i < SEARCH_INITIAL_PLATES * 2; i++)
+            index->slots[i] = SEARCH_NO_ID;
+    return index;
+}
+
+/**
+ * @brief Frees the arrays of a plate index.
+ *
+ * @param index The index.
+ */
+static void free_arrays(PlateIndex *index) {
+    int capacity = index->capacity, words = capacity / BITS_PER_WORD;
+
+    mem_free(MEM_VEHICLES, index->keys, capacity * sizeof(unsigned int));
+    mem_free(MEM_VEHICLES, index->inside, capacity * sizeof(Movement*));
+    mem_free(MEM_VEHICLES, index->slots, capacity * 2 * sizeof(int));
+    mem_free(MEM_VEHICLES, index->bits,
+            (size_t)SEARCH_ROWS * words * sizeof(unsigned long long));
+}
+
+/**
+ * @brief Frees a plate index.
+ *
+ * @param index The index to free, may be NULL.
+ */
+void plate_index_free(PlateIndex *index) {
+    if (index == NULL)
+        return;
+
+    free_arrays(index);
+    mem_free(MEM_VEHICLES, index, sizeof(PlateIndex));
+}
+
+/**
+ * @brief Finds the slot of a plate key, or the empty slot where it would go.
+ *
+ * @param index The plate index.
+ * @param key The plate key.
+ * @return The slot of the key.
+ */
+static int find_slot(PlateIndex *index, unsigned int key) {
+    int mask = index->capacity * 2 - 1;
+    int slot = (int)((key * 2654435761u) & (unsigned int)mask);
+
+    while (index->slots[slot] != SEARCH_NO_ID &&
+            index->keys[index->slots[slot]] != key)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+/**
+ * @brief Doubles the capacity of a full plate index.
+ *
+ * @param index The index to grow.
+ * @return 1 on success, 0 if memory allocation failed.
+ */
+static int grow_index(PlateIndex *index) {
+    int capacity = index->capacity * 2;
+    int words = index->capacity / BITS_PER_WORD;
+
+    /// Every array moves at once, so a failure leaves the index as it was
+    unsigned int *keys = mem_alloc(MEM_VEHICLES,
+                                capacity * sizeof(unsigned int));
+    Movement **inside = mem_alloc(MEM_VEHICLES, capacity * sizeof(Movement*));
+    int *slots = mem_alloc(MEM_VEHICLES, capacity * 2 * sizeof(int));
+    unsigned long long *bits = mem_calloc(MEM_VEHICLES,
+                                    (size_t)SEARCH_ROWS * words * 2,
+                                    sizeof(unsigned long long));
+    if (keys == NULL || inside == NULL || slots == NULL || bits == NULL) {
+        mem_free(MEM_VEHICLES, keys, capacity * sizeof(unsigned int));
+        mem_free(MEM_VEHICLES, inside, capacity * sizeof(Movement*));
+        mem_free(MEM_VEHICLES, slots, capacity * 2 * sizeof(int));
+        mem_free(MEM_VEHICLES, bits,
+                (size_t)SEARCH_ROWS * words * 2 * sizeof(unsigned long long));
+        return 0;
+    }
+
+    memcpy(keys, index->keys, index->count * sizeof(unsigned int));
+    memcpy(inside, index->inside, index->count * sizeof(Movement*));
+
+    /// Every bitmap keeps its words and gets as many new empty ones
+    for (int row = 0; row < SEARCH_ROWS; row++)
+        memcpy(bits + (long long)row * words * 2,
+                index->bits + (long long)row * words,
+                words * sizeof(unsigned long long));
+
+    free_arrays(index);
+    index->keys = keys;
+    index->inside = inside;
+    index->bits = bits;
+    index->slots = slots;
+    index->capacity = capacity;
+
+    for (int i = 0; i < capacity * 2; i++)
+        index->slots[i] = SEARCH_NO_ID;
+    for (int id = 0; id < index->count; id++)
+        index->slots[find_slot(index, index->keys[id])] = id;
+    return 1;
+}
+
+/**
+ * @brief Finds the identifier of a plate, adding it if it is new.
+ *
+ * @param index The plate index.
+ * @param plate The plate.
+ * @param add Whether to add the plate when it is not known.
+ * @return The identifier, or SEARCH_NO_ID.
+ */
+static int plate_id(PlateIndex *index, char *plate, int add) {
+    unsigned int key = plate_to_key(plate);
+    if (key == PLATE_KEY_NONE)
+        return SEARCH_NO_ID;
+
+    int slot = find_slot(index, key);
+    if (index->slots[slot] != SEARCH_NO_ID || !add)
+        return index->slots[slot];
+
+    if (index->count == index->capacity) {
+        if (!grow_index(index))
+            return SEARCH_NO_ID;
+        slot = find_slot(index, key);
+    }
+
+    int id = index->count++;
+    index->keys[id] = key;
+    index->inside[id] = NULL;
+    index->slots[slot] = id;
+
+    for (int i = 0, position = 0; i < PLATE_LENGTH; i++) {
+        if (plate[i] == PLATE_SEPARATOR)
+            continue;
+
+        int symbol = symbol_of(plate[i]);
+        unsigned long long *row = bitmap(index, position++, symbol);
+        row[id / BITS_PER_WORD] |= 1ULL << (id % BITS_PER_WORD);
+    }
+    return id;
+}
+
+/**
+ * @brief Records that a vehicle entered a park.
+ *
+ * @param index The plate index, may be NULL.
+ * @param plate The plate of the vehicle.
+ * @param entry The entry movement.
+ */
+void plate_index_enter(PlateIndex *index, char *plate, Movement *entry) {
+    if (index == NULL || index->bits == NULL || index->slots == NULL)
+        return;
+
+    int id = plate_id(index, plate, 1);
+    if (id == SEARCH_NO_ID)
+        return;
+
+    index->inside[id] = entry;
+    live_bitmap(index)[id / BITS_PER_WORD] |= 1ULL << (id % BITS_PER_WORD);
+}
+
+/**
+ * @brief Records that a vehicle left its park.
+ *
+ * @param index The plate index, may be NULL.
+ * @param plate The plate of the vehicle.
+ */
+void plate_index_leave(PlateIndex *index, char *plate) {
+    if (index == NULL || index->bits == NULL || index->slots == NULL)
+        return;
+
+    int id = plate_id(index, plate, 0);
+    if (id != SEARCH_NO_ID)
+        index->inside[id] = NULL;
+}
+
+/**
+ * @brief Records that the last movement of a plate was removed, so
+ * searches no longer find it.
+ *
+ * @param index The plate index, may be NULL.
+ * @param plate The plate.
+ */
+void plate_index_forget(PlateIndex *index, char *plate) {
+    if (index == NULL || index->bits == NULL || index->slots == NULL)
+        return;
+
+    int id = plate_id(index, plate, 0);
+    if (id == SEARCH_NO_ID)
+        return;
+
+    index->inside[id] = NULL;
+    live_bitmap(index)[id / BITS_PER_WORD] &= ~(1ULL << (id % BITS_PER_WORD));
+}
+
+/**
+ * @brief Tells whether a plate ever entered a park, even if it has no
+ * movements left.
+ *
+ * @param index The plate index, may be NULL.
+ * @param plate The plate.
+ * @return 1 if the index knows the plate, 0 otherwise.
+ */
+int plate_index_knows(PlateIndex *index, char *plate) {
+    if (index == NULL || index->bits == NULL || index->slots == NULL)
+        return 0;
+    return plate_id(index, plate, 0) != SEARCH_NO_ID;
+}
+
+/**
+ * @brief Checks whether a search pattern is valid.
+ *
+ * @param pattern The pattern.
+ * @return 1 if the pattern is valid, 0 otherwise.
+ */
+int is_valid_pattern(char *pattern) {
+    int length = strlen(pattern);
+
+    if (length == 0 || length > PLATE_LENGTH)
+        return 0;
+
+    for (int i = 0; i < length; i++) {
+        char c = pattern[i];
+
+        if (c == SEARCH_ANY_REST) {
+            if (i != length - 1)
+                return 0;
+        }
+        else if (i % 3 == 2) {
+            if (c != PLATE_SEPARATOR && c != SEARCH_ANY_CHAR)
+                return 0;
+        }
+        else if (c != SEARCH_ANY_CHAR && symbol_of(c) < 0)
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Finds every plate with movements that matches a pattern.
+ *
+ * @param index The plate index.
+ * @param pattern A valid pattern.
+ * @param ids Array of at least count identifiers to fill.
+ * @return The number of matching plates, in the order they were first seen.
+ */
+int plate_index_search(PlateIndex *index, char *pattern, int *ids) {
+    unsigned long long *rows[PLATE_POSITIONS];
+    int fixed = 0, found = 0;
+    int words = (index->count + BITS_PER_WORD - 1) / BITS_PER_WORD;
+
+    for (int i = 0, position = 0; pattern[i] != NULL_TERMINATOR &&
+                                    pattern[i] != SEARCH_ANY_REST; i++) {
+        if (i % 3 == 2)
+            continue;
+        if (pattern[i] != SEARCH_ANY_CHAR)
+            rows[fixed++] = bitmap(index, position, symbol_of(pattern[i]));
+        position++;
+    }
+
+    /// Plates without movements, and the bits past the last plate, are off
+    unsigned long long *live = live_bitmap(index);
+    for (int w = 0; w < words; w++) {
+        unsigned long long match = live[w];
+        for (int r = 0; r < fixed && match; r++)
+            match &= rows[r][w];
+
+        while (match) {
+            ids[found++] = w * BITS_PER_WORD + __builtin_ctzll(match);
+            match &= match - 1;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Prints every plate with movements that matches a pattern and its
+ * state.
+ *
+ * Prints `<plate> <park> <date> <time>` for a vehicle that is inside a park,
+ * with the time it entered, and `<plate> out` for any other one.
+ *
+ * @param index The plate index, may be NULL.
+ * @param pattern A valid pattern.
+ */
+void show_plate_search(PlateIndex *index, char *pattern) {
+    char plate[PLATE_LENGTH + 1];
+
+    if (index == NULL || index->count == 0)
+        return;
+
+    int *ids = mem_alloc(MEM_BUFFERS, index->count * sizeof(int));
+    if (ids == NULL)
+        return;
+
+    int found = plate_index_search(index, pattern, ids);
+    for (int i = 0; i < found; i++) {
+        Movement *entry = index->inside[ids[i]];
+        key_to_plate(index->keys[ids[i]], plate);
+
+        if (entry == NULL) {
+            printf("%s out%c", plate, NEW_LINE);
+            continue;
+        }
+
+        printf("%s %s %02d-%02d-%04d %02d:%02d%c",
+            plate,
+            entry->parkName,
+            entry->date.day,
+            entry->date.month,
+            entry->date.year,
+            entry->date.time.hour,
+            entry->date.time.minute,
+            NEW_LINE);
+    }
+    mem_free(MEM_BUFFERS, ids, index->count * sizeof(int));
+}
@@ -0,0 +1,60 @@
+/**
+ * @file search.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Prefix and wildcard search over every plate seen by the system.
+ */
+#ifndef SEARCH_H
+#define SEARCH_H
+
+/// Characters of a plate that are not separators
+#define PLATE_POSITIONS 6
+/// Digits then uppercase letters
+#define PLATE_SYMBOLS 36
+#define SEARCH_INITIAL_PLATES 1024
+#define SEARCH_ANY_CHAR '?'
+#define SEARCH_ANY_REST '*'
+#define BITS_PER_WORD 64
+#define SEARCH_NO_ID -1
+/// The bitmaps of every position and symbol, then the one of live plates
+#define SEARCH_ROWS (PLATE_POSITIONS * PLATE_SYMBOLS + 1)
+
+/**
+ * @brief Per-position bitmap index of the known plates.
+ *
+ * Each plate gets a dense identifier the first time it enters a park. For
+ * every position and symbol, a bitmap has the bit of each plate with that
+ * symbol there, so a pattern is matched by ANDing one bitmap per fixed
+ * position, 64 plates per word. A last bitmap has the plates that still
+ * have movements; a plate whose last movement is removed keeps its
+ * identifier, so it is found in the same place if it comes back.
+ *
+ * @param keys The plate key of each identifier.
+ * @param inside The open entry of each plate, or NULL when it is outside.
+ * @param count Number of plates.
+ * @param capacity Number of plates allocated, a multiple of BITS_PER_WORD.
+ * @param slots Open addressing table from plate key to identifier.
+ * @param bits The bitmaps, by position, then symbol, then word, and the
+ * bitmap of live plates.
+ */
+typedef struct PlateIndex {
+    unsigned int *keys;
+    Movement **inside;
+    int count;
+    int capacity;
+    int *slots;
+    unsigned long long *bits;
+} PlateIndex;
+
+
+PlateIndex *plate_index_create(void);
+void plate_index_free(PlateIndex *index);
+void plate_index_enter(PlateIndex *index, char *plate, Movement *entry);
+void plate_index_leave(PlateIndex *index, char *plate);
+void plate_index_forget(PlateIndex *index, char *plate);
+int plate_index_knows(PlateIndex *index, char *plate);
+int is_valid_pattern(char *pattern);
+int plate_index_search(PlateIndex *index, char *pattern, int *ids);
+void show_plate_search(PlateIndex *index, char *pattern);
+
+#endif
@@ -0,0 +1,207 @@
+/**
+ * @file stats.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Runtime statistics of the commands read by the program.
+ *
+ * Recording a command costs two clock reads, a short copy of its line and
+ * a few counter updates. Structure sizes are only counted when the
+ * statistics are shown.
+ */
+/// clock_gettime and CLOCK_MONOTONIC are POSIX, not C99
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "proj.h"
+#include "movements.h"
+#include "search.h"
+#include "bloom.h"
+#include "stats.h"
+
+/// Counters of the whole run, shown by 'x'. reject() adds to them from the
+/// checks shared with the engine and the gates, which get no handle to pass
+static RuntimeStats stats = {
+    .slowNanos = STATS_DEFAULT_SLOW_MICROS * NANOS_PER_MICRO
+};
+
+/**
+ * @brief Reads the monotonic clock.
+ *
+ * @return The time, in nanoseconds.
+ */
+long long stats_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NANOS_PER_SECOND + now.tv_nsec;
+}
+
+/**
+ * @brief Marks the start of a command.
+ *
+ * @param line The whole command line, before any handler changes it.
+ */
+void stats_begin(char *line) {
+    strncpy(stats.line, line, STATS_LINE_MAX - 1);
+    stats.line[STATS_LINE_MAX - 1] = NULL_TERMINATOR;
+    stats.failed = 0;
+    stats.start = stats_clock();
+}
+
+/**
+ * @brief Records the command started by stats_begin.
+ */
+void stats_end(void) {
+    long long nanos = stats_clock() - stats.start;
+    char letter = stats.line[0];
+
+    if (letter < 'a' || letter > 'z')
+        return;
+
+    CommandStats *command = &stats.commands[letter - 'a'];
+    int bucket = nanos > 0 ?
+                64 - __builtin_clzll((unsigned long long)nanos) : 0;
+    if (bucket >= STATS_BUCKETS)
+        bucket = STATS_BUCKETS - 1;
+
+    command->count++;
+    command->errors += stats.failed;
+    command->totalNanos += nanos;
+    command->histogram[bucket]++;
+    if (nanos > command->maxNanos)
+        command->maxNanos = nanos;
+
+    if (nanos >= stats.slowNanos) {
+        SlowCommand *slow = &stats.slow[stats.slowCount++ % STATS_SLOW_LOG];
+        slow->nanos = nanos;
+        strcpy(slow->line, stats.line);
+    }
+}
+
+/**
+ * @brief Notes that the command being run printed an error.
+ */
+void stats_error(void) {
+    stats.failed = 1;
+}
+
+/**
+ * @brief Changes the threshold above which commands are logged as slow.
+ *
+ * @param micros The threshold, in microseconds.
+ */
+void stats_set_slow_threshold(long long micros) {
+    stats.slowNanos = micros * NANOS_PER_MICRO;
+}
+
+/**
+ * @brief Prints the counters of every command letter that was used.
+ *
+ * Prints `<letter> <count> <errors> <mean_us> <max_us>` followed by
+ * `<bound_ns>:<count>` for each non empty histogram bucket.
+ */
+static void show_commands(void) {
+    for (int letter = 0; letter < STATS_COMMANDS; letter++) {
+        CommandStats *command = &stats.commands[letter];
+        if (command->count == 0)
+            continue;
+
+        printf("%c %lld %lld %.2f %.2f",
+            'a' + letter,
+            command->count,
+            command->errors,
+            (double)command->totalNanos / command->count / NANOS_PER_MICRO,
+            (double)command->maxNanos / NANOS_PER_MICRO);
+
+        for (int bucket = 0; bucket < STATS_BUCKETS; bucket++)
+            if (command->histogram[bucket] > 0)
+                printf(" %lld:%lld", 1LL << bucket, command->histogram[bucket]);
+        printf("%c", NEW_LINE);
+    }
+}
+
+/**
+ * @brief Prints the sizes of the main structures.
+ *
+ * Prints `movements <count>`, `vehicles <plates> <records>`, where plates
+ * only counts the ones that still have movements, and then
+ * `park <name> <billed exits> <vehicles inside>` for each park.
+ *
+ * @param parksTotal Pointer to the array of parks.
+ * @param parksCounter The total number of parks.
+ * @param head Pointer to the head of the movement list.
+ * @param vehicles Pointer to the hash table of vehicles.
+ * @param billing Pointer to the billing hash table.
+ */
+static void show_sizes(Park *parksTotal,
+                        int parksCounter,
+                        Movement *head,
+                        HashTable *vehicles,
+                        BillingHashTable *billing) {
+
+    long long movements = 0, records = 0;
+
+    for (Movement *movement = head; movement; movement = movement->next)
+        movements++;
+
+    for (int i = 0; i < vehicles->size; i++)
+        for (Node *node = vehicles->buckets[i]; node; node = node->next)
+            records++;
+
+    printf("movements %lld%c", movements, NEW_LINE);
+    printf("vehicles %d %lld%c", vehicles->keys, records, NEW_LINE);
+
+    for (int p = 0; p < parksCounter; p++) {
+        long long billed = 0;
+
+        for (int i = 0; i < billing->size; i++)
+            for (BillingNode *node = billing->buckets[i]; node;
+                    node = node->next)
+                if (strcmp(node->key, parksTotal[p].parkName) == 0)
+                    billed++;
+
+        printf("park %s %lld %d%c",
+            parksTotal[p].parkName,
+            billed,
+            parksTotal[p].capacity - parksTotal[p].available,
+            NEW_LINE);
+    }
+}
+
+/**
+ * @brief Prints the runtime statistics.
+ *
+ * Prints the counters of every command letter, the sizes of the main
+ * structures, the state of the filter of plates, and `slow <us> <line>`
+ * for the latest slow commands, oldest first.
+ *
+ * @param parksTotal Pointer to the array of parks.
+ * @param parksCounter The total number of parks.
+ * @param head Pointer to the head of the movement list.
+ * @param vehicles Pointer to the hash table of vehicles.
+ * @param billing Pointer to the billing hash table.
+ */
+void show_stats(Park *parksTotal,
+                int parksCounter,
+                Movement *head,
+                HashTable *vehicles,
+                BillingHashTable *billing) {
+
+    show_commands();
+    show_sizes(parksTotal, parksCounter, head, vehicles, billing);
+    show_plate_filter(vehicles->seen);
+
+    long long first = stats.slowCount > STATS_SLOW_LOG ?
+                        stats.slowCount - STATS_SLOW_LOG : 0;
+
+    for (long long i = first; i < stats.slowCount; i++) {
+        SlowCommand *slow = &stats.slow[i % STATS_SLOW_LOG];
+        int length = strlen(slow->line);
+
+        /// The line keeps its newline unless it was truncated
+        printf("slow %.2f %s",
+            (double)slow->nanos / NANOS_PER_MICRO, slow->line);
+        if (length == 0 || slow->line[length - 1] != NEW_LINE)
+            printf("%c", NEW_LINE);
+    }
+}
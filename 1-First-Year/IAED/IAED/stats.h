@@ -0,0 +1,76 @@
+/**
+ * @file stats.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Runtime statistics of the commands read by the program.
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#define STATS_COMMANDS 26
+/// Bucket b counts commands that took less than 2^b nanoseconds
+#define STATS_BUCKETS 40
+#define STATS_SLOW_LOG 16
+#define STATS_LINE_MAX 128
+#define STATS_DEFAULT_SLOW_MICROS 10000
+#define NANOS_PER_SECOND 1000000000LL
+#define NANOS_PER_MICRO 1000LL
+
+/**
+ * @brief Counters of one command letter.
+ *
+ * @param count Number of commands run.
+ * @param errors Number of commands that printed at least one error.
+ * @param totalNanos Time spent in the commands.
+ * @param maxNanos Longest command.
+ * @param histogram Commands by power of two of their duration.
+ */
+typedef struct CommandStats {
+    long long count;
+    long long errors;
+    long long totalNanos;
+    long long maxNanos;
+    long long histogram[STATS_BUCKETS];
+} CommandStats;
+
+/**
+ * @brief A command that took longer than the slow threshold.
+ *
+ * @param nanos Time the command took.
+ * @param line The command line as it was read, possibly truncated.
+ */
+typedef struct SlowCommand {
+    long long nanos;
+    char line[STATS_LINE_MAX];
+} SlowCommand;
+
+/**
+ * @brief Statistics of every command since the program started.
+ *
+ * @param commands Counters by command letter.
+ * @param slow The latest slow commands, as a ring.
+ * @param slowCount Number of slow commands seen.
+ * @param slowNanos The slow threshold.
+ * @param line The command being run.
+ * @param start When the command being run started.
+ * @param failed Whether the command being run printed an error.
+ */
+typedef struct RuntimeStats {
+    CommandStats commands[STATS_COMMANDS];
+    SlowCommand slow[STATS_SLOW_LOG];
+    long long slowCount;
+    long long slowNanos;
+    char line[STATS_LINE_MAX];
+    long long start;
+    int failed;
+} RuntimeStats;
+
+
+long long stats_clock(void);
+void stats_begin(char *line);
+void stats_end(void);
+void stats_error(void);
+void stats_set_slow_threshold(long long micros);
+void show_stats(Park *parksTotal, int parksCounter, Movement *head, HashTable *vehicles, BillingHashTable *billing);
+
+#endif
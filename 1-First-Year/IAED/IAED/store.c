@@ -0,0 +1,279 @@
+/**
+ * @file store.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Columnar copy of the movement list for the scans over it.
+ *
+ * Rows are appended with their movements and keep list order, so a
+ * movement's row is its position in the list. Removing a park compacts
+ * every column in a single pass and renumbers the rows that moved.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proj.h"
+#include "movements.h"
+#include "calendar.h"
+#include "plates.h"
+#include "accounting.h"
+#include "store.h"
+
+/**
+ * @brief Creates an empty movement store.
+ *
+ * @return Pointer to the new store, or NULL if memory allocation failed.
+ */
+MovementStore *movement_store_create(void) {
+    MovementStore *store = mem_alloc(MEM_MOVEMENTS, sizeof(MovementStore));
+    if (store == NULL)
+        return NULL;
+
+    memset(store, 0, sizeof(MovementStore));
+    return store;
+}
+
+/**
+ * @brief Frees a movement store, but not the movements.
+ *
+ * @param store The store to free, may be NULL.
+ */
+void movement_store_free(MovementStore *store) {
+    if (store == NULL)
+        return;
+
+    mem_free(MEM_MOVEMENTS, store->parkIds, store->capacity * sizeof(int));
+    mem_free(MEM_MOVEMENTS, store->plateKeys,
+            store->capacity * sizeof(unsigned int));
+    mem_free(MEM_MOVEMENTS, store->stamps,
+            store->capacity * sizeof(long long));
+    mem_free(MEM_MOVEMENTS, store->rows,
+            store->capacity * sizeof(Movement *));
+    mem_free(MEM_MOVEMENTS, store, sizeof(MovementStore));
+}
+
+/**
+ * @brief Doubles the rows of a store.
+ *
+ * @param store The store.
+ *
+ * @return 1 on success, 0 if memory allocation failed.
+ */
+static int grow(MovementStore *store) {
+    unsigned int old = store->capacity;
+    unsigned int capacity = old ? old * 2 : STORE_INITIAL_CAPACITY;
+
+    /// Every column moves at once, so a failure leaves the store as it was
+    int *parkIds = mem_alloc(MEM_MOVEMENTS, capacity * sizeof(int));
+    unsigned int *plateKeys = mem_alloc(MEM_MOVEMENTS,
+                        capacity * sizeof(unsigned int));
+    long long *stamps = mem_alloc(MEM_MOVEMENTS, capacity * sizeof(long long));
+    Movement **rows = mem_alloc(MEM_MOVEMENTS, capacity * sizeof(Movement *));
+    if (parkIds == NULL || plateKeys == NULL || stamps == NULL ||
+        rows == NULL) {
+        mem_free(MEM_MOVEMENTS, parkIds, capacity * sizeof(int));
+        mem_free(MEM_MOVEMENTS, plateKeys, capacity * sizeof(unsigned int));
+        mem_free(MEM_MOVEMENTS, stamps, capacity * sizeof(long long));
+        mem_free(MEM_MOVEMENTS, rows, capacity * sizeof(Movement *));
+        return 0;
+    }
+
+    if (old > 0) {
+        memcpy(parkIds, store->parkIds, old * sizeof(int));
+        memcpy(plateKeys, store->plateKeys, old * sizeof(unsigned int));
+        memcpy(stamps, store->stamps, old * sizeof(long long));
+        memcpy(rows, store->rows, old * sizeof(Movement *));
+    }
+    mem_free(MEM_MOVEMENTS, store->parkIds, old * sizeof(int));
+    mem_free(MEM_MOVEMENTS, store->plateKeys, old * sizeof(unsigned int));
+    mem_free(MEM_MOVEMENTS, store->stamps, old * sizeof(long long));
+    mem_free(MEM_MOVEMENTS, store->rows, old * sizeof(Movement *));
+
+    store->parkIds = parkIds;
+    store->plateKeys = plateKeys;
+    store->stamps = stamps;
+    store->rows = rows;
+    store->capacity = capacity;
+    return 1;
+}
+
+/**
+ * @brief Makes room for more rows.
+ *
+ * A movement is only added to the list once its row is reserved, so the
+ * store never falls behind the list.
+ *
+ * @param store The store, may be NULL.
+ * @param rows The number of rows to make room for.
+ * @return 1 if there is room for the rows, 0 if they could not be allocated.
+ */
+int movement_store_reserve(MovementStore *store, unsigned int rows) {
+    while (store != NULL && store->capacity - store->count < rows)
+        if (!grow(store))
+            return 0;
+    return 1;
+}
+
+/**
+ * @brief Adds the movement just appended to the list.
+ *
+ * @param store The store, may be NULL.
+ * @param movement The movement.
+ * @param parkId Id of the park of the movement.
+ * @return 1 if the row was added, 0 if there was no memory for it.
+ */
+int movement_store_append(MovementStore *store,
+                            Movement *movement,
+                            int parkId) {
+
+    if (store == NULL)
+        return 1;
+
+    if (!movement_store_reserve(store, 1))
+        return 0;
+
+    unsigned int row = store->count++;
+    store->parkIds[row] = parkId;
+    store->plateKeys[row] = plate_to_key(movement->plate);
+    store->stamps[row] = minute_number(movement->date) << 1 |
+                        (movement->command == COMMAND_S ? STORE_EXIT_BIT : 0);
+    store->rows[row] = movement;
+    movement->row = row;
+    return 1;
+}
+
+/**
+ * @brief Returns the last movement of the list.
+ *
+ * @param store The store, or NULL to walk the list.
+ * @param head Head of the list of movements.
+ *
+ * @return The last movement, or NULL if there are none.
+ */
+Movement *movement_store_last(MovementStore *store, Movement *head) {
+    if (store == NULL)
+        return get_tail(head);
+    return store->count > 0 ? store->rows[store->count - 1] : NULL;
+}
+
+/**
+ * @brief Checks whether a row holds a plate.
+ *
+ * Plates outside the "XX-XX-XX" layout have no key, so they are compared
+ * as strings.
+ *
+ * @param store The store.
+ * @param row The row.
+ * @param key The key of the plate.
+ * @param plate The plate.
+ */
+static int row_has_plate(MovementStore *store,
+                        unsigned int row,
+                        unsigned int key,
+                        char *plate) {
+
+    if (store->plateKeys[row] != key)
+        return 0;
+    return key != PLATE_KEY_NONE || strcmp(store->rows[row]->plate, plate) == 0;
+}
+
+/**
+ * @brief Finds the last entry of a plate, newest rows first.
+ *
+ * @param store The store, or NULL to walk the list.
+ * @param head Head of the list of movements.
+ * @param plate The plate.
+ *
+ * @return The entry, or NULL if the plate never entered.
+ */
+Movement *movement_store_find_entry(MovementStore *store,
+                                    Movement *head,
+                                    char *plate) {
+
+    if (store == NULL)
+        return find_entry_movement(head, plate);
+
+    unsigned int key = plate_to_key(plate);
+
+    for (unsigned int row = store->count; row-- > 0; )
+        if (!(store->stamps[row] & STORE_EXIT_BIT) &&
+            row_has_plate(store, row, key, plate))
+            return store->rows[row];
+    return NULL;
+}
+
+/**
+ * @brief Returns the command of the last movement of a plate.
+ *
+ * @param store The store.
+ * @param from A movement of the plate; the scan stops there.
+ * @param plate The plate.
+ *
+ * @return COMMAND_E or COMMAND_S.
+ */
+char movement_store_last_command(MovementStore *store,
+                                Movement *from,
+                                char *plate) {
+
+    unsigned int key = plate_to_key(plate);
+
+    /// A restored movement is older than every row: a vehicle with no row
+    /// left the park, as its open entries are all in the store
+    if (from->row == STORE_ROW_NONE) {
+        for (unsigned int row = store->count; row-- > 0; )
+            if (row_has_plate(store, row, key, plate))
+                return store->stamps[row] & STORE_EXIT_BIT ? 
+                        COMMAND_S : COMMAND_E;
+        return COMMAND_S;
+    }
+
+    for (unsigned int row = store->count - 1; row > from->row; row--)
+        if (row_has_plate(store, row, key, plate))
+            return store->stamps[row] & STORE_EXIT_BIT ? COMMAND_S : COMMAND_E;
+    return from->command;
+}
+
+/**
+ * @brief Frees every movement of a park, compacting the columns as it goes.
+ *
+ * @param store The store, or NULL to walk the list.
+ * @param head Pointer to the head of the list of movements.
+ * @param parkName Name of the park.
+ * @param parkId Id of the park.
+ */
+void movement_store_remove_park(MovementStore *store,
+                                Movement **head,
+                                char *parkName,
+                                int parkId) {
+
+    if (store == NULL) {
+        remove_movements(head, parkName);
+        return;
+    }
+
+    unsigned int kept = 0;
+
+    for (unsigned int row = 0; row < store->count; row++) {
+        Movement *movement = store->rows[row];
+
+        if (store->parkIds[row] != parkId) {
+            store->parkIds[kept] = store->parkIds[row];
+            store->plateKeys[kept] = store->plateKeys[row];
+            store->stamps[kept] = store->stamps[row];
+            store->rows[kept] = movement;
+            movement->row = kept++;
+            continue;
+        }
+
+        if (movement->prev != NULL)
+            movement->prev->next = movement->next;
+        else
+            *head = movement->next;
+        if (movement->next != NULL)
+            movement->next->prev = movement->prev;
+
+        mem_free_string(MEM_MOVEMENTS, movement->plate);
+        mem_free_string(MEM_MOVEMENTS, movement->parkName);
+        mem_free(MEM_MOVEMENTS, movement, sizeof(Movement));
+    }
+    store->count = kept;
+}
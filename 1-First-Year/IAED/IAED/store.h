@@ -0,0 +1,51 @@
+/**
+ * @file store.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Columnar copy of the movement list for the scans over it.
+ */
+#ifndef STORE_H
+#define STORE_H
+
+#define STORE_INITIAL_CAPACITY 1024
+/// Low bit of a stamp, set for exits
+#define STORE_EXIT_BIT 1
+/// Row of a movement restored from a state image, older than every row
+#define STORE_ROW_NONE 0xFFFFFFFFu
+
+/**
+ * @brief The movements in list order, one column per field.
+ *
+ * A scan reads 16 bytes per movement from dense arrays instead of chasing
+ * the list: the park, the plate key and a stamp that packs the minute of
+ * the movement with its kind. The Movement itself is only reached through
+ * rows once a scan finds what it was looking for.
+ *
+ * @param parkIds Id of the park of each movement.
+ * @param plateKeys Plate of each movement, as plate_to_key.
+ * @param stamps minute_number of each movement, shifted left by one, with
+ * STORE_EXIT_BIT set for exits.
+ * @param rows The Movement of each row.
+ * @param count Number of movements.
+ * @param capacity Number of rows allocated.
+ */
+typedef struct MovementStore {
+    int *parkIds;
+    unsigned int *plateKeys;
+    long long *stamps;
+    Movement **rows;
+    unsigned int count;
+    unsigned int capacity;
+} MovementStore;
+
+
+MovementStore *movement_store_create(void);
+void movement_store_free(MovementStore *store);
+int movement_store_reserve(MovementStore *store, unsigned int rows);
+int movement_store_append(MovementStore *store, Movement *movement, int parkId);
+Movement *movement_store_last(MovementStore *store, Movement *head);
+Movement *movement_store_find_entry(MovementStore *store, Movement *head, char *plate);
+char movement_store_last_command(MovementStore *store, Movement *from, char *plate);
+void movement_store_remove_park(MovementStore *store, Movement **head, char *parkName, int parkId);
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * @file trace.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Trace points on the entry, exit and billing paths.
+ *
+ * Each thread writes to its own ring without locks; the ring is registered
+ * once, the first time the thread hits a probe. The dump reads every ring,
+ * so it must run once the other threads have stopped tracing.
+ */
+#ifdef PROJ1_TRACE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proj.h"
+#include "movements.h"
+#include "stats.h"
+#include "trace.h"
+
+/**
+ * @brief Records of one thread.
+ *
+ * @param records The ring.
+ * @param written Records written since the start, the ring holds the last.
+ * @param thread Number of the thread.
+ */
+typedef struct TraceRing {
+    TraceRecord records[TRACE_RING_SIZE];
+    long long written;
+    int thread;
+} TraceRing;
+
+static TraceRing *rings[TRACE_MAX_THREADS];
+static int ringCount;
+static __thread TraceRing *ring;
+
+/**
+ * @brief Gives the calling thread its ring.
+ *
+ * @return The ring, or NULL if there are too many threads or memory
+ * allocation failed.
+ */
+static TraceRing *register_ring(void) {
+    int thread = __atomic_fetch_add(&ringCount, 1, __ATOMIC_RELAXED);
+    if (thread >= TRACE_MAX_THREADS)
+        return NULL;
+
+    TraceRing *created = calloc(1, sizeof(TraceRing));
+    if (created == NULL)
+        return NULL;
+
+    created->thread = thread;
+    __atomic_store_n(&rings[thread], created, __ATOMIC_RELEASE);
+    return created;
+}
+
+/**
+ * @brief Appends a record to the ring of the calling thread.
+ *
+ * @param probe The probe hit.
+ */
+void trace_record(TraceProbe probe) {
+    if (ring == NULL && (ring = register_ring()) == NULL)
+        return;
+
+    TraceRecord *record =
+        &ring->records[ring->written++ & (TRACE_RING_SIZE - 1)];
+    record->nanos = stats_clock();
+    record->probe = probe;
+    record->thread = ring->thread;
+}
+
+/**
+ * @brief Writes every ring to the file named by PROJ1_TRACE_FILE, or to
+ * TRACE_DEFAULT_FILE, and frees them.
+ */
+void trace_dump(void) {
+    const char *path = getenv(TRACE_FILE_VARIABLE);
+    TraceHeader header = {{0}, TRACE_VERSION, 0, 0};
+    int threads = __atomic_load_n(&ringCount, __ATOMIC_RELAXED);
+
+    if (threads > TRACE_MAX_THREADS)
+        threads = TRACE_MAX_THREADS;
+
+    FILE *file = fopen(path ? path : TRACE_DEFAULT_FILE, "wb");
+    if (file == NULL)
+        return;
+
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    for (int t = 0; t < threads; t++) {
+        TraceRing *current = __atomic_load_n(&rings[t], __ATOMIC_ACQUIRE);
+        if (current == NULL)
+            continue;
+        long long kept = current->written < TRACE_RING_SIZE ?
+                            current->written : TRACE_RING_SIZE;
+        header.records += kept;
+        header.dropped += current->written - kept;
+    }
+    fwrite(&header, sizeof(header), 1, file);
+
+    /// Oldest record first, which is the next one to be overwritten
+    for (int t = 0; t < threads; t++) {
+        TraceRing *current = rings[t];
+        if (current == NULL)
+            continue;
+
+        long long first = current->written < TRACE_RING_SIZE ?
+                            0 : current->written;
+        long long kept = current->written < TRACE_RING_SIZE ?
+                            current->written : TRACE_RING_SIZE;
+        for (long long i = 0; i < kept; i++)
+            fwrite(&current->records[(first + i) & (TRACE_RING_SIZE - 1)],
+                    sizeof(TraceRecord), 1, file);
+
+        free(current);
+        rings[t] = NULL;
+    }
+    fclose(file);
+    ring = NULL;
+}
+#endif
+
+/// ISO C needs a declaration here when the probes compile to nothing
+typedef int TraceUnit;
@@ -0,0 +1,93 @@
+/**
+ * @file trace.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Trace points on the entry, exit and billing paths.
+ *
+ * Probes compile to nothing unless the program is built with
+ * -DPROJ1_TRACE. When enabled, each probe appends a timestamped record to
+ * a ring of the thread that hit it, and the rings are written to a file
+ * when the program quits. bench/tracedecode.c turns that file into the
+ * latency of each step.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#define TRACE_MAGIC "PTRC"
+#define TRACE_VERSION 1
+/// Records kept by each thread, a power of two
+#define TRACE_RING_SIZE (1 << 16)
+#define TRACE_MAX_THREADS 16
+#define TRACE_FILE_VARIABLE "PROJ1_TRACE_FILE"
+#define TRACE_DEFAULT_FILE "proj1.trace"
+
+/**
+ * @brief Trace points. Each one but the BEGIN ones marks the end of a step,
+ * which started at the previous record of the same thread.
+ */
+typedef enum TraceProbe {
+    TRACE_ENTRY_BEGIN,
+    TRACE_ENTRY_PARK,       ///< Park lookup and free spot check.
+    TRACE_ENTRY_PLATE,      ///< Plate validation.
+    TRACE_ENTRY_LAST,       ///< Last command of the plate.
+    TRACE_ENTRY_DATE,       ///< Date validation and chronological check.
+    TRACE_ENTRY_APPEND,     ///< Availability update and movement append.
+    TRACE_ENTRY_INDEXES,    ///< Open stays, plate index, timers, vehicles.
+    TRACE_EXIT_BEGIN,
+    TRACE_EXIT_FIND,        ///< Search of the entry movement.
+    TRACE_EXIT_PARK,        ///< Park lookup.
+    TRACE_EXIT_PLATE,       ///< Plate validation.
+    TRACE_EXIT_LAST,        ///< Last command of the plate.
+    TRACE_EXIT_DATE,        ///< Date validation and chronological check.
+    TRACE_EXIT_APPEND,      ///< Availability update and movement append.
+    TRACE_EXIT_UNLINK,      ///< Open stays and plate index.
+    TRACE_BILL_PAYMENT,     ///< Park lookup and price of the stay.
+    TRACE_BILL_INSERT,      ///< Billing hash table insertion.
+    TRACE_BILL_INDEXES,     ///< Revenue prefix, cube, dwell and ledgers.
+    TRACE_BILL_PRINT,       ///< Printing of the bill.
+    TRACE_EXIT_INDEXES,     ///< Vehicles table and timers.
+    TRACE_PROBES
+} TraceProbe;
+
+/**
+ * @brief One record of a trace file.
+ *
+ * @param nanos Monotonic time of the probe.
+ * @param probe The TraceProbe hit.
+ * @param thread Number of the thread, in order of their first record.
+ */
+typedef struct TraceRecord {
+    long long nanos;
+    int probe;
+    int thread;
+} TraceRecord;
+
+/**
+ * @brief Header of a trace file, followed by `records` TraceRecords, each
+ * thread's in the order they were written.
+ *
+ * @param magic TRACE_MAGIC, without terminator.
+ * @param version TRACE_VERSION.
+ * @param records Number of records in the file.
+ * @param dropped Records overwritten before the dump.
+ */
+typedef struct TraceHeader {
+    char magic[4];
+    int version;
+    long long records;
+    long long dropped;
+} TraceHeader;
+
+
+#ifdef PROJ1_TRACE
+#define TRACE(probe) trace_record(probe)
+#define TRACE_DUMP() trace_dump()
+
+void trace_record(TraceProbe probe);
+void trace_dump(void);
+#else
+#define TRACE(probe) ((void)0)
+#define TRACE_DUMP() ((void)0)
+#endif
+
+#endif
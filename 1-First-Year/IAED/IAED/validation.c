@@ -11,6 +11,10 @@
 #include "proj.h"
 #include "validation.h"
 #include "movements.h"
+#include "calendar.h"
+#include "plates.h"
+#include "auxiliary.h"
+#include "engine.h"
 
 
 /**
@@ -43,18 +47,26 @@ int is_invalid_capacity(int capacity) {
 }
 
 /**
- * @brief Checks if a given capacity is invalid (less than or equal to zero).
+ * @brief Checks if a tariff is invalid (not positive or not increasing).
  * 
- * @param capacity The capacity to check.
- * @return 1 if the capacity is invalid, 0 otherwise.
+ * The values are checked in currency units, before they are rounded to
+ * cents, and must not exceed COST_MAX.
+ * 
+ * @param preValue The value per period in the first hour.
+ * @param afterValue The value per period after the first hour.
+ * @param maxValue The maximum daily value.
+ * @return 1 if the tariff is invalid, 0 otherwise.
  */
-int is_invalid_cost(float preValue, float afterValue, float maxValue) {
+int is_invalid_cost(double preValue, double afterValue, double maxValue) {
 
     if (preValue <= 0 || afterValue <= 0 || maxValue <= 0) 
         return 1; /// any of the values are negative  
     
-    if (preValue >= afterValue || afterValue >= maxValue) 
-        return 1; /// is not increasing or exceeds the maximum value 
+    if (!(preValue < afterValue && afterValue < maxValue)) 
+        return 1; /// is not increasing, exceeds the maximum value or is NaN
+
+    if (maxValue > COST_MAX) 
+        return 1; /// would overflow once converted to cents 
 
     return 0; /// cost is valid 
 }
@@ -78,9 +90,9 @@ int is_too_many_parks(int parksCounter) {
  * @param parksTotal The total parks.
  * @param namePark The name of the park.
  * @param capacity The capacity of the park.
- * @param preValue The pre value.
- * @param afterValue The after value.
- * @param maxValue The max value.
+ * @param preValue The pre value, in currency units.
+ * @param afterValue The after value, in currency units.
+ * @param maxValue The max value, in currency units.
  * @param parksCounter The parks counter.
  * 
  * @return 1 if the park can be added, 0 otherwise.
@@ -88,30 +100,30 @@ int is_too_many_parks(int parksCounter) {
 int can_add_park(Park *parksTotal, 
                 char *namePark, 
                 int capacity, 
-                float preValue, 
-                float afterValue, 
-                float maxValue, 
+                double preValue, 
+                double afterValue, 
+                double maxValue, 
                 int parksCounter) {
 
-    if (park_name_exists(parksTotal, namePark, parksCounter)) {
-        printf("%s: %s%c", namePark, ERROR_PARKING_ALREADY_EXISTS, NEW_LINE);
-        return 0;
-    }
+    char capacityText[INT_TEXT_SIZE];
+
+    if (park_name_exists(parksTotal, namePark, parksCounter))
+        return reject(ENGINE_PARKING_EXISTS, 
+                    namePark, 
+                    ERROR_PARKING_ALREADY_EXISTS);
 
     if (is_invalid_capacity(capacity)) {
-        printf("%d: %s%c", capacity, ERROR_INVALID_CAPACITY, NEW_LINE);
-        return 0;
+        snprintf(capacityText, sizeof(capacityText), "%d", capacity);
+        return reject(ENGINE_INVALID_CAPACITY, 
+                    capacityText, 
+                    ERROR_INVALID_CAPACITY);
     }
 
-    if (is_invalid_cost(preValue, afterValue, maxValue)) {
-        printf("%s%c", ERROR_INVALID_COST, NEW_LINE);
-        return 0;
-    }
+    if (is_invalid_cost(preValue, afterValue, maxValue))
+        return reject(ENGINE_INVALID_COST, NULL, ERROR_INVALID_COST);
 
-    if (is_too_many_parks(parksCounter)) {
-        printf("%s%c", ERROR_TOO_MANY_PARKS, NEW_LINE);
-        return 0;
-    }
+    if (is_too_many_parks(parksCounter))
+        return reject(ENGINE_TOO_MANY_PARKS, NULL, ERROR_TOO_MANY_PARKS);
 
     return 1;
 }
@@ -126,6 +138,10 @@ int is_valid_plate(char *plateToCheck){
     char pairs[3][3];
     int digitPairCount = 0;
     int alphaPairCount = 0;
+
+    /// Plates in the exact "XX-XX-XX" layout are checked as a single word
+    if (strlen(plateToCheck) == PLATE_LENGTH)
+        return plate_word_is_valid(plateToCheck);
     
     if (sscanf(plateToCheck, "%2s-%2s-%2s", 
         pairs[0], pairs[1], pairs[2]) != 3) {
@@ -297,7 +313,8 @@ int is_valid_time(Time time) {
 /**
  * @brief Checks if a given entry date is valid.
  * 
- * @param head Pointer to the head of the movement list.
+ * @param head Pointer to the head of the movement list, or to any later
+ * movement such as its tail, as only the last date matters.
  * @param entryDate The entry date to check.
  * @return 1 if the entry date is valid, 0 otherwise.
  */
@@ -317,15 +334,8 @@ int is_valid_entry_date(Movement *head, Date *entryDate){
  * @return 1 if the period includes February 29, 0 otherwise.
  */
 int includes_feb29(Date entryDate, Date exitDate) {
-    for (int year = entryDate.year; year <= exitDate.year; year++) {
-
-        Date feb29 = {29, 2, year, {23, 59}};
-
-        if (is_leap_year(year) && 
-            is_previous_date_hour(entryDate, feb29) && 
-            is_previous_date_hour(feb29, exitDate))
-            return 1;   
-    }
+    if (feb29_before(exitDate) > feb29_before(entryDate))
+        return 1;
     return 0;
 }
 
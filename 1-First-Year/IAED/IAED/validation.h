@@ -21,9 +21,9 @@
 
 int park_name_exists(Park *parks, char *namePark, int numParks);
 int is_invalid_capacity(int capacity);
-int is_invalid_cost(float preValue, float afterValue, float maxValue);
+int is_invalid_cost(double preValue, double afterValue, double maxValue);
 int is_too_many_parks(int parksCounter);
-int can_add_park(Park *parksTotal, char *namePark, int capacity, float preValue, float afterValue, float maxValue, int parksCounter);
+int can_add_park(Park *parksTotal, char *namePark, int capacity, double preValue, double afterValue, double maxValue, int parksCounter);
 int is_valid_plate(char *plateToCheck);
 int is_equal_dates(Date d1, Date d2);
 int is_previous_date(Date date1, Date date2);
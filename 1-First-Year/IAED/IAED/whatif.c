@@ -0,0 +1,228 @@
+/**
+ * @file whatif.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Re-bills the closed stays under candidate tariffs.
+ *
+ * Building the history is a single pass over the billing records. After
+ * that, each candidate costs one dot product of CHARGE_TABLE_SIZE entries
+ * per park and day, a loop the compiler vectorizes, so hundreds of
+ * candidates over millions of stays only depend on the number of groups.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proj.h"
+#include "movements.h"
+#include "auxiliary.h"
+#include "validation.h"
+#include "calendar.h"
+#include "whatif.h"
+#include "accounting.h"
+
+/**
+ * @brief Appends an empty group to the history.
+ *
+ * @param history The history to grow.
+ * @param park The park of the group.
+ * @param day The exit day of the group.
+ * @return The new group, or NULL if memory allocation failed.
+ */
+static StayGroup *add_stay_group(StayHistory *history, Park *park, Date day) {
+    if (history->count == history->capacity) {
+        int capacity = history->capacity * 2;
+        StayGroup *groups = mem_realloc(MEM_BUFFERS, history->groups,
+                                    history->capacity * sizeof(StayGroup),
+                                    capacity * sizeof(StayGroup));
+        if (groups == NULL)
+            return NULL;
+
+        history->groups = groups;
+        history->capacity = capacity;
+    }
+
+    StayGroup *group = &history->groups[history->count++];
+    memset(group, 0, sizeof(StayGroup));
+    group->park = park;
+    group->day = day;
+    return group;
+}
+
+/**
+ * @brief Summarises the billed stays of every park by exit day.
+ *
+ * @param parksTotal Pointer to the array of parks.
+ * @param parksCounter The total number of parks.
+ * @param billing The billing hash table.
+ * @return The history, or NULL if memory allocation failed.
+ */
+StayHistory *stay_history_build(Park *parksTotal,
+                                int parksCounter,
+                                BillingHashTable *billing) {
+
+    StayHistory *history = mem_alloc(MEM_BUFFERS, sizeof(StayHistory));
+    if (history == NULL)
+        return NULL;
+
+    history->count = 0;
+    history->capacity = WHATIF_GROUPS_INITIAL;
+    history->groups = mem_alloc(MEM_BUFFERS,
+                                history->capacity * sizeof(StayGroup));
+    if (history->groups == NULL) {
+        mem_free(MEM_BUFFERS, history, sizeof(StayHistory));
+        return NULL;
+    }
+
+    for (int i = 0; i < parksCounter; i++) {
+        Park *park = &parksTotal[i];
+        BillingNode *node = bill_hash_table_get(billing, park->parkName);
+        StayGroup *group = NULL;
+
+        /// Billing records of a park are in exit order
+        for (; node != NULL; node = node->next) {
+            if (strcmp(node->key, park->parkName) != 0)
+                continue;
+
+            if (group == NULL || !is_equal_dates(group->day, node->value->date)){
+                group = add_stay_group(history, park, node->value->date);
+                if (group == NULL) {
+                    stay_history_free(history);
+                    return NULL;
+                }
+            }
+
+            long long days = node->minutes / MINUTES_PER_DAY;
+            long long rest = node->minutes - days * MINUTES_PER_DAY;
+
+            group->exits++;
+            group->days += days;
+            group->periods[(rest+MINUTES_PER_PERIOD-1)/MINUTES_PER_PERIOD]++;
+        }
+    }
+    return history;
+}
+
+/**
+ * @brief Frees a stay history.
+ *
+ * @param history The history to free.
+ */
+void stay_history_free(StayHistory *history) {
+    mem_free(MEM_BUFFERS, history->groups,
+            history->capacity * sizeof(StayGroup));
+    mem_free(MEM_BUFFERS, history, sizeof(StayHistory));
+}
+
+/**
+ * @brief Computes the revenue of a group of stays under a tariff.
+ *
+ * @param group The group of stays.
+ * @param charge The tariff, in cents.
+ * @param chargeTable The charge table of the tariff.
+ * @return The revenue, in cents.
+ */
+long long stay_group_revenue(StayGroup *group,
+                            Charging charge,
+                            int *chargeTable) {
+
+    long long revenue = 0;
+
+    for (int p = 0; p < CHARGE_TABLE_SIZE; p++)
+        revenue += (long long)group->periods[p] * chargeTable[p];
+
+    return revenue + group->days * charge.maxValue;
+}
+
+/**
+ * @brief Re-bills every group of stays under every candidate tariff.
+ *
+ * @param history The stays to re-bill.
+ * @param candidates The candidate tariffs, in cents.
+ * @param count The number of candidates.
+ * @return The revenue of group g under candidate c at g * count + c, or
+ * NULL if memory allocation failed. The caller frees it with
+ * simulation_free.
+ */
+long long *simulate_tariffs(StayHistory *history,
+                            Charging *candidates,
+                            int count) {
+
+    size_t tablesSize = (size_t)count * CHARGE_TABLE_SIZE * sizeof(int);
+    int *tables = mem_alloc(MEM_BUFFERS, tablesSize);
+    long long *revenue = mem_alloc(MEM_BUFFERS,
+                                ((size_t)history->count * count + 1) *
+                                sizeof(long long));
+
+    if (tables == NULL || revenue == NULL) {
+        mem_free(MEM_BUFFERS, tables, tablesSize);
+        simulation_free(history, revenue, count);
+        return NULL;
+    }
+
+    for (int c = 0; c < count; c++)
+        fill_charge_table(candidates[c], &tables[c * CHARGE_TABLE_SIZE]);
+
+    /// Every candidate for a group while its period counts are in cache
+    for (int g = 0; g < history->count; g++) {
+        for (int c = 0; c < count; c++)
+            revenue[(long)g * count + c] =
+                stay_group_revenue(&history->groups[g],
+                                candidates[c],
+                                &tables[c * CHARGE_TABLE_SIZE]);
+    }
+
+    mem_free(MEM_BUFFERS, tables, tablesSize);
+    return revenue;
+}
+
+/**
+ * @brief Frees the revenue computed by simulate_tariffs.
+ *
+ * @param history The stays it was computed for.
+ * @param revenue The revenue, may be NULL.
+ * @param count The number of candidates.
+ */
+void simulation_free(StayHistory *history, long long *revenue, int count) {
+    mem_free(MEM_BUFFERS, revenue,
+            ((size_t)history->count * count + 1) * sizeof(long long));
+}
+
+/**
+ * @brief Prints the revenue of every candidate by park and day.
+ *
+ * For each candidate, in order, prints one line per park and exit day and
+ * then one line with the park's total.
+ *
+ * @param history The re-billed stays.
+ * @param revenue The revenue returned by simulate_tariffs.
+ * @param count The number of candidates.
+ */
+void show_simulation(StayHistory *history, long long *revenue, int count) {
+    for (int c = 0; c < count; c++) {
+        long long parkTotal = 0;
+
+        for (int g = 0; g < history->count; g++) {
+            StayGroup *group = &history->groups[g];
+            long long value = revenue[(long)g * count + c];
+
+            printf("%d %s %02d-%02d-%04d ",
+                c + 1,
+                group->park->parkName,
+                group->day.day,
+                group->day.month,
+                group->day.year);
+            print_money(value);
+            printf("%c", NEW_LINE);
+            parkTotal += value;
+
+            /// Close the park after its last day
+            if (g + 1 == history->count ||
+                history->groups[g + 1].park != group->park) {
+                printf("%d %s ", c + 1, group->park->parkName);
+                print_money(parkTotal);
+                printf("%c", NEW_LINE);
+                parkTotal = 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,59 @@
+/**
+ * @file whatif.h
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Re-bills the closed stays under candidate tariffs.
+ *
+ * The stays billed so far are summarised once per park and exit day: the
+ * complete days of every stay are summed and the remaining part of the
+ * stay is counted by its number of started 15 minute periods. The revenue
+ * of any tariff for that group is then the summed days times Z plus the
+ * period counts dotted with the tariff's charge table, regardless of how
+ * many stays the group holds.
+ */
+#ifndef WHATIF_H
+#define WHATIF_H
+#include "movements.h"
+
+#define WHATIF_CANDIDATES_MAX 512
+#define WHATIF_GROUPS_INITIAL 64
+
+/**
+ * @brief The stays of a park that exited on the same day.
+ *
+ * @param park The park the stays were billed in.
+ * @param day The exit day.
+ * @param exits The number of stays.
+ * @param days The complete days of all the stays, added up.
+ * @param periods Number of stays by started periods after the complete days.
+ */
+typedef struct StayGroup {
+    Park *park;
+    Date day;
+    int exits;
+    long long days;
+    int periods[CHARGE_TABLE_SIZE];
+} StayGroup;
+
+/**
+ * @brief The closed stays of every park, grouped by park and exit day.
+ *
+ * @param groups The groups, by park and then by day.
+ * @param count The number of groups.
+ * @param capacity The number of groups allocated.
+ */
+typedef struct StayHistory {
+    StayGroup *groups;
+    int count;
+    int capacity;
+} StayHistory;
+
+
+StayHistory *stay_history_build(Park *parksTotal, int parksCounter, BillingHashTable *billing);
+void stay_history_free(StayHistory *history);
+long long stay_group_revenue(StayGroup *group, Charging charge, int *chargeTable);
+long long *simulate_tariffs(StayHistory *history, Charging *candidates, int count);
+void simulation_free(StayHistory *history, long long *revenue, int count);
+void show_simulation(StayHistory *history, long long *revenue, int count);
+
+#endif
@@ -0,0 +1,161 @@
+/**
+ * @file enginecheck.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Checks of the embeddable interface of the parking engine.
+ *
+ * Drives engine.h the way an embedding program would: adds parks, submits
+ * a batch of entries and exits and compares the result code and payment of
+ * every event with the ones the commands would give. Then checks that the
+ * output of the commands stays off while any engine is alive and comes
+ * back when the last one is freed.
+ *
+ * Prints every mismatch on stderr and exits with 1 if there was any.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "proj.h"
+#include "auxiliary.h"
+#include "engine.h"
+
+#define CHECK_NO_PARK 99
+#define CHECK_EVENTS 11
+
+/**
+ * @brief An event of the batch and what it should give.
+ */
+typedef struct {
+    const char *plate;  ///< Plate of the event, or NULL for an empty key.
+    int onPark;         ///< 1 for the park of the check, 0 for none.
+    EngineDate date;
+    char command;
+    int result;         ///< Expected result code.
+    long long payment;  ///< Expected payment, in cents.
+} ExpectedEvent;
+
+/// Park of capacity 2 at 0.25, 0.30 and 10.00 per day
+static const ExpectedEvent batch[CHECK_EVENTS] = {
+    {"AA-00-AA", 1, {1, 1, 2024, 8, 0}, ENGINE_ENTRY, ENGINE_OK, 0},
+    {"BB-00-BB", 1, {1, 1, 2024, 8, 10}, ENGINE_ENTRY, ENGINE_OK, 0},
+    {"CC-00-CC", 1, {1, 1, 2024, 8, 20}, ENGINE_ENTRY,
+        ENGINE_PARKING_IS_FULL, 0},
+    {"AA-00-AA", 1, {1, 1, 2024, 10, 0}, ENGINE_EXIT, ENGINE_OK, 220},
+    {"BB-00-BB", 1, {1, 1, 2024, 10, 5}, ENGINE_ENTRY,
+        ENGINE_INVALID_ENTRY, 0},
+    {"CC-00-CC", 1, {1, 1, 2024, 10, 10}, ENGINE_EXIT,
+        ENGINE_INVALID_EXIT, 0},
+    {"DD-00-DD", 1, {1, 1, 2024, 9, 0}, ENGINE_ENTRY,
+        ENGINE_INVALID_DATE, 0},
+    {"DD-00-DD", 0, {1, 1, 2024, 11, 0}, ENGINE_ENTRY,
+        ENGINE_NO_SUCH_PARKING, 0},
+    {NULL, 1, {1, 1, 2024, 11, 0}, ENGINE_ENTRY, ENGINE_INVALID_PLATE, 0},
+    {"DD-00-DD", 1, {1, 1, 2024, 11, 0}, 'x', ENGINE_INVALID_EVENT, 0},
+    {"BB-00-BB", 1, {3, 1, 2024, 9, 0}, ENGINE_EXIT, ENGINE_OK, 2100},
+};
+
+/**
+ * @brief Compares a value with the expected one.
+ *
+ * @param what What the value is, for the message.
+ * @param index Number of the event, or -1.
+ * @param got The value.
+ * @param want The expected value.
+ * @return 0 if they match, 1 otherwise.
+ */
+static int expect(const char *what, int index, long long got, long long want) {
+    if (got == want)
+        return 0;
+
+    fprintf(stderr, "enginecheck: %s", what);
+    if (index >= 0)
+        fprintf(stderr, " of event %d", index);
+    fprintf(stderr, " is %lld, expected %lld\n", got, want);
+    return 1;
+}
+
+/**
+ * @brief Adds the park of the check and submits the batch.
+ *
+ * @return The number of mismatches.
+ */
+static int check_batch(void) {
+    EngineEvent events[CHECK_EVENTS];
+    int results[CHECK_EVENTS], parkId, other, failures = 0, accepted = 0;
+    long long payments[CHECK_EVENTS];
+
+    Engine *engine = engine_create();
+    if (engine == NULL)
+        return expect("engine", -1, 0, 1);
+
+    failures += expect("add park", -1,
+                    engine_add_park(engine, "Check", 2, 25, 30, 1000, &parkId),
+                    ENGINE_OK);
+    failures += expect("add same park", -1,
+                    engine_add_park(engine, "Check", 2, 25, 30, 1000, &other),
+                    ENGINE_PARKING_EXISTS);
+    failures += expect("add park with costs out of order", -1,
+                    engine_add_park(engine, "Other", 2, 30, 25, 1000, &other),
+                    ENGINE_INVALID_COST);
+
+    for (int i = 0; i < CHECK_EVENTS; i++) {
+        const ExpectedEvent *expected = &batch[i];
+        EngineEvent event = {expected->onPark ? parkId : CHECK_NO_PARK,
+                            expected->plate != NULL ?
+                                engine_plate_key(expected->plate) : 0,
+                            expected->date,
+                            expected->command};
+        events[i] = event;
+        accepted += expected->result == ENGINE_OK;
+    }
+
+    failures += expect("accepted events", -1,
+                    engine_submit(engine, events, CHECK_EVENTS,
+                                results, payments),
+                    accepted);
+    for (int i = 0; i < CHECK_EVENTS; i++) {
+        failures += expect("result", i, results[i], batch[i].result);
+        failures += expect("payment", i, payments[i], batch[i].payment);
+    }
+
+    engine_free(engine);
+    return failures;
+}
+
+/**
+ * @brief Checks that the commands stay quiet while any engine is alive.
+ *
+ * @return The number of mismatches.
+ */
+static int check_silence(void) {
+    int failures = expect("output before any engine", -1, echo_enabled(), 1);
+
+    Engine *first = engine_create(), *second = engine_create();
+    if (first == NULL || second == NULL) {
+        engine_free(first);
+        engine_free(second);
+        return failures + expect("engines", -1, 0, 1);
+    }
+    failures += expect("output with two engines", -1, echo_enabled(), 0);
+
+    engine_free(first);
+    failures += expect("output with one engine left", -1, echo_enabled(), 0);
+
+    /// Freeing nothing must not release the hold of the other engine
+    engine_free(NULL);
+    failures += expect("output after freeing NULL", -1, echo_enabled(), 0);
+
+    engine_free(second);
+    return failures + expect("output after the last engine", -1,
+                            echo_enabled(), 1);
+}
+
+int main(void) {
+    int failures = check_batch() + check_silence();
+
+    if (failures > 0) {
+        fprintf(stderr, "enginecheck: %d mismatches\n", failures);
+        return 1;
+    }
+    printf("enginecheck: ok\n");
+    return 0;
+}
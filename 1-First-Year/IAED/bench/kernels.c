@@ -0,0 +1,559 @@
+/**
+ * @file kernels.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Microbenchmarks of the hot kernels of the parking management
+ * system.
+ *
+ * Each kernel runs on generated inputs of increasing size, several times,
+ * and one CSV line is printed per kernel and size with the best and the
+ * median time per operation. Inputs come from a fixed seed, so two runs of
+ * the same build time the same work.
+ *
+ * Options are given as key=value arguments, see usage().
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proj.h"
+#include "movements.h"
+#include "auxiliary.h"
+#include "validation.h"
+#include "accounting.h"
+#include "stats.h"
+#include "arena.h"
+
+#define KERNEL_MIN_SIZE 1024
+#define KERNEL_MAX_SIZE 262144
+/// Kernels that walk a chain are quadratic in the size, so they stop here
+#define KERNEL_MAX_CHAIN 16384
+/// Small sizes are repeated until a run does at least this many operations
+#define KERNEL_MIN_OPS 1000000
+#define KERNEL_MAX_REPEATS 64
+#define KERNEL_PARK_NAMES 10
+#define KERNEL_LINE_MAX 64
+
+/**
+ * @brief Options of the run.
+ */
+typedef struct {
+    const char *only;   ///< Name of the only kernel to run, or NULL.
+    int maxSize;        ///< Largest input size.
+    int repeats;        ///< Timed runs of each kernel and size.
+    unsigned long long seed;
+} KernelConfig;
+
+/**
+ * @brief Inputs shared by every kernel, generated once for the largest size.
+ */
+typedef struct {
+    int size;
+    char (*plates)[PLATE_MAX];        ///< Plates, one in eight invalid.
+    char (*dateLines)[KERNEL_LINE_MAX];  ///< " dd-mm-yyyy hh:mm".
+    char (*parkLines)[KERNEL_LINE_MAX];  ///< Arguments of an 'e' command.
+    Date *entries;                    ///< Entry dates.
+    Date *exits;                      ///< Exit dates, after the entries.
+    Movement *movements;              ///< Movements in one of a few parks.
+} KernelInputs;
+
+/**
+ * @brief A kernel: runs `size` operations and returns a checksum, so the
+ * compiler cannot drop the work.
+ */
+typedef long long (*KernelFunction)(KernelInputs *inputs, int size);
+
+/**
+ * @brief A kernel and the largest size it runs on.
+ *
+ * Kernels that need a structure to work on build it in prepare and free it
+ * in release, both left out of the timing. Either may be NULL.
+ */
+typedef struct {
+    const char *name;
+    KernelFunction run;
+    int maxSize;
+    void (*prepare)(KernelInputs *inputs, int size);
+    void (*release)(void);
+} Kernel;
+
+static const char *parkNames[KERNEL_PARK_NAMES] = {
+    "P00", "P01", "P02", "P03", "P04", "P05", "P06", "P07", "P08", "P09"
+};
+
+static unsigned long long rng;
+/// Table of the lookup kernel, built by prepare_lookups
+static HashTable *lookups;
+
+/**
+ * @brief Draws a number in [0, bound) with xorshift64*.
+ *
+ * @param bound The exclusive upper bound.
+ * @return The number.
+ */
+static int draw(int bound) {
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return (int)(((rng * 2685821657736338717ULL) >> 33) % bound);
+}
+
+/**
+ * @brief Draws a valid date, kept away from 29 February.
+ *
+ * @return The date.
+ */
+static Date draw_date(void) {
+    Date date;
+    date.day = 1 + draw(28);
+    date.month = 1 + draw(12);
+    date.year = 2000 + draw(30);
+    date.time.hour = draw(24);
+    date.time.minute = draw(60);
+    return date;
+}
+
+/**
+ * @brief Writes a plate of two letter pairs and one digit pair, or an
+ * invalid one.
+ *
+ * @param plate Where the plate is written.
+ * @param valid Whether the plate must be valid.
+ */
+static void draw_plate(char *plate, int valid) {
+    int digits = draw(3);
+
+    for (int pair = 0; pair < 3; pair++) {
+        char *at = plate + pair * 3;
+        if (pair == digits) {
+            at[0] = '0' + draw(10);
+            at[1] = valid ? '0' + draw(10) : 'a' + draw(26);
+        } else {
+            at[0] = 'A' + draw(26);
+            at[1] = 'A' + draw(26);
+        }
+        at[2] = pair < 2 ? '-' : NULL_TERMINATOR;
+    }
+}
+
+/**
+ * @brief Generates the inputs of every kernel.
+ *
+ * @param inputs Where the inputs are stored.
+ * @param size Number of inputs of each kind.
+ *
+ * @return 1 on success, 0 if memory allocation failed.
+ */
+static int generate_inputs(KernelInputs *inputs, int size) {
+    inputs->size = size;
+    inputs->plates = malloc(size * sizeof(*inputs->plates));
+    inputs->dateLines = malloc(size * sizeof(*inputs->dateLines));
+    inputs->parkLines = malloc(size * sizeof(*inputs->parkLines));
+    inputs->entries = malloc(size * sizeof(Date));
+    inputs->exits = malloc(size * sizeof(Date));
+    inputs->movements = calloc(size, sizeof(Movement));
+
+    if (!inputs->plates || !inputs->dateLines || !inputs->parkLines ||
+        !inputs->entries || !inputs->exits || !inputs->movements)
+        return 0;
+
+    for (int i = 0; i < size; i++) {
+        draw_plate(inputs->plates[i], draw(8) != 0);
+
+        /// Stays of up to thirty years, so most of them cross a leap day
+        Date entry = draw_date(), exit = draw_date();
+        if (is_previous_date_hour(exit, entry)) {
+            Date earlier = exit;
+            exit = entry;
+            entry = earlier;
+        }
+        inputs->entries[i] = entry;
+        inputs->exits[i] = exit;
+
+        sprintf(inputs->dateLines[i], " %02d-%02d-%04d %02d:%02d",
+            entry.day, entry.month, entry.year,
+            entry.time.hour, entry.time.minute);
+
+        const char *park = parkNames[draw(KERNEL_PARK_NAMES)];
+        if (draw(2))
+            sprintf(inputs->parkLines[i], " %s %s%s",
+                park, inputs->plates[i], inputs->dateLines[i]);
+        else
+            sprintf(inputs->parkLines[i], " \"%s Norte\" %s%s",
+                park, inputs->plates[i], inputs->dateLines[i]);
+
+        inputs->movements[i].plate = inputs->plates[i];
+        inputs->movements[i].parkName = (char *)park;
+        inputs->movements[i].date = exit;
+        inputs->movements[i].command = 's';
+    }
+    return 1;
+}
+
+/**
+ * @brief Frees the inputs.
+ *
+ * @param inputs The inputs.
+ */
+static void free_inputs(KernelInputs *inputs) {
+    free(inputs->plates);
+    free(inputs->dateLines);
+    free(inputs->parkLines);
+    free(inputs->entries);
+    free(inputs->exits);
+    free(inputs->movements);
+}
+
+/**
+ * @brief Hashes `size` plates.
+ */
+static long long kernel_hash(KernelInputs *inputs, int size) {
+    long long sum = 0;
+    for (int i = 0; i < size; i++)
+        sum += hash_function(inputs->plates[i]);
+    return sum;
+}
+
+/**
+ * @brief Hashes `size` plates with the secondary hash.
+ */
+static long long kernel_secondary_hash(KernelInputs *inputs, int size) {
+    long long sum = 0;
+    for (int i = 0; i < size; i++)
+        sum += secondary_hash_function(inputs->plates[i]);
+    return sum;
+}
+
+/**
+ * @brief Fills the table of the lookup kernel with `size` plates, so its
+ * chains grow with the size.
+ */
+static void prepare_lookups(KernelInputs *inputs, int size) {
+    lookups = hash_table_create(HASH_CAPACITY);
+    for (int i = 0; i < size; i++)
+        hash_table_add(lookups, inputs->plates[i], &inputs->movements[i]);
+}
+
+/**
+ * @brief Frees the table of the lookup kernel.
+ */
+static void release_lookups(void) {
+    hash_table_free(lookups);
+    lookups = NULL;
+}
+
+/**
+ * @brief Looks up `size` plates, all of them in the table.
+ */
+static long long kernel_hash_table_get(KernelInputs *inputs, int size) {
+    long long sum = 0;
+    for (int i = 0; i < size; i++)
+        sum += hash_table_get(lookups, inputs->plates[i]) != NULL;
+    return sum;
+}
+
+/**
+ * @brief Validates `size` plates.
+ */
+static long long kernel_is_valid_plate(KernelInputs *inputs, int size) {
+    long long sum = 0;
+    for (int i = 0; i < size; i++)
+        sum += is_valid_plate(inputs->plates[i]);
+    return sum;
+}
+
+/**
+ * @brief Parses `size` dates.
+ */
+static long long kernel_get_date(KernelInputs *inputs, int size) {
+    long long sum = 0;
+    for (int i = 0; i < size; i++) {
+        Date *date = get_date(inputs->dateLines[i]);
+        sum += date->day + date->time.minute;
+        arena_reset(scratch_arena());
+    }
+    return sum;
+}
+
+/**
+ * @brief Parses the park name of 'e' arguments, half of them quoted. The
+ * copy of each line, which get_park_name overwrites, is timed too.
+ */
+static long long kernel_get_park_name(KernelInputs *inputs, int size) {
+    char line[KERNEL_LINE_MAX];
+    long long sum = 0;
+
+    for (int i = 0; i < size; i++) {
+        strcpy(line, inputs->parkLines[i]);
+        char *name = get_park_name(line);
+        sum += name[1];
+        arena_reset(scratch_arena());
+    }
+    return sum;
+}
+
+/**
+ * @brief Prices `size` stays.
+ */
+static long long kernel_calculate_payment(KernelInputs *inputs, int size) {
+    Park park = {0};
+    Movement entry = {0}, exit = {0};
+    long long sum = 0;
+
+    park.charge = (Charging){25, 40, 1500};
+    build_charge_table(&park);
+
+    for (int i = 0; i < size; i++) {
+        entry.date = inputs->entries[i];
+        exit.date = inputs->exits[i];
+        sum += calculate_payment(&park, &entry, &exit);
+    }
+    return sum;
+}
+
+/**
+ * @brief Converts `size` dates to minutes.
+ */
+static long long kernel_total_minutes(KernelInputs *inputs, int size) {
+    long long sum = 0;
+    for (int i = 0; i < size; i++)
+        sum += totalMinutes(inputs->entries[i]);
+    return sum;
+}
+
+/**
+ * @brief Checks `size` stays for a 29 February.
+ */
+static long long kernel_includes_feb29(KernelInputs *inputs, int size) {
+    long long sum = 0;
+    for (int i = 0; i < size; i++)
+        sum += includes_feb29(inputs->entries[i], inputs->exits[i]);
+    return sum;
+}
+
+/**
+ * @brief Inserts `size` nodes in a single bucket, kept sorted by park name,
+ * so each insertion walks part of a chain as long as the size.
+ */
+static long long kernel_insert_node(KernelInputs *inputs, int size) {
+    Node *nodes = malloc(size * sizeof(Node));
+    Node *bucket = NULL;
+    long long sum = 0;
+
+    if (nodes == NULL)
+        return 0;
+
+    for (int i = 0; i < size; i++) {
+        nodes[i].key = inputs->plates[i];
+        nodes[i].value = &inputs->movements[i];
+        insert_node(&bucket, &nodes[i]);
+    }
+    for (Node *node = bucket; node; node = node->next)
+        sum = sum * 31 + node->value->parkName[2];
+
+    free(nodes);
+    return sum;
+}
+
+/**
+ * @brief Bills `size` exits of one park into a table of one bucket, so each
+ * one is appended to a chain as long as the size.
+ */
+static long long kernel_bill_hash_table_add(KernelInputs *inputs, int size) {
+    BillingHashTable *billing = bill_hash_table_create(1);
+    long long sum = 0;
+
+    for (int i = 0; i < size; i++)
+        bill_hash_table_add(billing, (char *)parkNames[0], &inputs->movements[i],
+                            i, i);
+    for (BillingNode *node = billing->buckets[0]; node; node = node->next)
+        sum += node->bill;
+
+    bill_hash_table_free(billing);
+    return sum;
+}
+
+static const Kernel kernels[] = {
+    {"hash_function", kernel_hash, KERNEL_MAX_SIZE, NULL, NULL},
+    {"secondary_hash_function", kernel_secondary_hash, KERNEL_MAX_SIZE,
+        NULL, NULL},
+    {"hash_table_get", kernel_hash_table_get, KERNEL_MAX_SIZE,
+        prepare_lookups, release_lookups},
+    {"is_valid_plate", kernel_is_valid_plate, KERNEL_MAX_SIZE, NULL, NULL},
+    {"get_date", kernel_get_date, KERNEL_MAX_SIZE, NULL, NULL},
+    {"get_park_name", kernel_get_park_name, KERNEL_MAX_SIZE, NULL, NULL},
+    {"calculate_payment", kernel_calculate_payment, KERNEL_MAX_SIZE,
+        NULL, NULL},
+    {"totalMinutes", kernel_total_minutes, KERNEL_MAX_SIZE, NULL, NULL},
+    {"includes_feb29", kernel_includes_feb29, KERNEL_MAX_SIZE, NULL, NULL},
+    {"insert_node", kernel_insert_node, KERNEL_MAX_CHAIN, NULL, NULL},
+    {"bill_hash_table_add", kernel_bill_hash_table_add, KERNEL_MAX_CHAIN,
+        NULL, NULL},
+};
+
+/**
+ * @brief Moves a duration down a max-heap until its children are smaller.
+ *
+ * @param nanos The heap.
+ * @param position Where the duration is.
+ * @param size Number of durations in the heap.
+ */
+static void sift_down(long long *nanos, long position, long size) {
+    long long value = nanos[position];
+
+    while (2 * position + 1 < size) {
+        long child = 2 * position + 1;
+        if (child + 1 < size && nanos[child + 1] > nanos[child])
+            child++;
+        if (nanos[child] <= value)
+            break;
+
+        nanos[position] = nanos[child];
+        position = child;
+    }
+    nanos[position] = value;
+}
+
+/**
+ * @brief Sorts durations in increasing order.
+ *
+ * A heap sort, as the library sort may not be used.
+ *
+ * @param nanos The durations.
+ * @param count Number of durations.
+ */
+static void sort_nanos(long long *nanos, long count) {
+    for (long i = count / 2 - 1; i >= 0; i--)
+        sift_down(nanos, i, count);
+
+    /// The maximum goes to the end on every step
+    for (long size = count - 1; size > 0; size--) {
+        long long largest = nanos[0];
+        nanos[0] = nanos[size];
+        nanos[size] = largest;
+        sift_down(nanos, 0, size);
+    }
+}
+
+/**
+ * @brief Times one kernel at one size and prints its CSV line.
+ *
+ * A timed run repeats the kernel until it has done KERNEL_MIN_OPS
+ * operations, so small sizes are not lost in the clock resolution.
+ *
+ * @param kernel The kernel.
+ * @param inputs The inputs.
+ * @param size The input size.
+ * @param repeats Number of timed runs.
+ */
+static void time_kernel(const Kernel *kernel,
+                        KernelInputs *inputs,
+                        int size,
+                        int repeats) {
+
+    long long runs[KERNEL_MAX_REPEATS], checksum = 0;
+    long passes = (KERNEL_MIN_OPS + size - 1) / size;
+
+    /// Chain kernels do `size` walks of up to `size` nodes per pass
+    if (kernel->maxSize == KERNEL_MAX_CHAIN)
+        passes = 1;
+
+    if (kernel->prepare)
+        kernel->prepare(inputs, size);
+    checksum += kernel->run(inputs, size);
+
+    for (int r = 0; r < repeats; r++) {
+        long long start = stats_clock();
+        for (long p = 0; p < passes; p++)
+            checksum += kernel->run(inputs, size);
+        runs[r] = stats_clock() - start;
+    }
+    if (kernel->release)
+        kernel->release();
+    sort_nanos(runs, repeats);
+
+    long long ops = (long long)passes * size;
+    printf("%s,%d,%lld,%.2f,%.2f,%llx\n",
+        kernel->name,
+        size,
+        ops,
+        (double)runs[0] / ops,
+        (double)runs[repeats / 2] / ops,
+        (unsigned long long)checksum & 0xffff);
+}
+
+/**
+ * @brief Prints the accepted options.
+ */
+static void usage(void) {
+    fprintf(stderr,
+        "usage: kernels [key=value ...]\n"
+        "  kernel=<name>     run a single kernel\n"
+        "  max=262144        largest input size\n"
+        "  repeats=5 seed=1  timed runs per size, input seed\n");
+}
+
+/**
+ * @brief Reads the key=value options.
+ *
+ * @return 1 if every option is known and the values make sense.
+ */
+static int parse_options(int argc, char **argv, KernelConfig *config) {
+    for (int i = 1; i < argc; i++) {
+        char *value = strchr(argv[i], '=');
+        if (value == NULL)
+            return 0;
+        *value++ = NULL_TERMINATOR;
+
+        if (strcmp(argv[i], "kernel") == 0) config->only = value;
+        else if (strcmp(argv[i], "max") == 0) config->maxSize = atoi(value);
+        else if (strcmp(argv[i], "repeats") == 0) config->repeats = atoi(value);
+        else if (strcmp(argv[i], "seed") == 0) config->seed = strtoull(value, NULL, 10);
+        else
+            return 0;
+    }
+
+    return config->maxSize >= KERNEL_MIN_SIZE &&
+            config->repeats > 0 && config->repeats <= KERNEL_MAX_REPEATS &&
+            config->seed != 0;
+}
+
+int main(int argc, char **argv) {
+    KernelConfig config = {NULL, KERNEL_MAX_SIZE, 5, 1};
+    KernelInputs inputs;
+    int found = 0;
+
+    if (!parse_options(argc, argv, &config)) {
+        usage();
+        return 1;
+    }
+
+    rng = config.seed;
+    if (!generate_inputs(&inputs, config.maxSize)) {
+        fprintf(stderr, "kernels: out of memory\n");
+        return 1;
+    }
+
+    /// The last column only changes when a kernel computes something else
+    printf("kernel,size,ops,best_ns_per_op,median_ns_per_op,checksum\n");
+
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        const Kernel *kernel = &kernels[k];
+        if (config.only && strcmp(config.only, kernel->name) != 0)
+            continue;
+        found = 1;
+
+        for (int size = KERNEL_MIN_SIZE;
+                size <= config.maxSize && size <= kernel->maxSize;
+                size *= 4) {
+            time_kernel(kernel, &inputs, size, config.repeats);
+            fflush(stdout);
+        }
+    }
+
+    free_inputs(&inputs);
+    if (!found) {
+        fprintf(stderr, "kernels: no kernel named %s\n", config.only);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,179 @@
+/**
+ * @file tracedecode.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Offline decoder of the trace files written by a -DPROJ1_TRACE
+ * build.
+ *
+ * Every record but the BEGIN ones ends a step that started at the previous
+ * record of the same thread. The decoder gathers the duration of each step
+ * and prints their count and latency percentiles, in nanoseconds.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+/// Names of the steps, in the order of TraceProbe
+static const char *probeNames[TRACE_PROBES] = {
+    "entry.begin",
+    "entry.park_lookup",
+    "entry.plate_check",
+    "entry.last_command",
+    "entry.date_check",
+    "entry.append",
+    "entry.indexes",
+    "exit.begin",
+    "exit.find_entry",
+    "exit.park_lookup",
+    "exit.plate_check",
+    "exit.last_command",
+    "exit.date_check",
+    "exit.append",
+    "exit.unlink",
+    "bill.payment",
+    "bill.insert",
+    "bill.indexes",
+    "bill.print",
+    "exit.indexes",
+};
+
+/**
+ * @brief Durations of one step.
+ */
+typedef struct {
+    long long *nanos;
+    long count;
+    long capacity;
+} StepLog;
+
+/**
+ * @brief Where the last record of a thread left off.
+ */
+typedef struct {
+    long long nanos;
+    int active;     ///< Whether a BEGIN was seen since the last error.
+} ThreadClock;
+
+/**
+ * @brief Moves a duration down a max-heap until its children are smaller.
+ *
+ * @param nanos The heap.
+ * @param position Where the duration is.
+ * @param size Number of durations in the heap.
+ */
+static void sift_down(long long *nanos, long position, long size) {
+    long long value = nanos[position];
+
+    while (2 * position + 1 < size) {
+        long child = 2 * position + 1;
+        if (child + 1 < size && nanos[child + 1] > nanos[child])
+            child++;
+        if (nanos[child] <= value)
+            break;
+
+        nanos[position] = nanos[child];
+        position = child;
+    }
+    nanos[position] = value;
+}
+
+/**
+ * @brief Sorts durations in increasing order.
+ *
+ * A heap sort, as the library sort may not be used.
+ *
+ * @param nanos The durations.
+ * @param count Number of durations.
+ */
+static void sort_nanos(long long *nanos, long count) {
+    for (long i = count / 2 - 1; i >= 0; i--)
+        sift_down(nanos, i, count);
+
+    /// The maximum goes to the end on every step
+    for (long size = count - 1; size > 0; size--) {
+        long long largest = nanos[0];
+        nanos[0] = nanos[size];
+        nanos[size] = largest;
+        sift_down(nanos, 0, size);
+    }
+}
+
+/**
+ * @brief Adds a duration to a step.
+ *
+ * @return 1 on success, 0 if memory allocation failed.
+ */
+static int log_step(StepLog *log, long long nanos) {
+    if (log->count == log->capacity) {
+        log->capacity = log->capacity ? log->capacity * 2 : 1024;
+        log->nanos = realloc(log->nanos, log->capacity * sizeof(long long));
+        if (log->nanos == NULL)
+            return 0;
+    }
+    log->nanos[log->count++] = nanos;
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : TRACE_DEFAULT_FILE;
+    StepLog steps[TRACE_PROBES] = {{0}};
+    ThreadClock clocks[TRACE_MAX_THREADS] = {{0}};
+    TraceHeader header;
+    TraceRecord record;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "tracedecode: cannot read %s\n", path);
+        return 1;
+    }
+
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TRACE_VERSION) {
+        fprintf(stderr, "tracedecode: %s is not a trace file\n", path);
+        return 1;
+    }
+
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.probe < 0 || record.probe >= TRACE_PROBES ||
+            record.thread < 0 || record.thread >= TRACE_MAX_THREADS)
+            continue;
+
+        ThreadClock *clock = &clocks[record.thread];
+        if (record.probe == TRACE_ENTRY_BEGIN ||
+            record.probe == TRACE_EXIT_BEGIN)
+            clock->active = 1;
+        else if (clock->active &&
+                !log_step(&steps[record.probe], record.nanos - clock->nanos))
+            return 1;
+        clock->nanos = record.nanos;
+    }
+    fclose(file);
+
+    printf("%lld records, %lld dropped\n", header.records, header.dropped);
+    printf("%-20s %9s %10s %10s %10s %10s %10s\n",
+        "step", "count", "mean_ns", "p50_ns", "p90_ns", "p99_ns", "max_ns");
+
+    for (int probe = 0; probe < TRACE_PROBES; probe++) {
+        StepLog *log = &steps[probe];
+        if (log->count == 0)
+            continue;
+
+        long long sum = 0;
+        for (long i = 0; i < log->count; i++)
+            sum += log->nanos[i];
+        sort_nanos(log->nanos, log->count);
+
+        printf("%-20s %9ld %10.0f %10lld %10lld %10lld %10lld\n",
+            probeNames[probe],
+            log->count,
+            (double)sum / log->count,
+            log->nanos[(log->count - 1) * 50 / 100],
+            log->nanos[(log->count - 1) * 90 / 100],
+            log->nanos[(log->count - 1) * 99 / 100],
+            log->nanos[log->count - 1]);
+        free(log->nanos);
+    }
+    return 0;
+}
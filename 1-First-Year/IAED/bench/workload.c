@@ -0,0 +1,625 @@
+/**
+ * @file workload.c
+ * @author Diogo Carreira
+ * @date March 2024
+ * @brief Workload generator and end-to-end benchmark of the parking
+ * management system.
+ *
+ * Synthesizes a command stream from a small simulation of a fleet moving
+ * between parks, writes it to a file, and then feeds that file through the
+ * real command handlers of proj1.c, timing every command. Output of the
+ * commands goes to /dev/null; the report goes to stderr, together with the
+ * memory held just before the final 'q'.
+ *
+ * Options are given as key=value arguments, see usage().
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "proj.h"
+#include "movements.h"
+#include "calendar.h"
+#include "validation.h"
+#include "accounting.h"
+#include "stats.h"
+
+#define BENCH_PARK_CAPACITY_SHARE 0.7
+#define BENCH_TARGET_OCCUPANCY 0.6
+#define BENCH_PARK_TRIES 4
+#define BENCH_COMMAND_TYPES 26
+#define BENCH_PI 3.14159265358979323846
+#define NANOS_PER_SECOND 1000000000LL
+
+/// Entry points of proj1.c, built with PROJ1_NO_MAIN
+void initialize_program(Park **parksTotal, int *ParksCounter, Movement **head, HashTable **vehicles, BillingHashTable **billing);
+int read_commands(Park *parksTotal, int *ParksCounter, Movement **head, HashTable *vehicles, BillingHashTable *billing);
+
+/**
+ * @brief Shape of the generated workload.
+ */
+typedef struct {
+    int parks;            ///< Number of parks, at most PARK_MAX.
+    int fleet;            ///< Number of distinct vehicles.
+    long commands;        ///< Number of commands to generate.
+    unsigned long long seed;
+    double stayMedian;    ///< Median stay, in minutes.
+    double staySpread;    ///< Log-normal sigma of the stay length.
+    double diurnal;       ///< Day/night swing of arrivals, from 0 to 1.
+    double queryV;        ///< Chance of a 'v' after each movement.
+    double queryF;        ///< Chance of an 'f' after each movement.
+    double queryP;        ///< Chance of a 'p' after each movement.
+    double queryR;        ///< Chance of an 'r' after each movement.
+    const char *file;     ///< Where the workload is written and read.
+    int generate;         ///< Whether to generate the workload.
+    int run;              ///< Whether to run the workload.
+} BenchConfig;
+
+/**
+ * @brief A scheduled exit of the simulation.
+ */
+typedef struct {
+    double time;   ///< Minute of the exit.
+    int vehicle;   ///< Index of the vehicle.
+    int stay;      ///< Stay number of the vehicle when it was scheduled.
+} PendingExit;
+
+/**
+ * @brief State of the simulation while the workload is generated.
+ */
+typedef struct {
+    BenchConfig *config;
+    FILE *out;
+    unsigned long long rng;
+    double clock;              ///< Current minute.
+    long emitted;              ///< Commands written so far.
+    char (*plates)[PLATE_MAX]; ///< Plate of each vehicle.
+    int *parkOf;               ///< Park of each vehicle, or -1 outside.
+    int *stayOf;               ///< Stay number of each vehicle.
+    int *outside;              ///< Vehicles outside, in any order.
+    int *outsideAt;            ///< Position of each vehicle in outside.
+    int outsideCount;
+    int *capacity;             ///< Capacity of each park.
+    int *occupied;             ///< Occupied spots of each park.
+    PendingExit *exits;        ///< Min-heap of scheduled exits.
+    int exitCount;
+    int exitCapacity;
+} Simulation;
+
+/**
+ * @brief Latencies of every command of one type.
+ */
+typedef struct {
+    long long *nanos;
+    long count;
+    long capacity;
+} LatencyLog;
+
+/**
+ * @brief Prints the accepted options.
+ */
+static void usage(void) {
+    fprintf(stderr,
+        "usage: workload [key=value ...]\n"
+        "  parks=10 fleet=20000 commands=200000 seed=1\n"
+        "  stay=180 spread=1.0 diurnal=0.8   stay median/sigma, minutes\n"
+        "  v=0.05 f=0.01 p=0.002 r=0         queries per movement\n"
+        "  file=workload.txt mode=all|gen|run\n");
+}
+
+/**
+ * @brief Draws a uniform number in [0, 1) with xorshift64*.
+ *
+ * @param sim The simulation.
+ * @return The number.
+ */
+static double uniform(Simulation *sim) {
+    sim->rng ^= sim->rng >> 12;
+    sim->rng ^= sim->rng << 25;
+    sim->rng ^= sim->rng >> 27;
+    return ((sim->rng * 2685821657736338717ULL) >> 11) *
+            (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @brief Draws a stay length from a log-normal distribution.
+ *
+ * @param sim The simulation.
+ * @return The stay, in minutes, at least one.
+ */
+static double stay_length(Simulation *sim) {
+    double u = 1.0 - uniform(sim), v = uniform(sim);
+    double normal = sqrt(-2.0 * log(u)) * cos(2.0 * BENCH_PI * v);
+    double stay = sim->config->stayMedian *
+                    exp(sim->config->staySpread * normal);
+    return stay < 1.0 ? 1.0 : stay;
+}
+
+/**
+ * @brief Draws the time until the next arrival.
+ *
+ * Arrivals follow a Poisson process whose rate peaks at 13:00 and bottoms
+ * out at 01:00, keeping the parks at about the target occupancy on average.
+ *
+ * @param sim The simulation.
+ * @param totalCapacity Spots of every park together.
+ * @return The gap, in minutes.
+ */
+static double arrival_gap(Simulation *sim, int totalCapacity) {
+    BenchConfig *config = sim->config;
+    double meanStay = config->stayMedian *
+                        exp(config->staySpread * config->staySpread / 2.0);
+    double gap = meanStay / (BENCH_TARGET_OCCUPANCY * totalCapacity);
+    double minuteOfDay = fmod(sim->clock, MINUTES_PER_DAY);
+    double rate = 1.0 + config->diurnal *
+        sin(2.0 * BENCH_PI * (minuteOfDay / MINUTES_PER_DAY - 7.0 / 24.0));
+
+    return -log(1.0 - uniform(sim)) * gap / (rate > 0.05 ? rate : 0.05);
+}
+
+/**
+ * @brief Moves a time off 29 February, when parks are closed.
+ *
+ * @param time A minute.
+ * @return The same minute, or 00:00 of 1 March if it falls on 29 February.
+ */
+static double open_time(double time) {
+    Date date = date_from_minute_number((long long)time);
+
+    if (date.month == FEBRUARY && date.day == LAST_DAY_FEBRUARY)
+        return (double)((long long)time / MINUTES_PER_DAY + 1) *
+                MINUTES_PER_DAY;
+    return time;
+}
+
+/**
+ * @brief Writes the current date as "dd-mm-yyyy hh:mm".
+ *
+ * @param sim The simulation.
+ */
+static void write_clock(Simulation *sim) {
+    Date date = date_from_minute_number((long long)sim->clock);
+    fprintf(sim->out, "%02d-%02d-%04d %02d:%02d",
+        date.day, date.month, date.year, date.time.hour, date.time.minute);
+}
+
+/**
+ * @brief Adds a scheduled exit to the heap.
+ *
+ * Exits of removed parks stay in the heap until they are popped, so the
+ * heap can hold more exits than there are vehicles.
+ */
+static void push_exit(Simulation *sim, PendingExit exit) {
+    if (sim->exitCount == sim->exitCapacity) {
+        int capacity = sim->exitCapacity * 2;
+        PendingExit *exits = realloc(sim->exits,
+                                    capacity * sizeof(PendingExit));
+        if (exits == NULL)
+            return;
+        sim->exits = exits;
+        sim->exitCapacity = capacity;
+    }
+
+    int i = sim->exitCount++;
+
+    while (i > 0 && sim->exits[(i - 1) / 2].time > exit.time) {
+        sim->exits[i] = sim->exits[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    sim->exits[i] = exit;
+}
+
+/**
+ * @brief Removes the earliest scheduled exit from the heap.
+ */
+static PendingExit pop_exit(Simulation *sim) {
+    PendingExit top = sim->exits[0];
+    PendingExit last = sim->exits[--sim->exitCount];
+    int i = 0;
+
+    while (2 * i + 1 < sim->exitCount) {
+        int child = 2 * i + 1;
+        if (child + 1 < sim->exitCount &&
+            sim->exits[child + 1].time < sim->exits[child].time)
+            child++;
+        if (sim->exits[child].time >= last.time)
+            break;
+        sim->exits[i] = sim->exits[child];
+        i = child;
+    }
+    sim->exits[i] = last;
+    return top;
+}
+
+/**
+ * @brief Moves a vehicle in or out of the pool of vehicles outside.
+ */
+static void set_outside(Simulation *sim, int vehicle, int outside) {
+    if (outside) {
+        sim->outsideAt[vehicle] = sim->outsideCount;
+        sim->outside[sim->outsideCount++] = vehicle;
+        return;
+    }
+
+    int at = sim->outsideAt[vehicle];
+    int last = sim->outside[--sim->outsideCount];
+    sim->outside[at] = last;
+    sim->outsideAt[last] = at;
+}
+
+/**
+ * @brief Writes the command that creates a park.
+ */
+static void write_park(Simulation *sim, int park) {
+    fprintf(sim->out, "p P%02d %d 0.25 0.40 15.00\n", park, sim->capacity[park]);
+    sim->emitted++;
+}
+
+/**
+ * @brief Writes the queries that follow a movement, if any.
+ */
+static void write_queries(Simulation *sim) {
+    BenchConfig *config = sim->config;
+
+    if (uniform(sim) < config->queryV) {
+        int vehicle = (int)(uniform(sim) * config->fleet);
+        fprintf(sim->out, "v %s\n", sim->plates[vehicle]);
+        sim->emitted++;
+    }
+
+    if (uniform(sim) < config->queryF) {
+        int park = (int)(uniform(sim) * config->parks);
+        fprintf(sim->out, "f P%02d", park);
+        if (uniform(sim) < 0.5) {
+            Date date = date_from_minute_number((long long)sim->clock);
+            fprintf(sim->out, " %02d-%02d-%04d", date.day, date.month, date.year);
+        }
+        fprintf(sim->out, "\n");
+        sim->emitted++;
+    }
+
+    if (uniform(sim) < config->queryP) {
+        fprintf(sim->out, "p\n");
+        sim->emitted++;
+    }
+
+    /// A removed park is created again, empty, so the workload goes on
+    if (uniform(sim) < config->queryR) {
+        int park = (int)(uniform(sim) * config->parks);
+        fprintf(sim->out, "r P%02d\n", park);
+        sim->emitted++;
+        write_park(sim, park);
+
+        for (int vehicle = 0; vehicle < config->fleet; vehicle++)
+            if (sim->parkOf[vehicle] == park) {
+                sim->parkOf[vehicle] = -1;
+                sim->stayOf[vehicle]++;
+                set_outside(sim, vehicle, 1);
+            }
+        sim->occupied[park] = 0;
+    }
+}
+
+/**
+ * @brief Writes the workload to the configured file.
+ *
+ * @param config The shape of the workload.
+ * @return 1 on success, 0 otherwise.
+ */
+static int generate(BenchConfig *config) {
+    Simulation sim = {0};
+    int totalCapacity = 0;
+    Date start = {1, 1, 2024, {0, 0}};
+
+    sim.config = config;
+    sim.rng = config->seed * 0x9E3779B97F4A7C15ULL + 1;
+    sim.out = fopen(config->file, "w");
+    sim.plates = malloc(config->fleet * sizeof(*sim.plates));
+    sim.parkOf = malloc(config->fleet * sizeof(int));
+    sim.stayOf = calloc(config->fleet, sizeof(int));
+    sim.outside = malloc(config->fleet * sizeof(int));
+    sim.outsideAt = malloc(config->fleet * sizeof(int));
+    sim.capacity = malloc(config->parks * sizeof(int));
+    sim.occupied = calloc(config->parks, sizeof(int));
+    sim.exits = malloc(config->fleet * sizeof(PendingExit));
+    sim.exitCapacity = config->fleet;
+
+    if (sim.out == NULL || !sim.plates || !sim.parkOf || !sim.stayOf ||
+        !sim.outside || !sim.outsideAt || !sim.capacity || !sim.occupied ||
+        !sim.exits) {
+        fprintf(stderr, "workload: cannot create %s\n", config->file);
+        return 0;
+    }
+
+    /// Plates "AB-12-CD", one per vehicle
+    for (int vehicle = 0; vehicle < config->fleet; vehicle++) {
+        int a = vehicle % 676, n = (vehicle / 676) % 100, b = vehicle / 67600;
+        sprintf(sim.plates[vehicle], "%c%c-%02d-%c%c",
+            'A' + a / 26, 'A' + a % 26, n, 'A' + b / 26 % 26, 'A' + b % 26);
+        sim.parkOf[vehicle] = -1;
+        set_outside(&sim, vehicle, 1);
+    }
+
+    for (int park = 0; park < config->parks; park++) {
+        double share = config->fleet * BENCH_PARK_CAPACITY_SHARE / config->parks;
+        sim.capacity[park] = (int)(share * (0.5 + uniform(&sim))) + 1;
+        totalCapacity += sim.capacity[park];
+        write_park(&sim, park);
+    }
+
+    sim.clock = minute_number(start);
+    double nextArrival = sim.clock + arrival_gap(&sim, totalCapacity);
+
+    while (sim.emitted < config->commands) {
+        if (sim.exitCount > 0 && sim.exits[0].time <= nextArrival) {
+            PendingExit exit = pop_exit(&sim);
+            if (exit.stay != sim.stayOf[exit.vehicle])
+                continue;
+
+            sim.clock = open_time(exit.time > sim.clock ? exit.time : sim.clock);
+            int park = sim.parkOf[exit.vehicle];
+            fprintf(sim.out, "s P%02d %s ", park, sim.plates[exit.vehicle]);
+            write_clock(&sim);
+            fprintf(sim.out, "\n");
+
+            sim.occupied[park]--;
+            sim.parkOf[exit.vehicle] = -1;
+            sim.stayOf[exit.vehicle]++;
+            set_outside(&sim, exit.vehicle, 1);
+        }
+        else {
+            sim.clock = open_time(nextArrival);
+            nextArrival = sim.clock + arrival_gap(&sim, totalCapacity);
+            if (sim.outsideCount == 0)
+                continue;
+
+            int park = -1;
+            for (int tries = 0; tries < BENCH_PARK_TRIES && park < 0; tries++) {
+                int candidate = (int)(uniform(&sim) * config->parks);
+                if (sim.occupied[candidate] < sim.capacity[candidate])
+                    park = candidate;
+            }
+            if (park < 0)
+                continue;
+
+            int vehicle = sim.outside[(int)(uniform(&sim) * sim.outsideCount)];
+            fprintf(sim.out, "e P%02d %s ", park, sim.plates[vehicle]);
+            write_clock(&sim);
+            fprintf(sim.out, "\n");
+
+            sim.occupied[park]++;
+            sim.parkOf[vehicle] = park;
+            set_outside(&sim, vehicle, 0);
+            push_exit(&sim, (PendingExit){sim.clock + stay_length(&sim),
+                                            vehicle, sim.stayOf[vehicle]});
+        }
+
+        sim.emitted++;
+        write_queries(&sim);
+    }
+
+    fprintf(sim.out, "q\n");
+    fclose(sim.out);
+    free(sim.plates);
+    free(sim.parkOf);
+    free(sim.stayOf);
+    free(sim.outside);
+    free(sim.outsideAt);
+    free(sim.capacity);
+    free(sim.occupied);
+    free(sim.exits);
+    return 1;
+}
+
+/**
+ * @brief Moves a duration down a max-heap until its children are smaller.
+ *
+ * @param nanos The heap.
+ * @param position Where the duration is.
+ * @param size Number of durations in the heap.
+ */
+static void sift_down(long long *nanos, long position, long size) {
+    long long value = nanos[position];
+
+    while (2 * position + 1 < size) {
+        long child = 2 * position + 1;
+        if (child + 1 < size && nanos[child + 1] > nanos[child])
+            child++;
+        if (nanos[child] <= value)
+            break;
+
+        nanos[position] = nanos[child];
+        position = child;
+    }
+    nanos[position] = value;
+}
+
+/**
+ * @brief Sorts durations in increasing order.
+ *
+ * A heap sort, as the library sort may not be used.
+ *
+ * @param nanos The durations.
+ * @param count Number of durations.
+ */
+static void sort_nanos(long long *nanos, long count) {
+    for (long i = count / 2 - 1; i >= 0; i--)
+        sift_down(nanos, i, count);
+
+    /// The maximum goes to the end on every step
+    for (long size = count - 1; size > 0; size--) {
+        long long largest = nanos[0];
+        nanos[0] = nanos[size];
+        nanos[size] = largest;
+        sift_down(nanos, 0, size);
+    }
+}
+
+/**
+ * @brief Prints the memory held by each tag and the bytes per stored stay.
+ *
+ * A stay is an entry movement still in the list; its exit, its vehicle
+ * records and its billing node are counted against it.
+ *
+ * @param head Head of the list of movements.
+ */
+static void report_memory(Movement *head) {
+    long stays = 0;
+
+    for (Movement *movement = head; movement; movement = movement->next)
+        if (movement->command == 'e')
+            stays++;
+
+    fprintf(stderr, "mem             live       peak     allocs\n");
+    for (int tag = 0; tag < MEM_TAGS; tag++) {
+        MemCounters counters = mem_counters(tag);
+        fprintf(stderr, "%-9s %10lld %10lld %10lld\n",
+            mem_tag_name(tag), counters.live, counters.peak, counters.allocs);
+    }
+
+    MemCounters total = mem_total();
+    fprintf(stderr, "%-9s %10lld %10lld %10lld\n",
+        "total", total.live, total.peak, total.allocs);
+    fprintf(stderr, "%ld stays, %.1f bytes per stay\n",
+        stays, (double)total.live / (stays > 0 ? stays : 1));
+}
+
+/**
+ * @brief Runs the workload through the command handlers and reports.
+ *
+ * @param config The shape of the workload.
+ * @return 1 on success, 0 otherwise.
+ */
+static int run(BenchConfig *config) {
+    LatencyLog logs[BENCH_COMMAND_TYPES] = {{0}};
+    Park *parksTotal;
+    int parksCounter, more = 1;
+    Movement *head;
+    HashTable *vehicles;
+    BillingHashTable *billing;
+
+    if (freopen(config->file, "r", stdin) == NULL ||
+        freopen("/dev/null", "w", stdout) == NULL) {
+        fprintf(stderr, "workload: cannot read %s\n", config->file);
+        return 0;
+    }
+
+    initialize_program(&parksTotal, &parksCounter, &head, &vehicles, &billing);
+    long long start = stats_clock();
+
+    while (more) {
+        int c = getchar();
+        if (c == EOF)
+            break;
+        ungetc(c, stdin);
+
+        if (c == 'q')
+            report_memory(head);
+
+        long long before = stats_clock();
+        more = read_commands(parksTotal, &parksCounter, &head, vehicles, billing);
+        long long elapsed = stats_clock() - before;
+
+        if (c < 'a' || c > 'z')
+            continue;
+
+        LatencyLog *log = &logs[c - 'a'];
+        if (log->count == log->capacity) {
+            log->capacity = log->capacity ? log->capacity * 2 : 1024;
+            log->nanos = realloc(log->nanos, log->capacity * sizeof(long long));
+            if (log->nanos == NULL)
+                return 0;
+        }
+        log->nanos[log->count++] = elapsed;
+    }
+
+    long long total = stats_clock() - start;
+    long commands = 0;
+    for (int type = 0; type < BENCH_COMMAND_TYPES; type++)
+        commands += logs[type].count;
+
+    fprintf(stderr, "%ld commands in %.3f s, %.0f commands/s\n",
+        commands, (double)total / NANOS_PER_SECOND,
+        commands * (double)NANOS_PER_SECOND / (total > 0 ? total : 1));
+    fprintf(stderr, "cmd    count    mean_us     p50_us     p90_us     p99_us     max_us\n");
+
+    for (int type = 0; type < BENCH_COMMAND_TYPES; type++) {
+        LatencyLog *log = &logs[type];
+        if (log->count == 0)
+            continue;
+
+        long long sum = 0;
+        for (long i = 0; i < log->count; i++)
+            sum += log->nanos[i];
+        sort_nanos(log->nanos, log->count);
+
+        fprintf(stderr, "%c %10ld %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+            'a' + type,
+            log->count,
+            sum / 1000.0 / log->count,
+            log->nanos[(log->count - 1) * 50 / 100] / 1000.0,
+            log->nanos[(log->count - 1) * 90 / 100] / 1000.0,
+            log->nanos[(log->count - 1) * 99 / 100] / 1000.0,
+            log->nanos[log->count - 1] / 1000.0);
+        free(log->nanos);
+    }
+    return 1;
+}
+
+/**
+ * @brief Reads the key=value options.
+ *
+ * @return 1 if every option is known and the values make sense.
+ */
+static int parse_options(int argc, char **argv, BenchConfig *config) {
+    for (int i = 1; i < argc; i++) {
+        char *value = strchr(argv[i], '=');
+        if (value == NULL)
+            return 0;
+        *value++ = NULL_TERMINATOR;
+
+        if (strcmp(argv[i], "parks") == 0) config->parks = atoi(value);
+        else if (strcmp(argv[i], "fleet") == 0) config->fleet = atoi(value);
+        else if (strcmp(argv[i], "commands") == 0) config->commands = atol(value);
+        else if (strcmp(argv[i], "seed") == 0) config->seed = strtoull(value, NULL, 10);
+        else if (strcmp(argv[i], "stay") == 0) config->stayMedian = atof(value);
+        else if (strcmp(argv[i], "spread") == 0) config->staySpread = atof(value);
+        else if (strcmp(argv[i], "diurnal") == 0) config->diurnal = atof(value);
+        else if (strcmp(argv[i], "v") == 0) config->queryV = atof(value);
+        else if (strcmp(argv[i], "f") == 0) config->queryF = atof(value);
+        else if (strcmp(argv[i], "p") == 0) config->queryP = atof(value);
+        else if (strcmp(argv[i], "r") == 0) config->queryR = atof(value);
+        else if (strcmp(argv[i], "file") == 0) config->file = value;
+        else if (strcmp(argv[i], "mode") == 0) {
+            config->generate = strcmp(value, "run") != 0;
+            config->run = strcmp(value, "gen") != 0;
+        }
+        else
+            return 0;
+    }
+
+    return config->parks > 0 && config->parks <= PARK_MAX &&
+            config->fleet > 0 && config->commands > 0 &&
+            config->stayMedian > 0 && config->staySpread >= 0 &&
+            config->diurnal >= 0 && config->diurnal < 1;
+}
+
+int main(int argc, char **argv) {
+    BenchConfig config = {
+        10, 20000, 200000, 1,
+        180.0, 1.0, 0.8,
+        0.05, 0.01, 0.002, 0.0,
+        "workload.txt", 1, 1
+    };
+
+    if (!parse_options(argc, argv, &config)) {
+        usage();
+        return 1;
+    }
+
+    if (config.generate && !generate(&config))
+        return 1;
+    if (config.run && !run(&config))
+        return 1;
+    return 0;
+}